@@ -0,0 +1,122 @@
+// Checks `tapa::invoke_async` against a stand-in FPGA runtime: the device is
+// programmed once for all invocations, whose kernels run one at a time in the
+// order they are started, each returns before its kernel finishes, and the
+// host-to-device transfers of an invocation start while the kernel of the
+// previous one runs.
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+
+DEFINE_uint64(n, 4096, "number of elements per batch");
+DEFINE_int32(batches, 4, "number of asynchronous invocations");
+
+void Scale(tapa::mmap<const float> in, tapa::mmap<float> out, uint64_t n,
+           uint64_t batch) {
+  for (uint64_t i = 0; i < n; ++i) {
+    out[i] = in[i] * batch;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const std::string bitstream = "stand-in.xclbin";
+  const uint64_t batches = FLAGS_batches;
+  std::vector<std::vector<float, tapa::aligned_allocator<float>>> in(batches),
+      out(batches);
+  for (uint64_t i = 0; i < batches; ++i) {
+    in[i].resize(FLAGS_n, 1.f);
+    out[i].resize(FLAGS_n);
+  }
+
+  auto& state = fpga::stand_in();
+  {
+    std::unique_lock<std::mutex> lock(state.mtx);
+    state.is_held = true;
+    state.is_program_held = true;
+  }
+  std::vector<std::future<int64_t>> futures;
+  for (uint64_t i = 0; i < batches; ++i) {
+    futures.push_back(tapa::invoke_async(
+        Scale, bitstream, tapa::read_only_mmap<const float>(in[i]),
+        tapa::write_only_mmap<float>(out[i]), FLAGS_n, i));
+  }
+  // all invocations are started before the kernel of the first is executed
+  {
+    std::unique_lock<std::mutex> lock(state.mtx);
+    state.is_program_held = false;
+  }
+  state.cv.notify_all();
+
+  int error = 0;
+  if (futures[0].wait_for(std::chrono::milliseconds(100)) !=
+      std::future_status::timeout) {
+    clog << "invocation #0 is done before its kernel finishes" << endl;
+    ++error;
+  }
+  if (batches > 1) {
+    std::unique_lock<std::mutex> lock(state.mtx);
+    if (!state.cv.wait_for(lock, std::chrono::seconds(1),
+                           [&state] { return state.write_count >= 2; })) {
+      clog << "invocation #1 transfers no input while kernel #0 runs" << endl;
+      ++error;
+    }
+    if (state.running_count != 1 || state.invocations.size() != 1) {
+      clog << "kernel #1 is executed before kernel #0 finishes" << endl;
+      ++error;
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(state.mtx);
+    state.is_held = false;
+  }
+  state.cv.notify_all();
+  for (uint64_t i = 0; i < batches; ++i) {
+    if (futures[i].get() <= 0) {
+      clog << "invocation #" << i << " reports no kernel time" << endl;
+      ++error;
+    }
+  }
+
+  // a synchronous invocation reuses the same device
+  tapa::invoke(Scale, bitstream, tapa::read_only_mmap<const float>(in[0]),
+               tapa::write_only_mmap<float>(out[0]), FLAGS_n, batches);
+
+  if (state.program_count != 1) {
+    clog << "programmed " << state.program_count << " times" << endl;
+    ++error;
+  }
+  if (state.max_running_count != 1) {
+    clog << state.max_running_count << " kernels ran at once" << endl;
+    ++error;
+  }
+  if (state.invocations.size() != batches + 1) {
+    clog << "executed " << state.invocations.size() << " invocations" << endl;
+    ++error;
+  } else {
+    for (uint64_t i = 0; i <= batches; ++i) {
+      // scalar arguments follow the two buffers
+      if (state.invocations[i][3] != i) {
+        clog << "invocation #" << state.invocations[i][3] << " executed as #"
+             << i << endl;
+        ++error;
+      }
+    }
+  }
+
+  if (error == 0) {
+    clog << "PASS!" << endl;
+  } else {
+    clog << "FAIL!" << endl;
+  }
+  return error > 0 ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+// Checks the transfers skipped for memory tracked by `tapa::mark_dirty`
+// against a stand-in FPGA runtime: once marked, inputs and outputs the kernel
+// also reads are transferred to the device only if marked again, and outputs
+// are read back on every invocation.
+
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+
+DEFINE_uint64(n, 4096, "number of elements per array");
+
+void Update(tapa::mmap<const float> in, tapa::mmap<float> inout,
+            tapa::mmap<float> out, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+    inout[i] += in[i];
+    out[i] = inout[i];
+  }
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const uint64_t n = FLAGS_n;
+  const uint64_t bytes = n * sizeof(float);
+  std::vector<float, tapa::aligned_allocator<float>> in(n), inout(n), out(n);
+  auto invoke = [&] {
+    tapa::invoke(Update, "stand-in.xclbin",
+                 tapa::read_only_mmap<const float>(in),
+                 tapa::read_write_mmap<float>(inout),
+                 tapa::write_only_mmap<float>(out), n);
+  };
+
+  // bytes to and from the device expected for each invocation
+  std::vector<std::pair<uint64_t, uint64_t>> expected;
+
+  // nothing is tracked before the first mark
+  invoke();
+  expected.emplace_back(2 * bytes, 2 * bytes);
+
+  tapa::mark_dirty(in.data(), in.data() + n);
+  tapa::mark_dirty(inout.data(), inout.data() + n);
+  invoke();
+  expected.emplace_back(2 * bytes, 2 * bytes);
+
+  // clean inputs stay on the device, but the output the kernel also reads is
+  // still read back
+  invoke();
+  expected.emplace_back(0, 2 * bytes);
+
+  // a buffer with any marked range is transferred in full
+  tapa::mark_dirty(inout.data() + n / 2, inout.data() + n / 2 + 1);
+  invoke();
+  expected.emplace_back(bytes, 2 * bytes);
+
+  invoke();
+  expected.emplace_back(0, 2 * bytes);
+
+  int error = 0;
+  const auto& transfers = fpga::stand_in().transfers;
+  if (transfers.size() != expected.size()) {
+    clog << "executed " << transfers.size() << " invocations" << endl;
+    ++error;
+  } else {
+    for (size_t i = 0; i < expected.size(); ++i) {
+      if (transfers[i] != expected[i]) {
+        clog << "invocation #" << i << ": expected " << expected[i].first
+             << " B to and " << expected[i].second << " B from device, got "
+             << transfers[i].first << " B and " << transfers[i].second << " B"
+             << endl;
+        ++error;
+      }
+    }
+  }
+
+  if (error == 0) {
+    clog << "PASS!" << endl;
+  } else {
+    clog << "FAIL!" << endl;
+  }
+  return error > 0 ? 1 : 0;
+}
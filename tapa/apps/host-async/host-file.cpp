@@ -0,0 +1,70 @@
+// Checks that files mapped by `tapa::file_mmap` can be passed to a stand-in
+// FPGA runtime that pins the host pages for writing, as the runtime does for
+// transfers in both directions, and that the files are never modified.
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+
+DEFINE_uint64(n, 4096, "number of elements of the file");
+
+void Copy(tapa::mmap<const float> in, tapa::mmap<float> out, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) out[i] = in[i];
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const uint64_t n = FLAGS_n;
+  std::vector<float> data(n);
+  for (uint64_t i = 0; i < n; ++i) data[i] = float(i);
+
+  char path[] = "/tmp/host-file-XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd == -1) {
+    clog << "cannot create a temporary file" << endl;
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  std::ofstream(path, std::ios::binary)
+      .write(reinterpret_cast<const char*>(data.data()), n * sizeof(float));
+
+  int error = 0;
+  {
+    tapa::file_mmap<const float> in(path);
+    std::vector<float, tapa::aligned_allocator<float>> out(n);
+    tapa::invoke(Copy, "stand-in.xclbin", tapa::read_only_mmap<const float>(in),
+                 tapa::write_only_mmap<float>(out), n);
+    if (in.size() != n) {
+      clog << "mapped " << in.size() << " elements" << endl;
+      ++error;
+    }
+  }
+
+  std::vector<float> contents(n);
+  std::ifstream(path, std::ios::binary)
+      .read(reinterpret_cast<char*>(contents.data()), n * sizeof(float));
+  unlink(path);
+  if (contents != data) {
+    clog << "file modified" << endl;
+    ++error;
+  }
+
+  if (error == 0) {
+    clog << "PASS!" << endl;
+  } else {
+    clog << "FAIL!" << endl;
+  }
+  return error > 0 ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+// Stand-in for the FPGA runtime, which records how the host uses an instance
+// instead of running the kernel. The kernel of an instance runs from `Exec`
+// until `Finish`, which waits while `stand_in().is_held`. Programming waits
+// while `stand_in().is_program_held`. Transfers are
+// counted in bytes, skipping the buffers suspended by `SuspendBuf`. Like the
+// runtime, `SetArg` pins the pages of buffers for writing, whatever their
+// direction.
+
+#ifndef TAPA_APPS_HOST_ASYNC_STAND_IN_FRT_H_
+#define TAPA_APPS_HOST_ASYNC_STAND_IN_FRT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fpga {
+
+struct StandIn {
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool is_held = false;
+  bool is_program_held = false;
+  int program_count = 0;
+  int running_count = 0;
+  int max_running_count = 0;
+  // calls of `WriteToDevice`
+  int write_count = 0;
+  // scalar arguments of each invocation, in the order they are executed
+  std::vector<std::map<int, uint64_t>> invocations;
+  // bytes transferred to and from the device by each invocation
+  std::vector<std::pair<uint64_t, uint64_t>> transfers;
+};
+
+inline StandIn& stand_in() {
+  static StandIn state;
+  return state;
+}
+
+// `is_input` and `is_output` are with respect to the device
+template <typename T, bool is_input, bool is_output>
+struct Buffer {
+  T* ptr;
+  size_t n;
+};
+template <typename T>
+using ReadOnlyBuffer = Buffer<T, false, true>;
+template <typename T>
+using WriteOnlyBuffer = Buffer<T, true, false>;
+template <typename T>
+using ReadWriteBuffer = Buffer<T, true, true>;
+template <typename T>
+using PlaceholderBuffer = Buffer<T, false, false>;
+
+template <typename T>
+ReadOnlyBuffer<T> ReadOnly(T* ptr, size_t n) {
+  return {ptr, n};
+}
+template <typename T>
+WriteOnlyBuffer<T> WriteOnly(T* ptr, size_t n) {
+  return {ptr, n};
+}
+template <typename T>
+ReadWriteBuffer<T> ReadWrite(T* ptr, size_t n) {
+  return {ptr, n};
+}
+template <typename T>
+PlaceholderBuffer<T> Placeholder(T* ptr, size_t n) {
+  return {ptr, n};
+}
+
+class Instance {
+ public:
+  explicit Instance(const std::string& bitstream) {
+    auto& state = stand_in();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    state.cv.wait(lock, [&state] { return !state.is_program_held; });
+    ++state.program_count;
+  }
+
+  template <typename T>
+  void SetArg(int index, T arg) {
+    scalars_[index] = static_cast<uint64_t>(arg);
+  }
+
+  template <typename T, bool is_input, bool is_output>
+  void SetArg(int index, Buffer<T, is_input, is_output> arg) {
+    buffers_[index] = {arg.n * sizeof(T), is_input, is_output, false};
+    // rewrite a byte of every page, which faults on read-only pages
+    auto* bytes = reinterpret_cast<volatile char*>(
+        const_cast<std::remove_const_t<T>*>(arg.ptr));
+    for (size_t i = 0; i < arg.n * sizeof(T); i += kPageSize) {
+      bytes[i] = bytes[i];
+    }
+  }
+
+  void SuspendBuf(int index) { buffers_[index].is_suspended = true; }
+
+  void WriteToDevice() {
+    uint64_t bytes = 0;
+    for (const auto& [index, buffer] : buffers_) {
+      if (buffer.is_input && !buffer.is_suspended) bytes += buffer.bytes;
+    }
+    written_bytes_ = bytes;
+    std::unique_lock<std::mutex> lock(stand_in().mtx);
+    ++stand_in().write_count;
+    stand_in().cv.notify_all();
+  }
+
+  void Exec() {
+    auto& state = stand_in();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    ++state.running_count;
+    if (state.running_count > state.max_running_count) {
+      state.max_running_count = state.running_count;
+    }
+    state.invocations.push_back(scalars_);
+  }
+
+  void ReadFromDevice() {
+    uint64_t bytes = 0;
+    for (const auto& [index, buffer] : buffers_) {
+      if (buffer.is_output && !buffer.is_suspended) bytes += buffer.bytes;
+    }
+    std::unique_lock<std::mutex> lock(stand_in().mtx);
+    stand_in().transfers.emplace_back(written_bytes_, bytes);
+  }
+
+  void Finish() {
+    auto& state = stand_in();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    state.cv.wait(lock, [&state] { return !state.is_held; });
+    --state.running_count;
+  }
+
+  int64_t ComputeTimeNanoSeconds() { return 1000; }
+  int64_t LoadTimeNanoSeconds() { return 0; }
+  int64_t StoreTimeNanoSeconds() { return 0; }
+
+ private:
+  static constexpr size_t kPageSize = 4096;
+
+  struct BufferArg {
+    uint64_t bytes;
+    bool is_input;
+    bool is_output;
+    bool is_suspended;
+  };
+
+  std::map<int, uint64_t> scalars_;
+  std::map<int, BufferArg> buffers_;
+  uint64_t written_bytes_ = 0;
+};
+
+}  // namespace fpga
+
+#endif  // TAPA_APPS_HOST_ASYNC_STAND_IN_FRT_H_
@@ -0,0 +1,68 @@
+// Compares host memory backings of `tapa::aligned_allocator` on a random
+// gather over a large array, which is dominated by TLB misses with regular
+// pages. Set TAPA_NUMA_NODE to also compare NUMA placements, e.g.
+//
+//   TAPA_NUMA_NODE=interleave ./host-memory --n=1073741824
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+
+DEFINE_uint64(n, 256 * 1024 * 1024, "number of 32-bit elements");
+DEFINE_uint64(accesses, 64 * 1024 * 1024, "number of random reads");
+
+template <tapa::page_size pages>
+double Run(const char* name, uint64_t& checksum) {
+  std::vector<uint32_t, tapa::aligned_allocator<uint32_t, pages>> data(
+      FLAGS_n);
+  for (uint64_t i = 0; i < FLAGS_n; ++i) {
+    data[i] = static_cast<uint32_t>(i);
+  }
+
+  const auto tic = std::chrono::steady_clock::now();
+  uint64_t sum = 0;
+  uint64_t lfsr = 1;
+  for (uint64_t i = 0; i < FLAGS_accesses; ++i) {
+    // xorshift64 as a cheap, reproducible random index
+    lfsr ^= lfsr << 13;
+    lfsr ^= lfsr >> 7;
+    lfsr ^= lfsr << 17;
+    sum += data[lfsr % FLAGS_n];
+  }
+  const auto toc = std::chrono::steady_clock::now();
+
+  const double seconds = std::chrono::duration<double>(toc - tic).count();
+  clog << name << ": " << seconds << " s, "
+       << FLAGS_accesses / seconds * 1e-6 << " M reads/s" << endl;
+  checksum = sum;
+  return seconds;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  clog << "gathering " << FLAGS_accesses << " elements from "
+       << FLAGS_n * sizeof(uint32_t) / 1024 / 1024 << " MiB" << endl;
+  uint64_t normal_sum, thp_sum, huge_sum;
+  const double normal =
+      Run<tapa::page_size::kNormal>("normal pages", normal_sum);
+  const double thp = Run<tapa::page_size::kTransparentHuge>(
+      "transparent huge pages", thp_sum);
+  const double huge = Run<tapa::page_size::kHuge>("huge pages", huge_sum);
+  clog << "speedup: " << normal / thp << "x (transparent), " << normal / huge
+       << "x (explicit)" << endl;
+
+  if (normal_sum != thp_sum || normal_sum != huge_sum) {
+    clog << "FAIL!" << endl;
+    return 1;
+  }
+  clog << "PASS!" << endl;
+  return 0;
+}
@@ -0,0 +1,188 @@
+// Compares the parallel host-side repacking routines of TAPA with the serial
+// loops used by the preprocessing of Serpens and Sextans (see
+// tapa/regression), which convert host data into device-ready layouts:
+//
+//   - Serpens: encodes sparse matrix entries as 64-bit words and interleaves
+//     them across the HBM channels of the sparse matrix;
+//   - Sextans: interleaves the columns of the dense matrix B across channels,
+//     and transposes the dense matrix C.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+
+template <typename T>
+using aligned_vector = std::vector<T, tapa::aligned_allocator<T>>;
+
+DEFINE_uint64(nnz, 16 * 1024 * 1024, "number of sparse matrix entries");
+DEFINE_uint64(rows, 8192, "number of rows of the dense matrices");
+DEFINE_uint64(cols, 8192, "number of columns of the dense matrices");
+
+constexpr uint64_t kSparseChannels = 16;
+constexpr uint64_t kDenseChannels = 8;
+
+struct edge {
+  int col;
+  int row;
+  float attr;
+};
+
+// col (14 bits) + row (18 bits) + value (32 bits), as in Serpens.
+uint64_t Encode(const edge& e) {
+  uint32_t value;
+  std::memcpy(&value, &e.attr, sizeof(value));
+  return (uint64_t(e.col & 0x3FFF) << 50) | (uint64_t(e.row & 0x3FFFF) << 32) |
+         value;
+}
+
+template <typename Func>
+double Time(const Func& func) {
+  const auto tic = std::chrono::steady_clock::now();
+  func();
+  const auto toc = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(toc - tic).count();
+}
+
+void Report(const char* name, uint64_t bytes, double serial, double parallel) {
+  clog << name << ": serial " << serial << " s, parallel " << parallel
+       << " s (" << bytes / parallel * 1e-9 << " GB/s), speedup "
+       << serial / parallel << "x" << endl;
+}
+
+template <typename T, uint64_t S>
+tapa::mmaps<T, S> AsMmaps(std::vector<aligned_vector<T>>& channels) {
+  std::array<T*, S> ptrs;
+  std::array<uint64_t, S> sizes;
+  for (uint64_t ch = 0; ch < S; ++ch) {
+    ptrs[ch] = channels[ch].data();
+    sizes[ch] = channels[ch].size();
+  }
+  return tapa::mmaps<T, S>(ptrs, sizes);
+}
+
+bool RunSerpens() {
+  const uint64_t nnz = FLAGS_nnz;
+  std::vector<edge> edges(nnz);
+  for (uint64_t i = 0; i < nnz; ++i) {
+    edges[i] = {int(i % 16384), int(i % 262144), float(i)};
+  }
+  const uint64_t channel_size = (nnz + kSparseChannels - 1) / kSparseChannels;
+
+  std::vector<aligned_vector<uint64_t>> serial(
+      kSparseChannels, aligned_vector<uint64_t>(channel_size, 0));
+  const double serial_time = Time([&] {
+    for (uint64_t i = 0; i < nnz; ++i) {
+      serial[i % kSparseChannels][i / kSparseChannels] = Encode(edges[i]);
+    }
+  });
+
+  std::vector<aligned_vector<uint64_t>> parallel(
+      kSparseChannels, aligned_vector<uint64_t>(channel_size, 0));
+  const double parallel_time = Time([&] {
+    // a lambda rather than a function pointer lets the compiler inline it
+    tapa::interleave(edges.data(), nnz,
+                     AsMmaps<uint64_t, kSparseChannels>(parallel),
+                     /*granularity=*/1,
+                     [](const edge& e) { return Encode(e); });
+  });
+
+  Report("serpens sparse matrix", nnz * sizeof(uint64_t), serial_time,
+         parallel_time);
+  return serial == parallel;
+}
+
+bool RunSextans() {
+  const uint64_t rows = FLAGS_rows;
+  const uint64_t cols = FLAGS_cols;
+  // column-major, as in Sextans
+  std::vector<float> mat(rows * cols);
+  for (uint64_t i = 0; i < mat.size(); ++i) mat[i] = float(i);
+
+  // column `c` of B goes to channel `c % 8`
+  const uint64_t channel_size =
+      (cols + kDenseChannels - 1) / kDenseChannels * rows;
+  std::vector<aligned_vector<float>> serial_b(
+      kDenseChannels, aligned_vector<float>(channel_size, 0));
+  const double serial_b_time = Time([&] {
+    for (uint64_t c = 0; c < cols; ++c) {
+      for (uint64_t r = 0; r < rows; ++r) {
+        serial_b[c % kDenseChannels][rows * (c / kDenseChannels) + r] =
+            mat[r + rows * c];
+      }
+    }
+  });
+  std::vector<aligned_vector<float>> parallel_b(
+      kDenseChannels, aligned_vector<float>(channel_size, 0));
+  const double parallel_b_time = Time([&] {
+    tapa::interleave(mat.data(), mat.size(),
+                     AsMmaps<float, kDenseChannels>(parallel_b), rows);
+  });
+  Report("sextans dense B", mat.size() * sizeof(float), serial_b_time,
+         parallel_b_time);
+
+  aligned_vector<float> serial_c(mat.size(), 0);
+  const double serial_c_time = Time([&] {
+    for (uint64_t c = 0; c < cols; ++c) {
+      for (uint64_t r = 0; r < rows; ++r) {
+        serial_c[r * cols + c] = mat[r + rows * c];
+      }
+    }
+  });
+  aligned_vector<float> parallel_c(mat.size(), 0);
+  const double parallel_c_time = Time(
+      [&] { tapa::transpose(mat.data(), cols, rows, parallel_c.data()); });
+  Report("sextans dense C", mat.size() * sizeof(float), serial_c_time,
+         parallel_c_time);
+
+  return serial_b == parallel_b && serial_c == parallel_c;
+}
+
+// Packs floats into vectors from both const and non-const mmaps, with the
+// last vector padded.
+bool RunPack() {
+  constexpr int kWidth = 16;
+  aligned_vector<float> values(FLAGS_cols + 1);
+  for (uint64_t i = 0; i < values.size(); ++i) values[i] = float(i);
+  const uint64_t vec_count = (values.size() + kWidth - 1) / kWidth;
+
+  aligned_vector<tapa::vec_t<float, kWidth>> from_const(vec_count);
+  aligned_vector<tapa::vec_t<float, kWidth>> from_mutable(vec_count);
+  tapa::pack<kWidth>(tapa::mmap<const float>(values),
+                     tapa::mmap<tapa::vec_t<float, kWidth>>(from_const),
+                     /*pad=*/-1.f);
+  tapa::pack<kWidth>(tapa::mmap<float>(values),
+                     tapa::mmap<tapa::vec_t<float, kWidth>>(from_mutable),
+                     /*pad=*/-1.f);
+
+  bool is_ok = true;
+  for (uint64_t i = 0; i < vec_count * kWidth; ++i) {
+    const float expected = i < values.size() ? values[i] : -1.f;
+    is_ok &= from_const[i / kWidth][i % kWidth] == expected &&
+             from_mutable[i / kWidth][i % kWidth] == expected;
+  }
+  return is_ok;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const bool serpens = RunSerpens();
+  const bool sextans = RunSextans();
+  const bool pack = RunPack();
+
+  if (!serpens || !sextans || !pack) {
+    clog << "FAIL!" << endl;
+    return 1;
+  }
+  clog << "PASS!" << endl;
+  return 0;
+}
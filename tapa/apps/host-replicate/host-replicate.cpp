@@ -0,0 +1,112 @@
+// Checks `invoke<tapa::replicated<n>>` in software simulation: the tokens of
+// the input stream are spread over `n` instances of a task that take a
+// different time for each token, and the output stream must still receive the
+// results in the order of the input, for any number of tokens, including none.
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+
+DEFINE_uint64(n, 1000, "maximum number of tokens per run");
+
+uint64_t Hash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Spends a varying number of steps on each token, so that the replicas get
+// out of step with each other.
+void Work(tapa::istream<uint64_t>& in, tapa::ostream<uint64_t>& out) {
+  TAPA_WHILE_NOT_EOT(in) {
+    uint64_t x = in.read(nullptr);
+    for (uint64_t i = 0, steps = x % 7 * 100; i < steps; ++i) {
+      x = Hash(x);
+    }
+    out.write(x);
+  }
+  in.open();
+  out.close();
+}
+
+void Load(tapa::mmap<const uint64_t> in, uint64_t n,
+          tapa::ostream<uint64_t>& out) {
+  for (uint64_t i = 0; i < n; ++i) {
+    out.write(in[i]);
+  }
+  out.close();
+}
+
+void Store(tapa::istream<uint64_t>& in, tapa::mmap<uint64_t> out,
+           uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+    out[i] = in.read();
+  }
+  in.open();
+}
+
+template <int replicas>
+void Top(tapa::mmap<const uint64_t> in, tapa::mmap<uint64_t> out, uint64_t n) {
+  tapa::stream<uint64_t> q_in("q_in");
+  tapa::stream<uint64_t> q_out("q_out");
+  tapa::task()
+      .invoke(Load, in, n, q_in)
+      .template invoke<tapa::replicated<replicas>>(Work, q_in, q_out)
+      .invoke(Store, q_out, out, n);
+}
+
+template <int replicas>
+bool Run(uint64_t n) {
+  std::vector<uint64_t> in(n), out(n), expected(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    in[i] = i;
+    expected[i] = i;
+    for (uint64_t j = 0, steps = i % 7 * 100; j < steps; ++j) {
+      expected[i] = Hash(expected[i]);
+    }
+  }
+  tapa::invoke(Top<replicas>, "", tapa::read_only_mmap<const uint64_t>(in),
+               tapa::write_only_mmap<uint64_t>(out), n);
+
+  uint64_t error = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+    if (out[i] != expected[i]) {
+      if (error < 10) {
+        clog << replicas << " replica(s), " << n << " token(s): expected "
+             << expected[i] << " at " << i << ", got " << out[i] << endl;
+      }
+      ++error;
+    }
+  }
+  clog << replicas << " replica(s), " << n << " token(s): "
+       << (error ? "FAIL" : "PASS") << endl;
+  return error == 0;
+}
+
+template <int replicas>
+bool RunAll() {
+  bool is_ok = true;
+  for (uint64_t n : {uint64_t(0), uint64_t(1), uint64_t(2), uint64_t(10),
+                     uint64_t(FLAGS_n)}) {
+    is_ok &= Run<replicas>(n);
+  }
+  return is_ok;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  bool is_ok = true;
+  is_ok &= RunAll<1>();
+  is_ok &= RunAll<2>();
+  is_ok &= RunAll<10>();
+  clog << (is_ok ? "PASS!" : "FAIL!") << endl;
+  return is_ok ? 0 : 1;
+}
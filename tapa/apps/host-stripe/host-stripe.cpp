@@ -0,0 +1,111 @@
+// Checks `tapa::striped_mmap`: an array constructed from its size or from a
+// container is read back through its channels in array order, both on the host
+// and by a kernel that merges the channels with `tapa::merge_striped`. The
+// size is not a multiple of a round of blocks, so the channels differ in size.
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+
+DEFINE_uint64(n, 100003, "number of elements");
+
+constexpr uint64_t kChannels = 4;
+constexpr uint64_t kGranularity = 3;
+
+using layout = tapa::striped_layout<kChannels, kGranularity>;
+
+void Load(tapa::mmap<float> channel, tapa::ostream<float>& out,
+          uint64_t ch, uint64_t n) {
+  for (uint64_t i = 0; i < layout::channel_size(n, ch); ++i) {
+    out.write(channel[i]);
+  }
+}
+
+void Merge(tapa::istreams<float, kChannels>& channels,
+           tapa::ostream<float>& out, uint64_t n) {
+  tapa::merge_striped<kChannels, kGranularity>(channels, out, n);
+}
+
+void Store(tapa::istream<float>& in, tapa::mmap<float> out, uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+    out[i] = in.read();
+  }
+}
+
+void Stripe(tapa::mmaps<float, kChannels> channels, tapa::mmap<float> out,
+            uint64_t n) {
+  tapa::streams<float, kChannels> channel_q("channel_q");
+  tapa::stream<float> q("q");
+  tapa::task()
+      .invoke<tapa::join, kChannels>(Load, channels, channel_q, tapa::seq(), n)
+      .invoke(Merge, channel_q, q, n)
+      .invoke(Store, q, out, n);
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const uint64_t n = FLAGS_n;
+  std::vector<float> expected(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    expected[i] = static_cast<float>(i);
+  }
+
+  int error = 0;
+  auto check = [&error, &expected](const char* name,
+                                   const std::vector<float>& actual) {
+    for (uint64_t i = 0; i < expected.size(); ++i) {
+      if (actual[i] != expected[i]) {
+        clog << name << ": expected " << expected[i] << " at " << i
+             << ", got " << actual[i] << endl;
+        ++error;
+        return;
+      }
+    }
+  };
+
+  // an int size selects the size constructor, not the container one
+  tapa::striped_mmap<float, kChannels, kGranularity> sized(static_cast<int>(n));
+  for (uint64_t i = 0; i < n; ++i) {
+    if (sized[i] != 0.f) {
+      clog << "sized: element " << i << " is not value-initialized" << endl;
+      ++error;
+      break;
+    }
+    sized[i] = expected[i];
+  }
+  tapa::striped_mmap<float, kChannels, kGranularity> from_container(expected);
+
+  for (auto* array : {&sized, &from_container}) {
+    const char* name = array == &sized ? "sized" : "from container";
+    for (uint64_t ch = 0; ch < kChannels; ++ch) {
+      if (array->channels()[ch].size() != layout::channel_size(n, 0)) {
+        clog << name << ": channel " << ch << " is not padded" << endl;
+        ++error;
+      }
+    }
+
+    std::vector<float> gathered(n);
+    array->gather(gathered);
+    check(name, gathered);
+
+    std::vector<float> merged(n);
+    tapa::invoke(Stripe, "",
+                 tapa::read_only_mmaps<float, kChannels>(array->channels()),
+                 tapa::write_only_mmap<float>(merged), n);
+    check(name, merged);
+  }
+
+  if (error == 0) {
+    clog << "PASS!" << endl;
+  } else {
+    clog << "FAIL!" << endl;
+  }
+  return error > 0 ? 1 : 0;
+}
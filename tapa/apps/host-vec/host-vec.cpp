@@ -0,0 +1,144 @@
+// Compares the element-wise operations of `tapa::vec_t`, which are vectorized
+// explicitly for common element types and lengths, with the element-by-element
+// loops they replace. The kernel mimics the inner loops of wide-datapath
+// designs simulated on the host, e.g., the squared distances of knn and the
+// multiply-accumulate of cnn, for several element types and lengths.
+//
+// Results must be bit-identical. Define TAPA_DISABLE_SIMD to make both sides
+// use the loops.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+
+DEFINE_uint64(n, 1024 * 1024, "number of vectors");
+DEFINE_uint64(iterations, 16, "number of passes over the vectors");
+
+template <typename Func>
+double Time(const Func& func) {
+  const auto tic = std::chrono::steady_clock::now();
+  func();
+  const auto toc = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(toc - tic).count();
+}
+
+// The element-by-element loops that `tapa::vec_t` used for every operation.
+template <typename T, int N>
+struct loop_vec {
+  std::array<T, N> data;
+
+  loop_vec operator+(const loop_vec& rhs) const {
+    loop_vec result;
+    for (int i = 0; i < N; ++i) result.data[i] = data[i] + rhs.data[i];
+    return result;
+  }
+  loop_vec operator-(const loop_vec& rhs) const {
+    loop_vec result;
+    for (int i = 0; i < N; ++i) result.data[i] = data[i] - rhs.data[i];
+    return result;
+  }
+  loop_vec operator*(const loop_vec& rhs) const {
+    loop_vec result;
+    for (int i = 0; i < N; ++i) result.data[i] = data[i] * rhs.data[i];
+    return result;
+  }
+};
+
+template <typename T, int N>
+loop_vec<T, N> Max(const loop_vec<T, N>& lhs, const loop_vec<T, N>& rhs) {
+  loop_vec<T, N> result;
+  for (int i = 0; i < N; ++i) {
+    result.data[i] = std::max(lhs.data[i], rhs.data[i]);
+  }
+  return result;
+}
+
+template <typename T, int N>
+tapa::vec_t<T, N> Max(const tapa::vec_t<T, N>& lhs,
+                      const tapa::vec_t<T, N>& rhs) {
+  return tapa::max(lhs, rhs);
+}
+
+template <typename Vec>
+Vec Load(const void* ptr) {
+  Vec vec;
+  std::memcpy(&vec, ptr, sizeof(vec));
+  return vec;
+}
+
+// For every vector, accumulates `(x - ref) * (x - ref)` and keeps the
+// element-wise maximum of `x * w + b`.
+template <typename Vec>
+void Kernel(const std::vector<char>& points, const void* ref_ptr,
+            Vec& acc, Vec& peak) {
+  auto ref = Load<Vec>(ref_ptr);
+  const uint64_t n = points.size() / sizeof(Vec);
+  for (uint64_t it = 0; it < FLAGS_iterations; ++it) {
+    for (uint64_t i = 0; i < n; ++i) {
+      auto x = Load<Vec>(points.data() + i * sizeof(Vec));
+      auto diff = x - ref;
+      acc = acc + diff * diff;
+      peak = Max(peak, x * ref + diff);
+    }
+  }
+}
+
+template <typename T, int N>
+bool Run(const char* name) {
+  std::vector<char> points(FLAGS_n * sizeof(T) * N);
+  std::vector<T> ref(N);
+  uint64_t lfsr = 1;
+  for (uint64_t i = 0; i < FLAGS_n * N + N; ++i) {
+    // xorshift64 as a cheap, reproducible random value
+    lfsr ^= lfsr << 13;
+    lfsr ^= lfsr >> 7;
+    lfsr ^= lfsr << 17;
+    const T value = std::is_floating_point<T>::value
+                        ? T(int64_t(lfsr % 2001) - 1000) / T(100)
+                        : T(lfsr);
+    if (i < FLAGS_n * N) {
+      std::memcpy(points.data() + i * sizeof(T), &value, sizeof(T));
+    } else {
+      ref[i - FLAGS_n * N] = value;
+    }
+  }
+
+  loop_vec<T, N> loop_acc{}, loop_peak{};
+  const double loop_time = Time(
+      [&] { Kernel(points, ref.data(), loop_acc, loop_peak); });
+  tapa::vec_t<T, N> simd_acc{}, simd_peak{};
+  const double simd_time = Time(
+      [&] { Kernel(points, ref.data(), simd_acc, simd_peak); });
+
+  clog << name << ": loops " << loop_time << " s, vec_t " << simd_time
+       << " s, speedup " << loop_time / simd_time << "x" << endl;
+  return std::memcmp(&loop_acc, &simd_acc, sizeof(simd_acc)) == 0 &&
+         std::memcmp(&loop_peak, &simd_peak, sizeof(simd_peak)) == 0;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  bool is_identical = true;
+  is_identical &= Run<float, 16>("vec_t<float, 16>");
+  is_identical &= Run<float, 8>("vec_t<float, 8>");
+  is_identical &= Run<double, 8>("vec_t<double, 8>");
+  is_identical &= Run<int32_t, 16>("vec_t<int32_t, 16>");
+  is_identical &= Run<int16_t, 32>("vec_t<int16_t, 32>");
+
+  if (!is_identical) {
+    clog << "FAIL!" << endl;
+    return 1;
+  }
+  clog << "PASS!" << endl;
+  return 0;
+}
@@ -0,0 +1,26 @@
+"""Checks that tapacc counts the tokens of the busiest branch of Classify."""
+
+import json
+import sys
+
+
+def main(program_json: str) -> int:
+  with open(program_json) as fp:
+    program = json.load(fp)
+  loops = program['tasks']['Classify']['throughput']['loops']
+  expected = {'in': 1, 'out[0]': 1, 'out[1]': 1, 'out[2]': 2}
+  for loop in loops:
+    if 'in' not in loop['tokens']:
+      continue
+    if loop['tokens'] != expected or loop['ii'] != 2:
+      print(f'expected tokens {expected} and II 2, got {loop["tokens"]} and '
+            f'II {loop["ii"]}')
+      return 1
+    print('PASS!')
+    return 0
+  print(f'no loop of Classify reads in: {loops}')
+  return 1
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv[1]))
@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+using std::vector;
+
+void StreamBranch(tapa::mmap<const int> values, tapa::mmaps<int64_t, 3> sums,
+                  uint64_t n);
+
+DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const uint64_t n = argc > 1 ? atoll(argv[1]) : 1024 * 1024;
+  vector<int> values(n);
+  int64_t expected[3] = {};
+  for (uint64_t i = 0; i < n; ++i) {
+    values[i] = static_cast<int>(i * 7 % 1000) - 500;
+    const int value = values[i];
+    expected[0] += value < 0 ? -value : value;
+    expected[1] += value < 0 ? -1 : 1;
+    const int mod = (value % 3 + 3) % 3;
+    expected[2] += mod == 0 ? 1 : mod;
+  }
+  vector<vector<int64_t>> sums(3, vector<int64_t>(1));
+  int64_t kernel_time_ns = tapa::invoke(
+      StreamBranch, FLAGS_bitstream, tapa::read_only_mmap<const int>(values),
+      tapa::write_only_mmaps<int64_t, 3>(sums), n);
+  clog << "kernel time: " << kernel_time_ns * 1e-9 << " s" << endl;
+
+  uint64_t num_errors = 0;
+  for (int i = 0; i < 3; ++i) {
+    if (sums[i][0] != expected[i]) {
+      clog << "sum #" << i << ": expected: " << expected[i]
+           << ", actual: " << sums[i][0] << endl;
+      ++num_errors;
+    }
+  }
+  if (num_errors == 0) {
+    clog << "PASS!" << endl;
+  } else {
+    clog << "FAIL!" << endl;
+  }
+  return num_errors > 0 ? 1 : 0;
+}
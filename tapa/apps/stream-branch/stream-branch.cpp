@@ -0,0 +1,61 @@
+#include <cstdint>
+
+#include <tapa.h>
+
+// Classify writes each output once per iteration from mutually exclusive
+// branches, so its loop reaches II 1, except that a multiple of 3 falls
+// through to the next `case` and writes `out[2]` twice.
+
+void Produce(tapa::mmap<const int> values, tapa::ostream<int>& out,
+             uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) out.write(values[i]);
+  out.close();
+}
+
+void Classify(tapa::istream<int>& in, tapa::ostreams<int, 3>& out) {
+  [[tapa::pipeline(1)]] TAPA_WHILE_NOT_EOT(in) {
+    const int value = in.read(nullptr);
+    // absolute value
+    if (value < 0) {
+      out[0].write(-value);
+    } else {
+      out[0].write(value);
+    }
+    // sign
+    value < 0 ? out[1].write(-1) : out[1].write(1);
+    // remainder of division by 3, twice for multiples of 3
+    switch ((value % 3 + 3) % 3) {
+      case 0:
+        out[2].write(0);
+        [[fallthrough]];
+      case 1:
+        out[2].write(1);
+        break;
+      default:
+        out[2].write(2);
+        break;
+    }
+  }
+  in.open();
+  out[0].close();
+  out[1].close();
+  out[2].close();
+}
+
+void Sum(tapa::istream<int>& in, tapa::mmap<int64_t> sum) {
+  int64_t total = 0;
+  TAPA_WHILE_NOT_EOT(in) { total += in.read(nullptr); }
+  in.open();
+  sum[0] = total;
+}
+
+void StreamBranch(tapa::mmap<const int> values, tapa::mmaps<int64_t, 3> sums,
+                  uint64_t n) {
+  tapa::stream<int> values_q("values");
+  tapa::streams<int, 3> class_q("class");
+
+  tapa::task()
+      .invoke(Produce, values, values_q, n)
+      .invoke(Classify, values_q, class_q)
+      .invoke<tapa::join, 3>(Sum, class_q, sums);
+}
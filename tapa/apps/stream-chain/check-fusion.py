@@ -0,0 +1,27 @@
+"""Checks that `tapac --fuse-tasks` fuses Scale, Offset, and Clamp."""
+
+import json
+import os
+import sys
+
+
+def main(program_json: str) -> int:
+  with open(os.path.join(os.path.dirname(program_json), 'fusion.json')) as fp:
+    report = json.load(fp)
+  with open(program_json) as fp:
+    program = json.load(fp)
+  for name, info in report.get('StreamChain', {}).items():
+    if info['instances'] != ['Scale_0', 'Offset_0', 'Clamp_0']:
+      continue
+    code = program['tasks'][name]['code']
+    if code.count('tapa::internal::fused_istream<float, ') != 2:
+      print(f'{name} does not read its channels via fused_istream')
+      return 1
+    print('PASS!')
+    return 0
+  print(f'the chain is not fused: {report}')
+  return 1
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv[1]))
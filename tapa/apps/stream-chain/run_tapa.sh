@@ -0,0 +1,15 @@
+#! /bin/bash
+
+WORK_DIR=run
+mkdir -p "${WORK_DIR}"
+
+tapac \
+  --work-dir "${WORK_DIR}" \
+  --top StreamChain \
+  --part-num xcu250-figd2104-2L-e \
+  --clock-period 3.33 \
+  --fuse-tasks \
+  -o "${WORK_DIR}/StreamChain.xo" \
+  --floorplan-output "${WORK_DIR}/StreamChain_floorplan.tcl" \
+  --connectivity link_config.ini \
+  stream-chain.cpp
@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <tapa.h>
+
+using std::clog;
+using std::endl;
+using std::vector;
+
+void StreamChain(tapa::mmap<const float> in, tapa::mmap<float> out,
+                 uint64_t n);
+
+DEFINE_string(bitstream, "", "path to bitstream file, run csim if empty");
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const uint64_t n = argc > 1 ? atoll(argv[1]) : 1024 * 1024;
+  vector<float> in(n);
+  vector<float> out(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    in[i] = static_cast<float>(i) - static_cast<float>(n / 2);
+    out[i] = 0.f;
+  }
+  int64_t kernel_time_ns = tapa::invoke(StreamChain, FLAGS_bitstream,
+                                        tapa::read_only_mmap<const float>(in),
+                                        tapa::write_only_mmap<float>(out), n);
+  clog << "kernel time: " << kernel_time_ns * 1e-9 << " s" << endl;
+
+  uint64_t num_errors = 0;
+  const uint64_t threshold = 10;  // only report up to these errors
+  for (uint64_t i = 0; i < n; ++i) {
+    auto expected = std::max(in[i] * 2.f + 1.f, 0.f);
+    auto actual = out[i];
+    if (actual != expected) {
+      if (num_errors < threshold) {
+        clog << "expected: " << expected << ", actual: " << actual << endl;
+      } else if (num_errors == threshold) {
+        clog << "...";
+      }
+      ++num_errors;
+    }
+  }
+  if (num_errors == 0) {
+    clog << "PASS!" << endl;
+  } else {
+    if (num_errors > threshold) {
+      clog << " (+" << (num_errors - threshold) << " more errors)" << endl;
+    }
+    clog << "FAIL!" << endl;
+  }
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstdint>
+
+#include <tapa.h>
+
+void Load(tapa::mmap<const float> mmap, uint64_t n,
+          tapa::ostream<float>& stream) {
+  for (uint64_t i = 0; i < n; ++i) {
+    stream << mmap[i];
+  }
+  stream.close();
+}
+
+// Scale, Offset, and Clamp each stream one input to one output at the same
+// rate, so `tapac --fuse-tasks` fuses them into one task.
+void Scale(tapa::istream<float>& in, tapa::ostream<float>& out) {
+scale:
+  TAPA_WHILE_NOT_EOT(in) { out.write(in.read(nullptr) * 2.f); }
+  out.close();
+}
+
+void Offset(tapa::istream<float>& in, tapa::ostream<float>& out) {
+offset:
+  [[tapa::pipeline(1)]] for (bool valid, eot;;) {
+    const float value = in.peek(valid, eot);
+    if (valid) {
+      if (eot) break;
+      in.read(nullptr);
+      out.write(value + 1.f);
+    }
+  }
+  out.close();
+}
+
+void Clamp(tapa::istream<float>& in, tapa::ostream<float>& out) {
+clamp:
+  TAPA_WHILE_NOT_EOT(in) { out.write(std::max(in.read(nullptr), 0.f)); }
+  out.close();
+}
+
+void Store(tapa::istream<float>& stream, tapa::mmap<float> mmap) {
+  uint64_t i = 0;
+store:
+  TAPA_WHILE_NOT_EOT(stream) { mmap[i++] = stream.read(nullptr); }
+}
+
+void StreamChain(tapa::mmap<const float> in, tapa::mmap<float> out,
+                 uint64_t n) {
+  tapa::stream<float> load_q("load");
+  tapa::stream<float> scale_q("scale");
+  tapa::stream<float> offset_q("offset");
+  tapa::stream<float> clamp_q("clamp");
+
+  tapa::task()
+      .invoke(Load, in, n, load_q)
+      .invoke(Scale, load_q, scale_q)
+      .invoke(Offset, scale_q, offset_q)
+      .invoke(Clamp, offset_q, clamp_q)
+      .invoke(Store, clamp_q, out);
+}
@@ -15,7 +15,11 @@ module async_mmap #(
   parameter EnableWriteChannel= 1,
   // for burst inference
   parameter MaxWaitTime       = 3,
-  parameter MaxBurstLen       = 15
+  parameter MaxBurstLen       = 15,
+  // for strided and gathered reads; see detect_burst
+  parameter MaxReadGap        = 0,
+  parameter ReadCacheDepth    = 0,
+  parameter PatternWidth      = 8
 ) (
   input wire clk,
   input wire rst, // active high
@@ -181,7 +185,12 @@ module async_mmap #(
     // output: used to generate write responses
     .burst_len_1_din   (write_req_din),
     .burst_len_1_full_n(write_req_full_n),
-    .burst_len_1_write (write_req_write)
+    .burst_len_1_write (write_req_write),
+
+    // output: access pattern, unused
+    .pattern_din   (),
+    .pattern_full_n(1'b1),
+    .pattern_write ()
   );
 
   relay_station #(
@@ -431,11 +440,20 @@ module async_mmap #(
     .if_dout   ({burst_read_addr_dout_burst_len, burst_read_addr_dout_addr})
   );
 
+  localparam EnableReadPattern = MaxReadGap > 0 || ReadCacheDepth > 0;
+
+  wire [PatternWidth:0] read_pattern_din;
+  wire                  read_pattern_full_n;
+  wire                  read_pattern_write;
+
   detect_burst #(
     .AddrWidth        (AddrWidth),
     .DataWidthBytesLog(DataWidthBytesLog),
     .WaitTimeWidth    (WaitTimeWidth),
-    .BurstLenWidth    (BurstLenWidth)
+    .BurstLenWidth    (BurstLenWidth),
+    .MaxGap           (MaxReadGap),
+    .CacheDepth       (ReadCacheDepth),
+    .PatternWidth     (PatternWidth)
   ) detect_burst_read (
     .clk(clk),
     .rst(rst),
@@ -461,7 +479,12 @@ module async_mmap #(
     // output: used to generate write responses, unused
     .burst_len_1_din   (),
     .burst_len_1_full_n(1'b1),
-    .burst_len_1_write ()
+    .burst_len_1_write (),
+
+    // output: used to map data beats back to addresses
+    .pattern_din   (read_pattern_din),
+    .pattern_full_n(read_pattern_full_n),
+    .pattern_write (read_pattern_write)
   );
 
   // read resp buffer
@@ -505,9 +528,62 @@ module async_mmap #(
   assign m_axi_ARQOS          = 0;
 
   // R channel
-  assign m_axi_RREADY    = read_data_full_n;
-  assign read_data_write = m_axi_RVALID;
-  assign read_data_din   = m_axi_RDATA;
+  generate
+  if (EnableReadPattern) begin : read_pattern
+    wire [PatternWidth:0] dout;
+    wire                  empty_n;
+    wire                  read;
+
+    relay_station #(
+      .DATA_WIDTH(PatternWidth + 1),
+      .ADDR_WIDTH(BufferSizeLog),
+      .DEPTH     (BufferSize),
+      .LEVEL     (1),
+      .CONNECT   (EnableReadChannel)
+    ) fifo (
+      .clk  (clk),
+      .reset(rst),
+
+      // from burst detector
+      .if_full_n  (read_pattern_full_n),
+      .if_write_ce(1'b1),
+      .if_write   (read_pattern_write),
+      .if_din     (read_pattern_din),
+
+      // to read gather
+      .if_empty_n(empty_n),
+      .if_read_ce(1'b1),
+      .if_read   (read),
+      .if_dout   (dout)
+    );
+
+    read_gather #(
+      .DataWidth   (DataWidth),
+      .PatternWidth(PatternWidth),
+      .CacheDepth  (ReadCacheDepth)
+    ) gather (
+      .clk(clk),
+      .rst(rst),
+
+      .pattern_dout   (dout),
+      .pattern_empty_n(empty_n),
+      .pattern_read   (read),
+
+      .beat_data (m_axi_RDATA),
+      .beat_valid(m_axi_RVALID),
+      .beat_ready(m_axi_RREADY),
+
+      .read_data_din   (read_data_din),
+      .read_data_full_n(read_data_full_n),
+      .read_data_write (read_data_write)
+    );
+  end else begin : read_pattern
+    assign read_pattern_full_n = 1'b1;
+    assign m_axi_RREADY    = read_data_full_n;
+    assign read_data_write = m_axi_RVALID;
+    assign read_data_din   = m_axi_RDATA;
+  end
+  endgenerate
 
   // unused input signals
   wire _unused = &{1'b0,
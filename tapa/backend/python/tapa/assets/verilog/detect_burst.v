@@ -1,11 +1,21 @@
 `default_nettype none
 
 // Detect burst from address stream.
+//
+// With MaxGap > 0, an address at most MaxGap words past the end of the current
+// burst extends the burst over the skipped words. With CacheDepth > 0, an
+// address among the last CacheDepth words of the current burst joins it
+// without fetching again. For every address, `pattern` tells how the data
+// beats of the bursts map back to the addresses: {1'b0, n} drops n beats and
+// then forwards one, and {1'b1, n} repeats the n-th most recent beat.
 module detect_burst #(
   parameter AddrWidth         = 64,
   parameter DataWidthBytesLog = 6,
   parameter WaitTimeWidth     = 4,
-  parameter BurstLenWidth     = 8
+  parameter BurstLenWidth     = 8,
+  parameter MaxGap            = 0,
+  parameter CacheDepth        = 0,
+  parameter PatternWidth      = 8
 ) (
   input wire clk,
   input wire rst,
@@ -27,7 +37,11 @@ module detect_burst #(
 
   output wire [BurstLenWidth-1:0] burst_len_1_din,
   input  wire                     burst_len_1_full_n,
-  output wire                     burst_len_1_write
+  output wire                     burst_len_1_write,
+
+  output reg  [PatternWidth:0] pattern_din,
+  input  wire                  pattern_full_n,
+  output wire                  pattern_write
 );
   // parameter
   localparam NextAddrWidth = AddrWidth - DataWidthBytesLog;
@@ -41,6 +55,7 @@ module detect_burst #(
 
   // logic
   reg                     write_enable;
+  reg                     pattern_enable;
   reg [AddrWidth-1:0]     base_addr_next;
   reg                     base_valid_next;
   reg [BurstLenWidth-1:0] burst_len_next;
@@ -52,27 +67,50 @@ module detect_burst #(
       {{(NextAddrWidth-1){1'b0}}, 1'b1};
 
   assign addr_write = write_enable;
+  assign pattern_write = pattern_enable;
   assign burst_len_0_write = write_enable;
   assign burst_len_1_write = write_enable;
   assign addr_din = {burst_len, base_addr};
   assign burst_len_0_din = burst_len;
   assign burst_len_1_din = burst_len;
 
+  // bursts can be written out
+  wire out_ready = addr_full_n && burst_len_0_full_n && burst_len_1_full_n;
+  // addresses can be taken in; a full pattern FIFO must not block writing out
+  // the current burst, whose data are needed to drain it
+  wire in_ready = out_ready && pattern_full_n;
+
   // register the input for timing closure
   reg addr_empty_n_q;
   reg [AddrWidth-1:0] addr_dout_q;
   always @(posedge clk) begin
-    if (addr_full_n && burst_len_0_full_n && burst_len_1_full_n) begin
+    if (in_ready) begin
       addr_empty_n_q <= addr_empty_n;
       addr_dout_q <= addr_dout;
     end
   end
   wire [AddrWidth-1:0] curr_addr = addr_dout_q;
 
+  // position of the current address relative to the current burst
+  wire [NextAddrWidth-1:0] curr_word = curr_addr[AddrWidth-1:DataWidthBytesLog];
+  wire [NextAddrWidth-1:0] base_word = base_addr[AddrWidth-1:DataWidthBytesLog];
+  // words skipped if the current address extends the burst
+  wire [NextAddrWidth-1:0] gap = curr_word - next_addr;
+  // words between the current address and the end of the burst
+  wire [NextAddrWidth-1:0] distance =
+      next_addr - curr_word - {{(NextAddrWidth-1){1'b0}}, 1'b1};
+  wire is_extend =
+      curr_word >= next_addr && gap <= MaxGap &&
+      {{(NextAddrWidth-BurstLenWidth){1'b0}}, burst_len} + gap <
+          {{(NextAddrWidth-BurstLenWidth){1'b0}}, max_burst_len};
+  wire is_hit =
+      CacheDepth > 0 && curr_word < next_addr && curr_word >= base_word &&
+      distance < CacheDepth;
+
   always @* begin
     // defaults
     addr_read = 1'b0;
-    if (!addr_full_n || !burst_len_0_full_n || !burst_len_1_full_n) begin
+    if (!in_ready) begin
       addr_read = 1'b0;
     end else if (addr_empty_n) begin
       // read new item if non-empty
@@ -85,14 +123,17 @@ module detect_burst #(
   always @* begin
     // defaults
     write_enable = 1'b0;
+    pattern_enable = 1'b0;
+    pattern_din = {(PatternWidth+1){1'b0}};
     base_addr_next = base_addr;
     base_valid_next = base_valid;
     wait_time_next = wait_time;
     burst_len_next = burst_len;
-    if (!addr_full_n || !burst_len_0_full_n || !burst_len_1_full_n) begin
+    if (!out_ready) begin
       // output FIFO full, do nothing
-    end else if (addr_empty_n_q) begin
+    end else if (addr_empty_n_q && pattern_full_n) begin
       wait_time_next = 0;
+      pattern_enable = 1'b1;
       if (!base_valid) begin
         base_addr_next = curr_addr;
         base_valid_next = 1'b1;
@@ -100,9 +141,15 @@ module detect_burst #(
         write_enable = 1'b0;
         burst_len_next = burst_len;
       end else begin
-        if (next_addr == curr_addr[AddrWidth-1:DataWidthBytesLog] &&
-            burst_len < max_burst_len) begin
-          burst_len_next = burst_len + 1;
+        if (is_extend) begin
+          burst_len_next = burst_len + gap[BurstLenWidth-1:0] + 1;
+          pattern_din = {1'b0, gap[PatternWidth-1:0]};
+
+          write_enable = 1'b0;
+          base_addr_next = base_addr;
+          base_valid_next = base_valid;
+        end else if (is_hit) begin
+          pattern_din = {1'b1, distance[PatternWidth-1:0]};
 
           write_enable = 1'b0;
           base_addr_next = base_addr;
@@ -0,0 +1,69 @@
+`default_nettype none
+
+// Maps the data beats of the read bursts inferred by detect_burst back to the
+// requested addresses, following the `pattern` of each address.
+module read_gather #(
+  parameter DataWidth    = 512,
+  parameter PatternWidth = 8,
+  parameter CacheDepth   = 0
+) (
+  input wire clk,
+  input wire rst,
+
+  input  wire [PatternWidth:0] pattern_dout,
+  input  wire                  pattern_empty_n,
+  output wire                  pattern_read,
+
+  // data beats from the AXI read channel
+  input  wire [DataWidth-1:0] beat_data,
+  input  wire                 beat_valid,
+  output wire                 beat_ready,
+
+  // data of the requested addresses
+  output wire [DataWidth-1:0] read_data_din,
+  input  wire                 read_data_full_n,
+  output wire                 read_data_write
+);
+  // parameter
+  localparam HistoryDepth = CacheDepth > 0 ? CacheDepth : 1;
+
+  // state
+  reg [PatternWidth-1:0] dropped;  // beats dropped for the current address
+  reg [DataWidth-1:0]    history [0:HistoryDepth-1];  // most recent beats
+
+  // logic
+  wire                    is_hit = pattern_dout[PatternWidth];
+  wire [PatternWidth-1:0] count  = pattern_dout[PatternWidth-1:0];
+  wire is_drop = pattern_empty_n && !is_hit && dropped != count;
+  wire is_pass = pattern_empty_n && !is_hit && dropped == count;
+  wire is_repeat = pattern_empty_n && is_hit;
+
+  assign beat_ready = is_drop || (is_pass && read_data_full_n);
+  assign read_data_write =
+      read_data_full_n && (is_repeat || (is_pass && beat_valid));
+  assign read_data_din = is_repeat ? history[count] : beat_data;
+  assign pattern_read = read_data_write;
+
+  wire beat_fire = beat_valid && beat_ready;
+
+  always @(posedge clk) begin
+    if (rst) begin
+      dropped <= {PatternWidth{1'b0}};
+    end else if (beat_fire) begin
+      dropped <= is_drop ? dropped + 1 : {PatternWidth{1'b0}};
+    end
+  end
+
+  integer i;
+  always @(posedge clk) begin
+    if (beat_fire) begin
+      history[0] <= beat_data;
+      for (i = 1; i < HistoryDepth; i = i + 1) begin
+        history[i] <= history[i-1];
+      end
+    end
+  end
+
+endmodule  // read_gather
+
+`default_nettype wire
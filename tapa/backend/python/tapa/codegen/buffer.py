@@ -26,6 +26,8 @@ class BufferConfig:
     type: A string indicating the type of a word (e.g. float, int)
     dims: A list containing the size of each dimension
     partitions: A list containing PartitionConfig of each dimension
+    watermark: Whether sections hand over sub-tile progress through an extra
+      watermark FIFO from the producer to the consumer
   """
 
   class DIR:
@@ -43,6 +45,10 @@ class BufferConfig:
       self.partitions.append(
           PartitionDim(partition["type"], partition["factor"]))
     self.memcore_type = obj["memcore_type"]
+    self.watermark = obj.get("watermark", False)
+    # for `AUTO` memcores, the selected memory of each memcore; not part of
+    # the config identity, as it is derived from it
+    self.memcore_banks = ()
 
 
   def __eq__(self, other: 'BufferConfig') -> bool:
@@ -51,12 +57,13 @@ class BufferConfig:
             self.dims == other.dims and \
             self.n_sections == other.n_sections and \
             self.memcore_type == other.memcore_type and \
+            self.watermark == other.watermark and \
             all([left == right for left, right in zip(self.partitions, other.partitions)])
 
 
   def __hash__(self) -> int:
     return hash((self.width, self.type, tuple(self.dims), self.n_sections,
-                 tuple(self.partitions), self.memcore_type))
+                 tuple(self.partitions), self.memcore_type, self.watermark))
 
 
   def get_dim_patterns(self) -> List[int]:
@@ -93,29 +100,51 @@ class BufferConfig:
 
 
   def get_producer_fifo_port_names(self) -> Tuple[str]:
-    return (
+    names = (
         'fifo_free_buffers_empty_n',
         'fifo_free_buffers_read',
         'fifo_free_buffers_dout',
         'fifo_occupied_buffers_full_n',
         'fifo_occupied_buffers_write',
         'fifo_occupied_buffers_din',
+    )
+    if self.watermark:
+      names += (
+          'fifo_watermark_full_n',
+          'fifo_watermark_write',
+          'fifo_watermark_din',
+      )
+    names += (
         'fifo_free_buffers_read_ce',
         'fifo_occupied_buffers_write_ce',
     )
+    if self.watermark:
+      names += ('fifo_watermark_write_ce',)
+    return names
 
 
   def get_consumer_fifo_port_names(self) -> Tuple[str]:
-    return (
+    names = (
         'fifo_occupied_buffers_empty_n',
         'fifo_occupied_buffers_read',
         'fifo_occupied_buffers_dout',
         'fifo_free_buffers_full_n',
         'fifo_free_buffers_write',
         'fifo_free_buffers_din',
+    )
+    if self.watermark:
+      names += (
+          'fifo_watermark_empty_n',
+          'fifo_watermark_read',
+          'fifo_watermark_dout',
+      )
+    names += (
         'fifo_occupied_buffers_read_ce',
         'fifo_free_buffers_write_ce',
     )
+    if self.watermark:
+      names += ('fifo_watermark_read_ce',)
+    return names
 
 
   def get_buffer_port_names(self) -> Tuple[str]:
@@ -167,7 +196,14 @@ class BufferConfig:
          True),
         ('_fifo_free_buffers_din', 32, BufferConfig.DIR.OUTPUT, '_sink_din',
          True),
-    )
+    ) + ((
+        ('_fifo_watermark_empty_n', 1, BufferConfig.DIR.INPUT,
+         '_watermark_empty_n', True),
+        ('_fifo_watermark_read', 1, BufferConfig.DIR.OUTPUT,
+         '_watermark_read', True),
+        ('_fifo_watermark_dout', 32, BufferConfig.DIR.INPUT,
+         '_watermark_dout', True),
+    ) if self.watermark else ())
 
 
   def get_producer_fifo_suffixes(self) -> Tuple[Tuple[str, int]]:
@@ -184,7 +220,14 @@ class BufferConfig:
          '_sink_write', True),
         ('_fifo_occupied_buffers_din', 32, BufferConfig.DIR.OUTPUT, '_sink_din',
          True),
-    )
+    ) + ((
+        ('_fifo_watermark_full_n', 1, BufferConfig.DIR.INPUT,
+         '_watermark_full_n', True),
+        ('_fifo_watermark_write', 1, BufferConfig.DIR.OUTPUT,
+         '_watermark_write', True),
+        ('_fifo_watermark_din', 32, BufferConfig.DIR.OUTPUT,
+         '_watermark_din', True),
+    ) if self.watermark else ())
 
 
   # suffix, width, wire_dir, port_suffix, _
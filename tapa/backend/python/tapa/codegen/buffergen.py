@@ -361,10 +361,13 @@ def generate_memcore_instance(module_name, instance_name, io_prefix):
 
 
 # generate a URAM or BRAM memcore instance while given a dims array
+# ram_style is either one style for all memcores or a tuple with the style of
+# each memcore in the order of dims
 def generate_memcore_instances(dims, ram_style):
   items = []
-  for integer in dims():
-    module_name = 'memcore_uram' if ram_style == "URAM" else "memcore_bram"
+  for i, integer in enumerate(dims()):
+    style = ram_style if isinstance(ram_style, str) else ram_style[i]
+    module_name = 'memcore_uram' if style == "URAM" else "memcore_bram"
     instance_name = f'core_{integer}'
     io_prefix = f'memcores_i{integer}'
     items.append(
@@ -507,13 +510,24 @@ def generate_fifo_port(prefix, fifo_data_width):
 
 
 # generate FIFOs for ping-pong buffer module
-def generate_double_buffer_fifo_ports():
+def generate_double_buffer_fifo_ports(watermark=False):
   ports = []
   ports.extend(generate_fifo_port("fifo_free_buffers", "FIFO_DATA_WIDTH"))
   ports.extend(generate_fifo_port("fifo_occupied_buffers", "FIFO_DATA_WIDTH"))
+  if watermark:
+    ports.extend(
+        generate_fifo_port("fifo_watermark", "WATERMARK_FIFO_DATA_WIDTH"))
   return ports
 
 
+# parameters of the producer-to-consumer watermark FIFO; it only needs to
+# absorb a few in-flight progress updates, as the producer drops the ones that
+# do not fit and only blocks on the release of a section
+WATERMARK_FIFO_PARAMETERS = [('WATERMARK_FIFO_DATA_WIDTH', 32),
+                             ('WATERMARK_FIFO_ADDR_WIDTH', 2),
+                             ('WATERMARK_FIFO_DEPTH', 4)]
+
+
 # generate a FIFO instance given module_name, instance_name, prefix, widths
 # depth and level
 # level indicates the level of pipelining and when that is present, init_length
@@ -637,7 +651,8 @@ def generate_laneswitches_instance(module_name, instance_name, dims, level=None)
 # generate ping-pong buffer module given parameter values, dims
 def generate_double_buffer_module(module_name, data_width, address_width,
                                   address_range, no_partitions, dims,
-                                  memcores_name, laneswitches_name=None):
+                                  memcores_name, laneswitches_name=None,
+                                  watermark=False):
   fifo_depth = no_partitions
   fifo_addr_width = max(1, ceil(log2(no_partitions)))
   parameters = [('MEMORY_DATA_WIDTH', data_width),
@@ -646,12 +661,14 @@ def generate_double_buffer_module(module_name, data_width, address_width,
                 ('FIFO_ADDR_WIDTH', fifo_addr_width),
                 ('FIFO_DEPTH', no_partitions),
                 ('FREE_FIFO_RESET_LENGTH', no_partitions), ('IS_SIMPLE', 0)]
+  if watermark:
+    parameters.extend(WATERMARK_FIFO_PARAMETERS)
   params = ast.Paramlist(
       [generate_const_parameter(k, v) for k, v in parameters])
   clk = generate_io_wire("clk", "input")
   reset = generate_io_wire("reset", "input")
   ports_list = [clk, reset]
-  ports_list.extend(generate_double_buffer_fifo_ports())
+  ports_list.extend(generate_double_buffer_fifo_ports(watermark))
 
   # specify hybrid buffer mode for buffer ports
   # standard mode => 1 port  each for prod/cons
@@ -689,6 +706,12 @@ def generate_double_buffer_module(module_name, data_width, address_width,
       generate_fifo_instance('initialized_fifo', 'free_buffers',
                              'fifo_free_buffers', 'FIFO_DATA_WIDTH',
                              'FIFO_ADDR_WIDTH', 'FIFO_DEPTH'))
+  if watermark:
+    items.append(
+        generate_fifo_instance('fifo', 'watermark', 'fifo_watermark',
+                               'WATERMARK_FIFO_DATA_WIDTH',
+                               'WATERMARK_FIFO_ADDR_WIDTH',
+                               'WATERMARK_FIFO_DEPTH'))
   
   return ast.ModuleDef(module_name, params, ports, items)
 
@@ -1116,7 +1139,8 @@ def generate_relay_memcores_instance(module_name, instance_name, dims, level=Non
 # geneate ping-pong buffer module with pipelining
 def generate_relay_double_buffer_module(module_name, data_width, address_width,
                                         address_range, no_partitions, dims,
-                                        memcores_name, default_level, laneswitches_name=None):
+                                        memcores_name, default_level, laneswitches_name=None,
+                                        watermark=False):
   fifo_depth = no_partitions
   fifo_addr_width = max(1, ceil(log2(no_partitions)))
   parameters = [('MEMORY_DATA_WIDTH', data_width),
@@ -1126,12 +1150,14 @@ def generate_relay_double_buffer_module(module_name, data_width, address_width,
                 ('FIFO_DEPTH', no_partitions),
                 ('FREE_FIFO_RESET_LENGTH', no_partitions),
                 ('LEVEL', default_level), ('IS_SIMPLE', 0)]
+  if watermark:
+    parameters.extend(WATERMARK_FIFO_PARAMETERS)
   params = ast.Paramlist(
       [generate_const_parameter(k, v) for k, v in parameters])
   clk = generate_io_wire("clk", "input")
   reset = generate_io_wire("reset", "input")
   ports_list = [clk, reset]
-  ports_list.extend(generate_double_buffer_fifo_ports())
+  ports_list.extend(generate_double_buffer_fifo_ports(watermark))
 
   # specify hybrid buffer mode for buffer ports
   # standard mode => 1 port  each for prod/cons
@@ -1161,6 +1187,12 @@ def generate_relay_double_buffer_module(module_name, data_width, address_width,
       generate_fifo_instance('initialized_relay_station', 'free_buffers',
                              'fifo_free_buffers', 'FIFO_DATA_WIDTH',
                              'FIFO_ADDR_WIDTH', 'FIFO_DEPTH', 'LEVEL'))
+  if watermark:
+    items.append(
+        generate_fifo_instance('relay_station', 'watermark', 'fifo_watermark',
+                               'WATERMARK_FIFO_DATA_WIDTH',
+                               'WATERMARK_FIFO_ADDR_WIDTH',
+                               'WATERMARK_FIFO_DEPTH', 'LEVEL'))
   
   # generate 
   items.append(generate_relay_memcores_instance(memcores_name, 'relay_ls_memcores', dims, 'LEVEL', hybrid=(no_partitions==1)))
@@ -1243,7 +1275,7 @@ def generate_relay_memcores_file(module_name, file_name, memcore_name, laneswitc
 
 def generate_buffer_files(buffer_name, dims_pattern, data_width, addr_width,
                           addr_range, default_latency, core_type, no_partitions,
-                          base_path):
+                          base_path, watermark=False):
   memcores_name = f'memcores_{buffer_name}'
   buffer_module_name = f'buffer_{buffer_name}'
   relay_memcores_name = f'relay_memcores_{buffer_name}'
@@ -1275,7 +1307,8 @@ def generate_buffer_files(buffer_name, dims_pattern, data_width, addr_width,
                                     no_partitions=no_partitions,
                                     dims=dims_pattern,
                                     memcores_name=memcores_name,
-                                    laneswitches_name=laneswitches_name),
+                                    laneswitches_name=laneswitches_name,
+                                    watermark=watermark),
       os.path.join(base_path, f'{buffer_module_name}.v'))
   generate_relay_memcores_file(module_name=relay_memcores_name,
                               file_name=os.path.join(
@@ -1296,7 +1329,8 @@ def generate_buffer_files(buffer_name, dims_pattern, data_width, addr_width,
                                           no_partitions=no_partitions,
                                           dims=dims_pattern,
                                           memcores_name=relay_memcores_name,
-                                          default_level=default_latency, laneswitches_name=laneswitches_name),
+                                          default_level=default_latency, laneswitches_name=laneswitches_name,
+                                          watermark=watermark),
       os.path.join(base_path, f'{relay_buffer_name}.v'))
 
 
@@ -1333,8 +1367,11 @@ def generate_buffer_from_config(buffer_unique_name, buffer_config, base_path, wo
 
   address_width = ceil(log2(size_memcore))
   core_type = buffer_config.memcore_type
+  if core_type == 'AUTO':
+    # selected per memcore by `select_memcores`
+    core_type = buffer_config.memcore_banks
 
   generate_buffer_files(buffer_name, dims_patterns, data_width, address_width,
                         size_memcore, 2, core_type, buffer_config.n_sections,
-                        base_path)
+                        base_path, buffer_config.watermark)
   # tapa.util.setup_logging(2, 1, work_dir)
@@ -0,0 +1,169 @@
+"""Automatic BRAM/URAM selection for buffers with `tapa::memcore<auto_core>`.
+
+Each bank (memcore) of a buffer is mapped to either BRAM or URAM. Buffers
+are visited from the largest to the smallest, and each one takes the number
+of URAM banks that keeps the higher of the BRAM and URAM utilizations of the
+device the lowest; buffers with more than one bank can therefore end up with
+a mix of both. All instances of a buffer config share its selection, so the
+memory of a config is that of one buffer times the number of its instances.
+"""
+
+import json
+import logging
+from math import ceil
+from typing import Dict, List, Optional, Tuple
+
+from tapa.codegen.buffer import BufferConfig
+
+_logger = logging.getLogger().getChild(__name__)
+
+# (width, depth) aspect ratios of a BRAM_18K block
+BRAM_18K_SHAPES = ((1, 16384), (2, 8192), (4, 4096), (9, 2048), (18, 1024),
+                   (36, 512))
+
+# a URAM block is 72 bits wide and 4096 deep; deeper memories cascade blocks
+URAM_WIDTH = 72
+URAM_DEPTH = 4096
+
+# memories narrower or shallower than these waste most of a URAM block
+MIN_URAM_WIDTH = 36
+MIN_URAM_DEPTH = 1024
+
+
+def get_bram_count(width: int, depth: int) -> int:
+  return min(
+      ceil(width / w) * ceil(depth / d) for w, d in BRAM_18K_SHAPES)
+
+
+def get_uram_count(width: int, depth: int) -> int:
+  return ceil(width / URAM_WIDTH) * ceil(depth / URAM_DEPTH)
+
+
+def get_buffer_memory(buffer_config: BufferConfig,
+                      ram_styles: Tuple[str, ...]) -> Dict[str, int]:
+  """BRAM_18K and URAM blocks taken by a buffer with the given bank styles."""
+  width = buffer_config.width
+  depth = buffer_config.get_memcore_size()
+  return {
+      'BRAM_18K':
+          get_bram_count(width, depth) *
+          sum(style == 'BRAM' for style in ram_styles),
+      'URAM':
+          get_uram_count(width, depth) *
+          sum(style == 'URAM' for style in ram_styles),
+  }
+
+
+def select_memcores(
+    buffer_configs: Dict[str, BufferConfig],
+    device_memory: Dict[str, int],
+    used_memory: Dict[str, int],
+    report_file: str = '',
+    instance_counts: Optional[Dict[str, int]] = None,
+) -> Dict[str, Tuple[str, ...]]:
+  """Selects the memory of every bank of the `AUTO` buffers.
+
+  Args:
+    buffer_configs: Unique buffer configs, keyed by buffer module name.
+    device_memory: BRAM_18K and URAM blocks of the device.
+    used_memory: BRAM_18K and URAM blocks already taken, e.g., by the tasks.
+    report_file: If not empty, where to write a JSON report.
+    instance_counts: Number of buffer instances of each config in the design,
+      keyed by buffer module name; 1 for configs not in it.
+
+  Returns:
+    Dict mapping the module names of the `AUTO` buffers to the memory of each
+    bank, in the order banks are enumerated by `index_generator`.
+  """
+  if instance_counts is None:
+    instance_counts = {}
+
+  def get_memory(name: str, styles: Tuple[str, ...]) -> Dict[str, int]:
+    count = instance_counts.get(name, 1)
+    return {
+        key: value * count
+        for key, value in get_buffer_memory(buffer_configs[name],
+                                            styles).items()
+    }
+
+  used = dict(used_memory)
+  # buffers with a fixed memory take their share first
+  for name, buffer_config in buffer_configs.items():
+    if buffer_config.memcore_type != 'AUTO':
+      styles = (buffer_config.memcore_type,) * buffer_config.get_no_memcores()
+      for key, value in get_memory(name, styles).items():
+        used[key] += value
+
+  def utilization(memory: Dict[str, int]) -> float:
+    return max((used[key] + memory[key]) / device_memory[key]
+               for key in ('BRAM_18K', 'URAM') if device_memory[key] > 0)
+
+  auto_buffers = sorted(
+      ((name, config)
+       for name, config in buffer_configs.items()
+       if config.memcore_type == 'AUTO'),
+      key=lambda item: -item[1].width * item[1].get_memcore_size() * item[1].
+      get_no_memcores() * instance_counts.get(item[0], 1))
+
+  selections: Dict[str, Tuple[str, ...]] = {}
+  report: List[Dict] = []
+  for name, buffer_config in auto_buffers:
+    no_memcores = buffer_config.get_no_memcores()
+    width = buffer_config.width
+    depth = buffer_config.get_memcore_size()
+    candidates = [0]
+    if width >= MIN_URAM_WIDTH and depth >= MIN_URAM_DEPTH:
+      candidates = range(no_memcores + 1)
+    best_styles, best_memory, best_utilization = None, None, None
+    for no_urams in candidates:
+      styles = (('URAM',) * no_urams + ('BRAM',) *
+                (no_memcores - no_urams))
+      memory = get_memory(name, styles)
+      current = utilization(memory)
+      if best_utilization is None or current < best_utilization:
+        best_styles, best_memory, best_utilization = styles, memory, current
+    for key, value in best_memory.items():
+      used[key] += value
+    selections[name] = best_styles
+
+    bram_only = get_memory(name, ('BRAM',) * no_memcores)
+    uram_only = get_memory(name, ('URAM',) * no_memcores)
+    no_urams = best_styles.count('URAM')
+    count = instance_counts.get(name, 1)
+    _logger.info(
+        '  buffer %s (%d x %d-bit x %d banks, %d instances): %d URAM + %d '
+        'BRAM banks, using %d BRAM_18K + %d URAM (BRAM only: %d BRAM_18K, '
+        'URAM only: %d URAM)', name, depth, width, no_memcores, count,
+        no_urams, no_memcores - no_urams, best_memory['BRAM_18K'],
+        best_memory['URAM'], bram_only['BRAM_18K'], uram_only['URAM'])
+    report.append({
+        'buffer': name,
+        'width': width,
+        'depth': depth,
+        'instances': count,
+        'banks': list(best_styles),
+        'memory': best_memory,
+        'bram_only': bram_only,
+        'uram_only': uram_only,
+    })
+
+  if auto_buffers:
+    _logger.info(
+        '  compared with BRAM only, saved %d BRAM_18K for %d URAM',
+        sum(x['bram_only']['BRAM_18K'] - x['memory']['BRAM_18K']
+            for x in report), sum(x['memory']['URAM'] for x in report))
+    _logger.info(
+        '  on-chip memory after buffers: %d / %d BRAM_18K, %d / %d URAM',
+        used['BRAM_18K'], device_memory['BRAM_18K'], used['URAM'],
+        device_memory['URAM'])
+  if report_file:
+    with open(report_file, 'w') as fp:
+      json.dump(
+          {
+              'device': device_memory,
+              'used': used,
+              'buffers': report
+          },
+          fp,
+          indent=2)
+  return selections
@@ -25,6 +25,7 @@ from tapa.codegen.axi_pipeline import get_axi_pipeline_wrapper
 from tapa.codegen.buffer import BufferConfig
 from tapa.codegen.buffergen import generate_buffer_from_config, index_generator
 from tapa.codegen.duplicate_s_axi_control import duplicate_s_axi_ctrl
+from tapa.codegen.memcore import select_memcores
 from tapa.floorplan import (
     checkpoint_floorplan,
     generate_floorplan,
@@ -34,6 +35,7 @@ from tapa.floorplan import (
 )
 from tapa.hardware import (
     DEFAULT_REGISTER_LEVEL,
+    get_device_memory,
     get_slr_count,
     is_part_num_supported,
 )
@@ -322,6 +324,7 @@ class Program:
         'memcore_uram.v',
         'generate_last.v',
         'priority_encoder.v',
+        'read_gather.v',
         'relay_station.v',
         'a_axi_write_broadcastor_1_to_3.v',
         'a_axi_write_broadcastor_1_to_4.v',
@@ -331,6 +334,8 @@ class Program:
           os.path.join(os.path.dirname(util.__file__), 'assets', 'verilog',
                        file_name), self.rtl_dir)
 
+    self._select_buffer_memcores(part_num)
+
     # generate all buffer modules that we need
     for buffer_name, buffer_hash in self.buffer_configs_names_to_hashes.items():
       buffer_config = self.buffer_configs_hashes[buffer_hash]
@@ -415,6 +420,64 @@ class Program:
 
     return self
 
+  def _select_buffer_memcores(self, part_num: str) -> None:
+    """Select BRAM or URAM for each memcore of `AUTO` buffers."""
+    buffer_configs = {
+        name: self.buffer_configs_hashes[buffer_hash]
+        for name, buffer_hash in self.buffer_configs_names_to_hashes.items()
+    }
+    if all(x.memcore_type != 'AUTO' for x in buffer_configs.values()):
+      return
+    _logger.info('selecting memcores of buffers')
+    try:
+      device_memory = get_device_memory(part_num)
+    except NotImplementedError:
+      _logger.warning('  unknown on-chip memory of %s, assuming xcu250-',
+                      part_num)
+      device_memory = get_device_memory('xcu250-')
+
+    # count the instances of each task to find the memory taken by tasks
+    instance_counts = collections.Counter({self.top: 1})
+    for name in reversed(
+        toposort.toposort_flatten({
+            name: set(task.tasks) for name, task in self._tasks.items()
+        })):
+      task = self._tasks.get(name)
+      if task is None:
+        continue
+      for child, instances in task.tasks.items():
+        instance_counts[child] += instance_counts[name] * len(instances)
+    used_memory = {'BRAM_18K': 0, 'URAM': 0}
+    for name, task in self._tasks.items():
+      area = self.get_area(name)
+      for key in used_memory:
+        used_memory[key] += area.get(key, 0) * instance_counts[name]
+
+    # count the buffers of each config, instantiated by every instance of
+    # their upper-level task
+    buffer_counts = collections.Counter()
+    for name, task in self._tasks.items():
+      for buffer_name, buffer in task.buffers.items():
+        if 'is_instantiated' in buffer:
+          buffer_hash = hash(task.buffer_configs[buffer_name])
+          buffer_counts[self.buffer_configs_hashes_to_names[buffer_hash]] += (
+              instance_counts[name])
+
+    selections = select_memcores(
+        buffer_configs, device_memory, used_memory,
+        os.path.join(self.work_dir, 'memcore_report.json'), buffer_counts)
+    hashes_to_banks = {
+        self.buffer_configs_names_to_hashes[name]: banks
+        for name, banks in selections.items()
+    }
+    # every task keeps its own copy of the buffer config
+    for task in self._tasks.values():
+      for buffer_config in task.buffer_configs.values():
+        buffer_config.memcore_banks = hashes_to_banks.get(
+            hash(buffer_config), ())
+    for buffer_hash, banks in hashes_to_banks.items():
+      self.buffer_configs_hashes[buffer_hash].memcore_banks = banks
+
   def generate_post_synth_task_area(
       self,
       part_num: str,
@@ -971,6 +1034,8 @@ class Program:
             tags=async_mmap_args[arg],
             data_width=width_table[arg.name],
             addr_width=addr_width,
+            max_read_gap=arg.max_read_gap,
+            read_cache_depth=arg.read_cache_depth,
         )
 
     return is_done_signals
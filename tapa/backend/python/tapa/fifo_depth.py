@@ -0,0 +1,221 @@
+"""Inference of the depth of FIFOs declared with `tapa::auto_depth`.
+
+Where the task graph splits into paths that join again, e.g., a task feeding
+another task both directly and through a task that buffers its input, the
+tokens of the faster path wait in its FIFO until the tokens of the slower path
+arrive. If the FIFO cannot hold them, the split stalls, which slows down both
+paths or deadlocks them.
+
+The latency of each path is estimated from the `start` cycles that tapacc
+reports for the stream ports of lower-level tasks, i.e., from the trip counts
+and IIs of the loops that run before a port is accessed, plus the pipeline
+depth of the producing loop and the latency of the FIFO. A FIFO on one of
+several paths joining at the same instance needs room for the tokens that
+arrive before that instance starts reading them, at the sustained rate
+estimated by `tapa.throughput`. FIFOs in cycles of the task graph are left
+alone, as their depths bound the tokens in flight around the cycle rather than
+a difference of latencies.
+"""
+
+import collections
+import json
+import logging
+import math
+from typing import Dict, List, Set, Tuple
+
+import toposort
+
+from tapa import throughput
+
+_logger = logging.getLogger().getChild(__name__)
+
+# depth of FIFOs that are not on reconvergent paths, as `kStreamDefaultDepth`
+DEFAULT_DEPTH = 2
+
+# estimated cycles from a token entering a FIFO until it can be read
+FIFO_LATENCY = 2
+
+# estimated cycles from a loop reading its inputs until it writes its outputs
+PIPELINE_DEPTH = 8
+
+# tokens per cycle assumed for FIFOs of unknown rates
+DEFAULT_RATE = 1.
+
+Edge = Tuple[str, str, str]  # fifo, producer, consumer
+
+
+def _get_port_starts(task: Dict) -> Dict[str, float]:
+  ports = task.get('throughput', {}).get('ports', {})
+  return {port: info.get('start', 0.) for port, info in ports.items()}
+
+
+def _get_ancestors(instances: Dict[str, str],
+                   edges: List[Edge]) -> Dict[str, Set[str]]:
+  """Returns the instances from which each instance is reachable, including
+  itself.
+  """
+  producers = collections.defaultdict(set)
+  for _, producer, consumer in edges:
+    producers[consumer].add(producer)
+  ancestors = {}
+  for instance in instances:
+    visited = {instance}
+    stack = [instance]
+    while stack:
+      for producer in producers[stack.pop()]:
+        if producer not in visited:
+          visited.add(producer)
+          stack.append(producer)
+    ancestors[instance] = visited
+  return ancestors
+
+
+def _infer_upper_task(
+    name: str,
+    task: Dict,
+    port_starts: Dict[str, Dict[str, float]],
+    fifo_rates: Dict[str, Dict],
+) -> Dict:
+  """Infers the FIFO depths of an upper-level task.
+
+  Returns the report of the task and sets `port_starts` of the task itself.
+  """
+  instances, ports = throughput.get_instance_ports(task)
+
+  def get_start(instance: str, fifo: str) -> float:
+    port = ports[instance].get(fifo)
+    return port_starts.get(instances[instance], {}).get(port, 0.)
+
+  edges: List[Edge] = []
+  external = {}  # port of the upper-level task -> instance
+  for fifo, fifo_obj in task.get('fifos', {}).items():
+    if 'produced_by' in fifo_obj and 'consumed_by' in fifo_obj:
+      edges.append((fifo, throughput.get_end(fifo_obj['produced_by']),
+                    throughput.get_end(fifo_obj['consumed_by'])))
+    else:
+      end = fifo_obj.get('produced_by', fifo_obj.get('consumed_by'))
+      if end is not None:
+        external[fifo] = throughput.get_end(end)
+
+  # an edge is in a cycle if its consumer reaches its producer
+  ancestors = _get_ancestors(instances, edges)
+  cyclic = {fifo for fifo, producer, consumer in edges
+            if consumer in ancestors[producer]}
+  edges = [edge for edge in edges if edge[0] not in cyclic]
+  ancestors = _get_ancestors(instances, edges)
+
+  # the cycle at which each instance has received the first tokens of all its
+  # inputs, offset by the cycle at which it would read them without waiting
+  incoming: Dict[str, List[Edge]] = {x: [] for x in instances}
+  for edge in edges:
+    incoming[edge[2]].append(edge)
+  begin: Dict[str, float] = {}
+  arrival: Dict[str, float] = {}
+  for instance in toposort.toposort_flatten(
+      {x: {edge[1] for edge in incoming[x]} for x in instances}):
+    begin[instance] = 0.
+    for fifo, producer, _ in incoming[instance]:
+      arrival[fifo] = (begin[producer] + get_start(producer, fifo) +
+                       PIPELINE_DEPTH + FIFO_LATENCY)
+      begin[instance] = max(begin[instance],
+                            arrival[fifo] - get_start(instance, fifo))
+
+  report = {}
+  for fifo, producer, consumer in edges:
+    # paths reconverge if the producers share an ancestor
+    is_reconvergent = any(
+        ancestors[producer] & ancestors[other[1]]
+        for other in incoming[consumer]
+        if other[0] != fifo)
+    slack = begin[consumer] + get_start(consumer, fifo) - arrival[fifo]
+    rate = fifo_rates.get(fifo, {}).get('rate', 0.) or DEFAULT_RATE
+    required = DEFAULT_DEPTH
+    if is_reconvergent:
+      required += math.ceil(slack * rate - throughput.EPSILON)
+
+    fifo_obj = task['fifos'][fifo]
+    if 'depth' not in fifo_obj:
+      continue
+    is_auto = fifo_obj.get('auto_depth', False)
+    if is_auto:
+      fifo_obj['depth'] = required
+    elif fifo_obj['depth'] < required:
+      _logger.warning(
+          'FIFO %s.%s of depth %d may stall reconvergent paths; a depth of %d '
+          'is estimated to be needed, consider tapa::auto_depth', name, fifo,
+          fifo_obj['depth'], required)
+    report[fifo] = {
+        'producer': producer,
+        'consumer': consumer,
+        'reconvergent': is_reconvergent,
+        'slack': slack,
+        'rate': rate,
+        'required_depth': required,
+        'depth': fifo_obj['depth'],
+        'auto_depth': is_auto,
+    }
+
+  for fifo in cyclic:
+    fifo_obj = task['fifos'][fifo]
+    if fifo_obj.get('auto_depth', False):
+      _logger.warning(
+          'FIFO %s.%s is in a cycle of the task graph; using depth %d', name,
+          fifo, fifo_obj['depth'])
+
+  # the ports of this task are accessed when the instances connected to them
+  # access them
+  port_starts[name] = {
+      port: begin[instance] + get_start(instance, port)
+      for port, instance in external.items()
+  }
+  return report
+
+
+def _log_report(name: str, report: Dict) -> None:
+  fifos = {k: v for k, v in report.items() if v['auto_depth']}
+  if not fifos:
+    return
+  _logger.info('inferred FIFO depths of task %s:', name)
+  _logger.info('  %-32s %12s %12s %6s', 'fifo', 'slack', 'tokens/cycle',
+               'depth')
+  for fifo, info in fifos.items():
+    _logger.info('  %-32s %12.1f %12.3f %6d', fifo, info['slack'],
+                 info['rate'], info['depth'])
+
+
+def infer_fifo_depths(
+    program: Dict,
+    throughput_reports: Dict,
+    report_file: str = '',
+) -> Dict:
+  """Sets the depth of every FIFO declared with `tapa::auto_depth`.
+
+  Args:
+    program: The program as generated by tapacc, modified in place.
+    throughput_reports: The reports of `tapa.throughput.analyze_throughput`.
+    report_file: If not empty, the report is also written to this JSON file.
+
+  Returns:
+    A dict mapping upper-level task names to the FIFOs between their
+    instances: whether the FIFO is on a reconvergent path, the estimated
+    `slack` in cycles that its tokens wait for, its `rate` in tokens per
+    cycle, the `required_depth`, and the resulting `depth`.
+  """
+  tasks = program['tasks']
+  port_starts: Dict[str, Dict[str, float]] = {}
+  reports = {}
+  # children go first
+  for name in toposort.toposort_flatten(
+      {k: set(v.get('tasks', ())) for k, v in tasks.items()}):
+    task = tasks[name]
+    if task.get('level') != 'upper':
+      port_starts[name] = _get_port_starts(task)
+    elif task.get('tasks'):
+      fifo_rates = throughput_reports.get(name, {}).get('fifos', {})
+      reports[name] = _infer_upper_task(name, task, port_starts, fifo_rates)
+      _log_report(name, reports[name])
+
+  if report_file:
+    with open(report_file, 'w') as fp:
+      json.dump(reports, fp, indent=2)
+  return reports
@@ -0,0 +1,335 @@
+"""Fusion of linear chains of lightweight lower-level tasks.
+
+Each instance of a lower-level task costs a FIFO per stream, the handshake of
+the instance, and a vertex to floorplan. Where instances form a chain, each
+writing exactly one stream that the next instance of the chain reads as its
+only input, the chain is replaced by one instance of a fused task whose
+dataflow region runs the instances of the chain. The streams inside the chain
+become HLS channels of the same depth, `tapa::internal::fused_stream`.
+
+An instance is fused only if it has no mmaps or buffers and a single loop that
+streams its ports, the instances of a chain share the same instantiation
+mode, and each stream inside the chain is produced and consumed at the same
+rate with the same II, as estimated by tapacc.
+
+The fused task is defined from the code of the first instance of the chain,
+followed by a copy of each task of the chain, whose streams inside the chain
+are replaced by `fused_stream`s, and the dataflow region that calls them. HLS
+channels cannot be peeked, so each consumer reads its `fused_stream` via a
+`fused_istream`, declared at the start of its body under the name of the
+replaced stream, which buffers the token that `eot` or `peek` reads.
+"""
+
+import json
+import logging
+import re
+from typing import Dict, List, Optional, Tuple
+
+from tapa import hardware, throughput, util
+
+_logger = logging.getLogger().getChild(__name__)
+
+Instance = Tuple[str, int]  # task name, instance index
+
+
+def _get_base(port: str) -> str:
+  """Returns the name of the parameter of a port, e.g., `out` for `out[0]`."""
+  return port.split('[', 1)[0]
+
+
+def _get_port(instance: Dict, fifo: str) -> Optional[str]:
+  return next((k for k, v in instance['args'].items() if v['arg'] == fifo),
+              None)
+
+
+def _get_channel(fifo: str) -> str:
+  """Returns the variable of a fused FIFO, e.g., `qs_1_fifo` for `qs[1]`."""
+  return re.sub(r'\W', '_', fifo) + '_fifo'
+
+
+def _count_args(instance: Dict, cat: str) -> int:
+  return sum(arg['cat'] == cat for arg in instance['args'].values())
+
+
+def _is_fusible(task: Dict, instance: Dict) -> bool:
+  if task.get('level') != 'lower' or 'body' not in task:
+    return False
+  if any(arg['cat'] not in {'istream', 'ostream', 'scalar'}
+         for arg in instance['args'].values()):
+    return False
+  return len(task.get('throughput', {}).get('loops', ())) == 1
+
+
+def _get_fusible_edges(
+    tasks: Dict,
+    upper: Dict,
+) -> Dict[Instance, Tuple[str, Instance]]:
+  """Returns the fusible FIFO and its consumer of each producer instance."""
+  edges = {}
+  for fifo, fifo_obj in upper.get('fifos', {}).items():
+    if 'produced_by' not in fifo_obj or 'consumed_by' not in fifo_obj:
+      continue
+    producer = tuple(fifo_obj['produced_by'])
+    consumer = tuple(fifo_obj['consumed_by'])
+    if producer == consumer:
+      continue
+    producer_task, consumer_task = tasks[producer[0]], tasks[consumer[0]]
+    producer_obj = upper['tasks'][producer[0]][producer[1]]
+    consumer_obj = upper['tasks'][consumer[0]][consumer[1]]
+    if not (_is_fusible(producer_task, producer_obj) and
+            _is_fusible(consumer_task, consumer_obj)):
+      continue
+    if producer_obj['step'] != consumer_obj['step']:
+      continue
+
+    # the chain must be linear
+    if (_count_args(producer_obj, 'ostream') != 1 or
+        _count_args(consumer_obj, 'istream') != 1):
+      continue
+    out_port = _get_port(producer_obj, fifo)
+    in_port = _get_port(consumer_obj, fifo)
+    if '[' in out_port or '[' in in_port:
+      continue
+
+    # loops must run in lockstep
+    producer_loop = producer_task['throughput']['loops'][0]
+    consumer_loop = consumer_task['throughput']['loops'][0]
+    if producer_loop['ii'] != consumer_loop['ii']:
+      continue
+    out_rate = producer_task['throughput']['ports'].get(out_port, {})
+    in_rate = consumer_task['throughput']['ports'].get(in_port, {})
+    if abs(out_rate.get('rate', 0.) -
+           in_rate.get('rate', 0.)) > throughput.EPSILON:
+      continue
+
+    edges[producer] = (fifo, consumer)
+  return edges
+
+
+def _get_chains(
+    edges: Dict[Instance, Tuple[str, Instance]]) -> List[List[Instance]]:
+  consumers = {consumer for _, consumer in edges.values()}
+  chains = []
+  # chains start from instances that no other instance of a chain feeds;
+  # closed loops of instances are left alone
+  for head in edges:
+    if head in consumers:
+      continue
+    chain = [head]
+    while chain[-1] in edges:
+      chain.append(edges[chain[-1]][1])
+    chains.append(chain)
+  return chains
+
+
+def _generate_code(
+    name: str,
+    tasks: Dict,
+    upper: Dict,
+    chain: List[Instance],
+    fifos: List[str],
+) -> Tuple[str, Dict[str, Tuple[int, str]]]:
+  """Returns the code of a fused task and its ports, each mapped to the port
+  of an instance in the chain.
+  """
+  wrapper_params = []
+  pragmas = []
+  channels = []
+  calls = []
+  definitions = []
+  ports = {}  # port of the fused task -> (index in chain, port)
+  for j, (task_name, idx) in enumerate(chain):
+    task = tasks[task_name]
+    instance = upper['tasks'][task_name][idx]
+    fused_ports = {}  # param -> fifo
+    if j > 0:
+      fused_ports[_get_port(instance, fifos[j - 1])] = fifos[j - 1]
+    if j < len(fifos):
+      fused_ports[_get_port(instance, fifos[j])] = fifos[j]
+
+    params = []
+    call_args = []
+    body = task['body']
+    for param in task['params']:
+      param_name = param['name']
+      fifo = fused_ports.get(param_name)
+      if fifo is not None:
+        channel_type = (f"tapa::internal::fused_stream<{param['elem_type']}, "
+                        f"{upper['fifos'][fifo]['depth']}>")
+        if j > 0 and fifo == fifos[j - 1]:
+          # the reader takes the name of the stream it replaces
+          reader_type = channel_type.replace('fused_stream', 'fused_istream')
+          channel = _get_channel(fifo)
+          params.append(f'{channel_type}& {channel}')
+          body = body.replace(
+              '\n' + util.get_stream_pragmas(param_name, True), '', 1)
+          assert body.startswith('{')
+          body = (f'{{\n  {reader_type} {param_name}({channel});' + body[1:])
+        else:
+          params.append(f'{channel_type}& {param_name}')
+          body = body.replace(
+              '\n' + util.get_stream_pragmas(param_name, False), '', 1)
+        call_args.append(_get_channel(fifo))
+        continue
+      params.append(f"{param['type']} {param_name}")
+      # parameter names end with the index, unlike the names of channels
+      wrapper_param = f'{param_name}_{j}'
+      wrapper_params.append(f"{param['type']} {wrapper_param}")
+      call_args.append(wrapper_param)
+      args = {
+          k: v
+          for k, v in instance['args'].items()
+          if _get_base(k) == param_name
+      }
+      for port in args:
+        ports[wrapper_param + port[len(param_name):]] = (j, port)
+      cats = {arg['cat'] for arg in args.values()}
+      if cats & {'istream', 'ostream'}:
+        length = sum('[' in port for port in args)
+        pragmas.append(
+            util.get_stream_pragmas(wrapper_param, 'istream' in cats, length))
+
+    definitions.append(f"void {name}_{j}({', '.join(params)}) {body}")
+    calls.append(f"  {name}_{j}({', '.join(call_args)});")
+
+  for j, fifo in enumerate(fifos):
+    producer_task = tasks[chain[j][0]]
+    producer = upper['tasks'][chain[j][0]][chain[j][1]]
+    out_port = _get_port(producer, fifo)
+    elem_type = next(param['elem_type']
+                     for param in producer_task['params']
+                     if param['name'] == out_port)
+    depth = upper['fifos'][fifo]['depth']
+    channels.append(f'  tapa::internal::fused_stream<{elem_type}, {depth}> '
+                    f'{_get_channel(fifo)};')
+
+  wrapper = '\n'.join([
+      f"void {name}({', '.join(wrapper_params)}) {{",
+      '\n\n'.join(pragmas),
+      '',
+      '#pragma HLS dataflow',
+      *channels,
+      *calls,
+      '}',
+  ])
+  code = '\n\n'.join(
+      [tasks[chain[0][0]]['code'], *definitions, wrapper]) + '\n'
+  return code, ports
+
+
+def _fuse_chain(
+    name: str,
+    tasks: Dict,
+    upper: Dict,
+    chain: List[Instance],
+    edges: Dict[Instance, Tuple[str, Instance]],
+) -> Dict:
+  """Adds the fused task of `chain` and returns its report."""
+  fifos = [edges[instance][0] for instance in chain[:-1]]
+  code, ports = _generate_code(name, tasks, upper, chain, fifos)
+
+  args = {}
+  port_throughput = {}
+  for port, (j, member_port) in ports.items():
+    task_name, idx = chain[j]
+    args[port] = dict(upper['tasks'][task_name][idx]['args'][member_port])
+    info = tasks[task_name]['throughput']['ports'].get(member_port)
+    if info is not None:
+      port_throughput[port] = info
+  first = tasks[chain[0][0]]
+  tasks[name] = {
+      'code': code,
+      'level': 'lower',
+      'target': first.get('target'),
+      'vendor': first.get('vendor'),
+      'throughput': {
+          'loops': [],
+          'ports': port_throughput
+      },
+  }
+  upper['tasks'][name] = [{
+      'step': upper['tasks'][chain[0][0]][chain[0][1]]['step'],
+      'args': args,
+  }]
+
+  area = dict(hardware.get_zero_area())
+  for key, value in hardware.AREA_PER_TASK_INSTANCE.items():
+    area[key] += value * (len(chain) - 1)
+  fifo_report = {}
+  for j, fifo in enumerate(fifos):
+    producer = upper['tasks'][chain[j][0]][chain[j][1]]
+    out_port = _get_port(producer, fifo)
+    width = next(param['width']
+                 for param in tasks[chain[j][0]]['params']
+                 if param['name'] == out_port) + 1  # end-of-transaction bit
+    depth = upper['fifos'][fifo]['depth']
+    fifo_report[fifo] = {'width': width, 'depth': depth}
+    for key, value in hardware.get_fifo_area(width, depth).items():
+      area[key] += value
+
+  return {
+      'instances': [util.get_instance_name(x) for x in chain],
+      'fifos': fifo_report,
+      'area': area,
+  }
+
+
+def _log_report(name: str, report: Dict) -> None:
+  _logger.info('fused tasks of task %s:', name)
+  _logger.info('  %-32s %6s %6s %6s  %s', 'task', 'fifos', 'LUT', 'FF',
+               'instances')
+  for fused, info in report.items():
+    _logger.info('  %-32s %6d %6d %6d  %s', fused, len(info['fifos']),
+                 info['area']['LUT'], info['area']['FF'],
+                 ', '.join(info['instances']))
+
+
+def fuse_tasks(program: Dict, report_file: str = '') -> Dict:
+  """Fuses linear chains of lower-level task instances in place.
+
+  Args:
+    program: The program as generated by tapacc, modified in place.
+    report_file: If not empty, the report is also written to this JSON file.
+
+  Returns:
+    A dict mapping upper-level task names to their fused tasks: the fused
+    `instances`, the `fifos` removed with their `width` and `depth`, and the
+    estimated `area` of those FIFOs and of the handshakes of the instances
+    removed from the RTL of the upper-level task.
+  """
+  tasks = program['tasks']
+  reports = {}
+  fused_tasks = set()
+  for name, upper in list(tasks.items()):
+    if upper.get('level') != 'upper' or not upper.get('tasks'):
+      continue
+    edges = _get_fusible_edges(tasks, upper)
+    chains = _get_chains(edges)
+    if not chains:
+      continue
+
+    report = {}
+    fused: Dict[Instance, str] = {}
+    fused_fifos = []
+    for i, chain in enumerate(chains):
+      fused_name = f'{name}_fused_{i}'
+      report[fused_name] = _fuse_chain(fused_name, tasks, upper, chain, edges)
+      fused_fifos.extend(report[fused_name]['fifos'])
+      for instance in chain:
+        fused[instance] = fused_name
+        fused_tasks.add(instance[0])
+    util.move_instances(upper, fused, fused_fifos)
+    reports[name] = report
+    _log_report(name, report)
+
+  # tasks of which all instances are fused are no longer synthesized
+  instantiated = {program['top']}
+  for task in tasks.values():
+    instantiated.update(task.get('tasks', ()))
+  for task_name in fused_tasks - instantiated:
+    del tasks[task_name]
+
+  if report_file:
+    with open(report_file, 'w') as fp:
+      json.dump(reports, fp, indent=2)
+  return reports
@@ -1,3 +1,5 @@
+from typing import Dict
+
 AREA_OF_ASYNC_MMAP = {
     32: {
         'BRAM': 0,
@@ -60,6 +62,16 @@ ZERO_AREA = {
     'DSP': 0,
 }
 
+# estimated area of the start/done handshake of a task instance in the RTL of
+# an upper-level task
+AREA_PER_TASK_INSTANCE = {
+    'LUT': 12,
+    'FF': 4,
+    'BRAM': 0,
+    'URAM': 0,
+    'DSP': 0,
+}
+
 # default pipeline level for control signals
 DEFAULT_REGISTER_LEVEL = 3
 
@@ -88,6 +100,27 @@ def _next_power_of_2(x):
   return 1 if x == 0 else 2**(x - 1).bit_length()
 
 
+def get_fifo_area(width: int, depth: int) -> Dict[str, int]:
+  """ estimated area of a FIFO as instantiated by `fifo.v` """
+  addr_width = max(depth - 1, 1).bit_length()
+  area = dict(ZERO_AREA)
+  if depth <= 1:
+    area['LUT'] = width + 4
+    area['FF'] = width + 2
+  elif depth < 128:
+    # one SRL32 per bit per 32 entries, at least 4 entries
+    area['LUT'] = width * ((max(depth, 4) + 31) // 32) + 2 * addr_width + 4
+    area['FF'] = addr_width + 3
+  else:
+    if width >= 36 and depth >= 4096:
+      area['URAM'] = ((width + 71) // 72) * ((depth + 4095) // 4096)
+    else:
+      area['BRAM'] = ((width + 35) // 36) * ((depth + 511) // 512)
+    area['LUT'] = 4 * addr_width + 8
+    area['FF'] = width + 2 * addr_width + 4
+  return area
+
+
 def get_ctrl_instance_region(part_num: str) -> str:
   if part_num.startswith('xcu250-') or part_num.startswith('xcu280-'):
     return 'COARSE_X1Y0'
@@ -148,3 +181,36 @@ def get_slr_count(part_num: str):
 def is_part_num_supported(part_num: str):
   return any(
       part_num.startswith(prefix) for prefix in SUPPORTED_PART_NUM_PREFIXS)
+
+
+# on-chip memory of the whole device, in BRAM_18K and URAM blocks
+MEMORY_OF_DEVICE = {
+    'xcu250-': {
+        'BRAM_18K': 5376,
+        'URAM': 1280,
+    },
+    'xcu200-': {
+        'BRAM_18K': 4320,
+        'URAM': 960,
+    },
+    'xcu50-': {
+        'BRAM_18K': 2688,
+        'URAM': 640,
+    },
+}
+
+
+def get_device_memory(part_num: str) -> Dict[str, int]:
+  """ BRAM_18K and URAM blocks available to the user logic """
+  if part_num.startswith('xcu280-'):
+    # the U280 slots exclude the resources taken by the shell
+    from autobridge.Floorplan.u280_resource import resources
+    slots = [slot for column in resources.values() for slot in column.values()]
+    return {
+        'BRAM_18K': sum(slot['BRAM'] for slot in slots),
+        'URAM': sum(slot['URAM'] for slot in slots),
+    }
+  for prefix, memory in MEMORY_OF_DEVICE.items():
+    if part_num.startswith(prefix):
+      return memory
+  raise NotImplementedError(f'unknown part_num {part_num}')
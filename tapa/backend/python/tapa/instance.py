@@ -1,5 +1,5 @@
 import enum
-from typing import TYPE_CHECKING, Iterator, Tuple, Union
+from typing import TYPE_CHECKING, Dict, Iterator, Optional, Tuple, Union
 
 from tapa import util
 from tapa.verilog import ast
@@ -87,7 +87,8 @@ class Instance:
                  instance: 'Instance',
                  cat: Union[str, Cat],
                  port: str,
-                 is_upper=False):
+                 is_upper=False,
+                 access_pattern: Optional[Dict[str, int]] = None):
       self.name = rtl.sanitize_array_name(name)
       self.unsanitize_name = name
       self.instance = instance
@@ -109,6 +110,10 @@ class Instance:
       self.port = port
       self.width = None
       self.shared = False  # only set for (async) mmaps
+      # only set for async_mmaps; see tapa::access_pattern
+      access_pattern = access_pattern or {}
+      self.max_read_gap: int = access_pattern.get('max_gap', 0)
+      self.read_cache_depth: int = access_pattern.get('cache_depth', 0)
 
     def __lt__(self, other):
       if isinstance(other, Instance.Arg):
@@ -134,6 +139,7 @@ class Instance:
                 cat=arg['cat'],
                 port=port,
                 is_upper=task.is_upper,
+                access_pattern=arg.get('access_pattern'),
             ) for port, arg in kwargs.pop('args').items()))
 
   @property
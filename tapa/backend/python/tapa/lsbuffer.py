@@ -0,0 +1,101 @@
+"""Report of the ping-pong buffers that can be LS buffers.
+
+A buffer with one section, an LS buffer, serves its producer and its consumer
+in turns and takes half the memory of a ping-pong buffer. For each buffer of
+an upper-level task, tapacc estimates how long its producer and its consumer
+hold a section (`hold`) and take per section (`interval`), and marks the
+buffer `eligible` if both holds fit in the interval of the slower of them,
+i.e., if a single section does not slow down the pipeline. With
+`--convert-ls-buffers`, tapacc converts the eligible buffers of a layout to
+LS buffers (`ls_converted`) if no array of buffers or watermark uses it.
+
+`same_order` tells if the producer and the consumer access the section in
+the same order, in which case a stream may serve as the buffer.
+"""
+
+import json
+import logging
+from typing import Dict, List
+
+from tapa.codegen.buffer import BufferConfig
+from tapa.codegen.memcore import get_buffer_memory
+
+_logger = logging.getLogger().getChild(__name__)
+
+
+def _get_memory(buffer: Dict, n_sections: int) -> Dict[str, int]:
+  config = BufferConfig({**buffer, 'n_sections': n_sections})
+  # `AUTO` memcores are selected later; assume BRAM
+  style = 'URAM' if config.memcore_type == 'URAM' else 'BRAM'
+  return get_buffer_memory(config, (style,) * config.get_no_memcores())
+
+
+def report_ls_buffers(program: Dict, report_file: str = '') -> List[Dict]:
+  """Reports the buffers that can be or are converted to LS buffers.
+
+  Args:
+    program: The program as generated by tapacc.
+    report_file: If not empty, the report is also written to this JSON file.
+
+  Returns:
+    A list of the analyzed buffers, with the `task` and `buffer` names, the
+    `producer` and `consumer` tiles, `same_order`, `eligible`, `converted`,
+    and the `memory` of the buffer with its sections as declared
+    (`ping_pong`) and with one section (`ls`).
+  """
+  reports = []
+  for task_name, task in program['tasks'].items():
+    for name, buffer in task.get('buffers', {}).items():
+      info = buffer.get('ls_buffer')
+      if info is None:
+        continue
+      converted = buffer.get('ls_converted', False)
+      # converted buffers are declared with two sections
+      n_sections = 2 if converted else buffer['n_sections']
+      eligible = info['eligible'] and not buffer.get('watermark', False) and (
+          n_sections == 2)
+      reports.append({
+          'task': task_name,
+          'buffer': name,
+          'producer': info['producer'],
+          'consumer': info['consumer'],
+          'same_order': info['same_order'],
+          'eligible': eligible,
+          'converted': converted,
+          'memory': {
+              'ping_pong': _get_memory(buffer, n_sections),
+              'ls': _get_memory(buffer, 1),
+          },
+      })
+
+  if reports:
+    _logger.info('LS buffers:')
+    _logger.info('  %-32s %8s %8s %8s %9s  %s', 'buffer', 'p.hold', 'c.hold',
+                 'interval', 'saved', 'status')
+    for report in reports:
+      interval = max(report['producer']['interval'],
+                     report['consumer']['interval'])
+      # memory saved, or that would be saved, by the conversion
+      is_saved = report['converted'] or report['eligible']
+      saved = {
+          key: report['memory']['ping_pong'][key] -
+          report['memory']['ls'][key] if is_saved else 0
+          for key in ('BRAM_18K', 'URAM')
+      }
+      if report['converted']:
+        status = 'converted'
+      elif report['eligible']:
+        status = 'eligible'
+      else:
+        status = 'kept'
+      if report['same_order']:
+        status += ', same order'
+      _logger.info('  %-32s %8g %8g %8g %4d/%-4d  %s',
+                   f'{report["task"]}.{report["buffer"]}',
+                   report['producer']['hold'], report['consumer']['hold'],
+                   interval, saved['BRAM_18K'], saved['URAM'], status)
+
+  if report_file:
+    with open(report_file, 'w') as fp:
+      json.dump(reports, fp, indent=2)
+  return reports
@@ -0,0 +1,300 @@
+"""Packing of sibling streams that tasks access in lockstep.
+
+Streams of the same element type from one lower-level task instance to
+another are packed into one stream of `tapa::internal::packed_t` if both
+instances access them in lockstep, i.e., as estimated by tapacc, each stream
+takes one blocking access whenever the same guards hold in an iteration of
+the same loops, is opened or closed at the same points outside of the loops,
+and is never accessed otherwise. One FIFO and its handshake then serve all the
+streams.
+
+Each instance with packed streams is replaced by an instance of a new task,
+defined from the code of its task with each packed stream replaced by a lane
+of the packed stream, `tapa::internal::(i|o)stream_lane`, declared at the
+start of the body. The lane that the producer writes last in an iteration
+writes the packed token, and the lane that the consumer reads first reads it.
+Likewise, the last lane closes the packed stream and the first lane opens it,
+and every lane answers `eot` from the packed stream. Streams that are peeked,
+including via `eot` after a token of the iteration is transferred, or that are
+elements of arrays are not packed.
+"""
+
+import json
+import logging
+import re
+from typing import Dict, List, Optional, Tuple
+
+from tapa import hardware, util
+
+_logger = logging.getLogger().getChild(__name__)
+
+Instance = Tuple[str, int]  # task name, instance index
+
+
+def _get_port(instance: Dict, fifo: str) -> Optional[str]:
+  return next((k for k, v in instance['args'].items() if v['arg'] == fifo),
+              None)
+
+
+def _get_param(task: Dict, port: str) -> Optional[Dict]:
+  return next((x for x in task.get('params', ()) if x['name'] == port), None)
+
+
+def _get_lockstep_key(task: Dict, port: str) -> Optional[Tuple]:
+  """Returns the tokens per iteration and the guards of each loop of the task
+  through `port` and the loops before which it is opened or closed, if the
+  tokens are 0 or 1 and the port is accessed regularly.
+  """
+  info = task.get('throughput', {})
+  if port in info.get('peeked', ()) or port in info.get('irregular', ()):
+    return None
+  loops = info.get('loops', ())
+  tokens = tuple(loop['tokens'].get(port, 0) for loop in loops)
+  if not any(tokens) or any(x not in (0, 1) for x in tokens):
+    return None
+  guards = tuple(loop.get('guards', {}).get(port) for loop in loops)
+  return tokens, guards, tuple(info.get('framing', {}).get(port, ()))
+
+
+def _get_access_order(task: Dict, ports: List[str]) -> Optional[List[str]]:
+  """Returns `ports` in the order the task accesses them in each iteration,
+  or None if the order differs between loops.
+  """
+  orders = {
+      tuple(sorted(ports, key=loop['order'].index))
+      for loop in task['throughput']['loops']
+      if ports[0] in loop['order']
+  }
+  if len(orders) != 1:
+    return None
+  return list(orders.pop())
+
+
+def _get_groups(tasks: Dict, upper: Dict) -> List[Dict]:
+  """Returns the groups of FIFOs to pack, each with the `producer` and
+  `consumer` instances, the element `type`, and the `fifos` in the order of
+  their lanes, each mapped to the ports of the producer and the consumer.
+  """
+  candidates: Dict[Tuple, List[Tuple[str, str, str]]] = {}
+  for fifo, fifo_obj in upper.get('fifos', {}).items():
+    if 'produced_by' not in fifo_obj or 'consumed_by' not in fifo_obj:
+      continue
+    producer = tuple(fifo_obj['produced_by'])
+    consumer = tuple(fifo_obj['consumed_by'])
+    if producer == consumer:
+      continue
+    producer_task, consumer_task = tasks[producer[0]], tasks[consumer[0]]
+    if 'body' not in producer_task or 'body' not in consumer_task:
+      continue
+    out_port = _get_port(upper['tasks'][producer[0]][producer[1]], fifo)
+    in_port = _get_port(upper['tasks'][consumer[0]][consumer[1]], fifo)
+    if '[' in out_port or '[' in in_port:
+      continue
+    out_param = _get_param(producer_task, out_port)
+    in_param = _get_param(consumer_task, in_port)
+    if out_param is None or in_param is None:
+      continue
+    out_key = _get_lockstep_key(producer_task, out_port)
+    in_key = _get_lockstep_key(consumer_task, in_port)
+    if out_key is None or in_key is None:
+      continue
+    key = (producer, consumer, out_param['elem_type'], out_key, in_key)
+    candidates.setdefault(key, []).append((fifo, out_port, in_port))
+
+  groups = []
+  for (producer, consumer, elem_type, _, _), fifos in candidates.items():
+    if len(fifos) < 2:
+      continue
+    out_ports = [out_port for _, out_port, _ in fifos]
+    in_ports = [in_port for _, _, in_port in fifos]
+    out_order = _get_access_order(tasks[producer[0]], out_ports)
+    in_order = _get_access_order(tasks[consumer[0]], in_ports)
+    if out_order is None or in_order is None:
+      continue
+    groups.append({
+        'producer': producer,
+        'consumer': consumer,
+        'type': elem_type,
+        'fifos': {fifo: ports for fifo, *ports in fifos},
+        'last_out_port': out_order[-1],
+        'first_in_port': in_order[0],
+    })
+  return groups
+
+
+def _get_packed_name(names: List[str]) -> str:
+  return re.sub(r'\W', '_', '_'.join(names))
+
+
+def _pack_instance(
+    name: str,
+    tasks: Dict,
+    upper: Dict,
+    instance: Instance,
+    groups: List[Dict],
+) -> None:
+  """Adds task `name` to replace `instance` with its streams in `groups`
+  packed, and updates the args of the instance to be moved to it.
+  """
+  task = tasks[instance[0]]
+  instance_obj = upper['tasks'][instance[0]][instance[1]]
+  body = task['body']
+  lanes = {}  # port -> (group, lane index, is producer)
+  for group in groups:
+    is_producer = group['producer'] == instance
+    for idx, ports in enumerate(group['fifos'].values()):
+      lanes[ports[not is_producer]] = group, idx, is_producer
+
+  params = []
+  decls = []
+  packed_ports = set()
+  args = dict(instance_obj['args'])
+  for param in task['params']:
+    port = param['name']
+    if port not in lanes:
+      params.append(f"{param['type']} {port}")
+      continue
+    group, idx, is_producer = lanes[port]
+    body = body.replace('\n' + util.get_stream_pragmas(port, not is_producer),
+                        '', 1)
+    del args[port]
+    ports = [x[not is_producer] for x in group['fifos'].values()]
+    packed = _get_packed_name(ports)
+    packed_type = f"tapa::internal::packed_t<{group['type']}, {len(ports)}>"
+    if packed not in packed_ports:
+      packed_ports.add(packed)
+      cat = 'ostream' if is_producer else 'istream'
+      params.append(f'tapa::{cat}<{packed_type}>& {packed}')
+      decls.append(util.get_stream_pragmas(packed, not is_producer))
+      decls.append(f'{packed_type} {packed}_lanes;')
+      args[packed] = {'cat': cat, 'arg': group['packed_fifo']}
+    if is_producer:
+      lane_type = 'ostream_lane'
+      is_end = port == group['last_out_port']
+    else:
+      lane_type = 'istream_lane'
+      is_end = port == group['first_in_port']
+    decls.append(f"tapa::internal::{lane_type}<{group['type']}, {len(ports)}, "
+                 f"{idx}, {str(is_end).lower()}> {port}({packed}, "
+                 f'{packed}_lanes);')
+
+  assert body.startswith('{')
+  code = '\n'.join([
+      task['code'],
+      '',
+      f"void {name}({', '.join(params)}) {{",
+      *decls,
+      body[1:],
+  ])
+  tasks[name] = {
+      'code': code + '\n',
+      'level': 'lower',
+      'target': task.get('target'),
+      'vendor': task.get('vendor'),
+      'throughput': {
+          'loops': [],
+          'ports': {},
+      },
+  }
+  upper['tasks'][name] = [{'step': instance_obj['step'], 'args': args}]
+
+
+def _get_fifo_report(tasks: Dict, upper: Dict, group: Dict) -> Dict:
+  """Returns the FIFOs of `group` and the estimated area saved by packing."""
+  producer_task = tasks[group['producer'][0]]
+  fifos = {}
+  area = dict(hardware.get_zero_area())
+  for fifo, (out_port, _) in group['fifos'].items():
+    width = _get_param(producer_task, out_port)['width'] + 1  # eot bit
+    depth = upper['fifos'][fifo]['depth']
+    fifos[fifo] = {'width': width, 'depth': depth}
+    for key, value in hardware.get_fifo_area(width, depth).items():
+      area[key] += value
+  packed_width = sum(x['width'] - 1 for x in fifos.values()) + 1
+  packed_depth = max(x['depth'] for x in fifos.values())
+  for key, value in hardware.get_fifo_area(packed_width, packed_depth).items():
+    area[key] -= value
+  return {
+      'producer': util.get_instance_name(group['producer']),
+      'consumer': util.get_instance_name(group['consumer']),
+      'fifos': fifos,
+      'width': packed_width,
+      'depth': packed_depth,
+      'area': area,
+  }
+
+
+def _log_report(name: str, report: Dict) -> None:
+  _logger.info('packed streams of task %s:', name)
+  _logger.info('  %-32s %6s %6s %6s %6s  %s', 'fifo', 'fifos', 'width', 'LUT',
+               'FF', 'streams')
+  for packed, info in report.items():
+    _logger.info('  %-32s %6d %6d %6d %6d  %s', packed, len(info['fifos']),
+                 info['width'], info['area']['LUT'], info['area']['FF'],
+                 ', '.join(info['fifos']))
+
+
+def pack_streams(program: Dict, report_file: str = '') -> Dict:
+  """Packs streams that lower-level task instances access in lockstep.
+
+  Args:
+    program: The program as generated by tapacc, modified in place.
+    report_file: If not empty, the report is also written to this JSON file.
+
+  Returns:
+    A dict mapping upper-level task names to their packed FIFOs, each with
+    the `producer` and `consumer` instances, the `fifos` it replaces with
+    their `width` and `depth`, its own `width` and `depth`, and the estimated
+    `area` saved by removing the FIFOs and adding the packed FIFO.
+  """
+  tasks = program['tasks']
+  reports = {}
+  packed_tasks = set()
+  for name, upper in list(tasks.items()):
+    if upper.get('level') != 'upper' or not upper.get('tasks'):
+      continue
+    groups = _get_groups(tasks, upper)
+    if not groups:
+      continue
+
+    report = {}
+    instance_groups: Dict[Instance, List[Dict]] = {}
+    for group in groups:
+      packed_fifo = _get_packed_name(list(group['fifos']))
+      if packed_fifo in upper['fifos']:
+        continue
+      group['packed_fifo'] = packed_fifo
+      report[packed_fifo] = _get_fifo_report(tasks, upper, group)
+      upper['fifos'][packed_fifo] = {
+          **upper['fifos'][next(iter(group['fifos']))],
+          'depth': report[packed_fifo]['depth'],
+      }
+      for instance in (group['producer'], group['consumer']):
+        instance_groups.setdefault(instance, []).append(group)
+    if not report:
+      continue
+
+    moved: Dict[Instance, str] = {}
+    for i, (instance, groups_of_instance) in enumerate(instance_groups.items()):
+      moved[instance] = f'{name}_packed_{i}'
+      _pack_instance(moved[instance], tasks, upper, instance,
+                     groups_of_instance)
+      packed_tasks.add(instance[0])
+    util.move_instances(
+        upper, moved,
+        [fifo for group in groups if 'packed_fifo' in group
+         for fifo in group['fifos']])
+    reports[name] = report
+    _log_report(name, report)
+
+  # tasks of which all instances are packed are no longer synthesized
+  instantiated = {program['top']}
+  for task in tasks.values():
+    instantiated.update(task.get('tasks', ()))
+  for task_name in packed_tasks - instantiated:
+    del tasks[task_name]
+
+  if report_file:
+    with open(report_file, 'w') as fp:
+      json.dump(reports, fp, indent=2)
+  return reports
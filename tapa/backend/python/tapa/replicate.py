@@ -0,0 +1,150 @@
+"""Expansion of task instances invoked with `tapa::replicated<n>`.
+
+tapacc records such an instance once, with its `replicate` count and the
+element types of its stream ports. Here the instance is replaced by `n`
+replicas of the task, a distributor that sends the tokens of the input FIFO
+to the replicas in round-robin order, and a collector that reads the results
+back in the same order, as the host runtime does in software simulation. The
+distributor and collector are generated as lower-level tasks that call
+`tapa::internal::distribute_round_robin` and
+`tapa::internal::collect_round_robin`, on top of the code of the replicated
+task so that user-defined element types are declared. They record the task
+they serve as `replicates`, so that the throughput estimation does not report
+them as bottlenecks of the replicas they feed at a fraction of their rate.
+"""
+
+import copy
+import logging
+from typing import Dict, List
+
+from tapa import util
+
+_logger = logging.getLogger().getChild(__name__)
+
+# depth of the FIFOs to and from the replicas, as `kStreamDefaultDepth`
+FIFO_DEPTH = 2
+
+
+def _generate_code(base_code: str, name: str, elem_type: str, n: int,
+                   is_distributor: bool) -> str:
+  if is_distributor:
+    params = (f'tapa::istream<{elem_type}>& in, '
+              f'tapa::ostreams<{elem_type}, {n}>& out')
+    pragmas = '\n\n'.join([
+        util.get_stream_pragmas('in', is_input=True),
+        util.get_stream_pragmas('out', is_input=False, length=n),
+    ])
+    body = f'tapa::internal::distribute_round_robin<{n}>(in, out);'
+  else:
+    params = (f'tapa::istreams<{elem_type}, {n}>& in, '
+              f'tapa::ostream<{elem_type}>& out')
+    pragmas = '\n\n'.join([
+        util.get_stream_pragmas('in', is_input=True, length=n),
+        util.get_stream_pragmas('out', is_input=False),
+    ])
+    body = f'tapa::internal::collect_round_robin<{n}>(in, out);'
+  return f'{base_code}\n\nvoid {name}({params}) {{\n{pragmas}\n\n{body}\n}}\n'
+
+
+def _add_task(
+    tasks: Dict,
+    child: str,
+    elem_type: str,
+    n: int,
+    is_distributor: bool,
+) -> str:
+  """Adds the distributor or collector of `child` and returns its name."""
+  name = f"{child}_{'distribute' if is_distributor else 'collect'}_{n}"
+  if name not in tasks:
+    ports = {('in' if is_distributor else 'out'): {'rate': 1., 'start': 0.}}
+    for i in range(n):
+      port = f"{'out' if is_distributor else 'in'}[{i}]"
+      ports[port] = {'rate': 1. / n, 'start': 0.}
+    tasks[name] = {
+        'code':
+            _generate_code(tasks[child]['code'], name, elem_type, n,
+                           is_distributor),
+        'level':
+            'lower',
+        'target':
+            tasks[child].get('target'),
+        'vendor':
+            tasks[child].get('vendor'),
+        'throughput': {
+            'loops': [],
+            'ports': ports
+        },
+        'replicates':
+            child,
+    }
+  return name
+
+
+def _replicate_instance(tasks: Dict, upper: Dict, child: str, idx: int) -> None:
+  instances: List[Dict] = upper['tasks'][child]
+  instance = instances[idx]
+  n = instance.pop('replicate')
+  args = instance['args']
+  in_port = next(k for k, v in args.items() if v['cat'] == 'istream')
+  out_port = next(k for k, v in args.items() if v['cat'] == 'ostream')
+  in_arg = args[in_port]
+  out_arg = args[out_port]
+  fifos = upper['fifos']
+  prefix = util.get_instance_name((child, idx))
+
+  distributor = _add_task(tasks, child, in_arg['type'], n, True)
+  collector = _add_task(tasks, child, out_arg['type'], n, False)
+  distributor_instances = upper['tasks'].setdefault(distributor, [])
+  collector_instances = upper['tasks'].setdefault(collector, [])
+  distributor_end = [distributor, len(distributor_instances)]
+  collector_end = [collector, len(collector_instances)]
+  distributor_args = {'in': {'cat': 'istream', 'arg': in_arg['arg']}}
+  collector_args = {'out': {'cat': 'ostream', 'arg': out_arg['arg']}}
+  fifos[in_arg['arg']]['consumed_by'] = distributor_end
+  fifos[out_arg['arg']]['produced_by'] = collector_end
+
+  # the first replica takes the place of the instance
+  replica_idxs = [idx] + list(range(len(instances), len(instances) + n - 1))
+  for i, replica_idx in enumerate(replica_idxs):
+    replica_in = f'{prefix}_replica_in[{i}]'
+    replica_out = f'{prefix}_replica_out[{i}]'
+    replica = copy.deepcopy(instance)
+    replica['args'][in_port] = {'cat': 'istream', 'arg': replica_in}
+    replica['args'][out_port] = {'cat': 'ostream', 'arg': replica_out}
+    if replica_idx == idx:
+      instances[idx] = replica
+    else:
+      instances.append(replica)
+    distributor_args[f'out[{i}]'] = {'cat': 'ostream', 'arg': replica_in}
+    collector_args[f'in[{i}]'] = {'cat': 'istream', 'arg': replica_out}
+    fifos[replica_in] = {
+        'depth': FIFO_DEPTH,
+        'produced_by': distributor_end,
+        'consumed_by': [child, replica_idx],
+    }
+    fifos[replica_out] = {
+        'depth': FIFO_DEPTH,
+        'produced_by': [child, replica_idx],
+        'consumed_by': collector_end,
+    }
+
+  distributor_instances.append({'step': -1, 'args': distributor_args})
+  collector_instances.append({'step': -1, 'args': collector_args})
+  _logger.info('replicated %s %d times with %s and %s', prefix, n, distributor,
+               collector)
+
+
+def replicate_tasks(program: Dict) -> None:
+  """Expands the instances invoked with `tapa::replicated<n>` in place.
+
+  Args:
+    program: The program as generated by tapacc, modified in place.
+  """
+  tasks = program['tasks']
+  for task in list(tasks.values()):
+    if task.get('level') != 'upper':
+      continue
+    for child, instances in list(task.get('tasks', {}).items()):
+      for idx in range(len(instances)):
+        if instances[idx].get('replicate'):
+          _replicate_instance(tasks, task, child, idx)
@@ -15,6 +15,12 @@ import haoda.backend.xilinx
 from absl import flags
 
 import tapa.core
+import tapa.fifo_depth
+import tapa.fusion
+import tapa.lsbuffer
+import tapa.packing
+import tapa.replicate
+import tapa.throughput
 import tapa.util
 from tapa.bitstream import get_vitis_script
 from tapa.floorplan_dse import run_floorplan_dse
@@ -147,6 +153,30 @@ def create_parser() -> argparse.ArgumentParser:
       'and the producer needs recompilation. When disabled, they are put in '
       'the same slot')
 
+  parser.add_argument(
+      '--fuse-tasks',
+      action='store_true',
+      dest='fuse_tasks',
+      help='Fuse linear chains of lightweight lower-level tasks into one task '
+      'each, and report the FIFOs removed.',
+  )
+
+  parser.add_argument(
+      '--pack-streams',
+      action='store_true',
+      dest='pack_streams',
+      help='Pack streams between the same task instances that are accessed '
+      'in lockstep into one stream each, and report the FIFOs removed.',
+  )
+
+  parser.add_argument(
+      '--convert-ls-buffers',
+      action='store_true',
+      dest='convert_ls_buffers',
+      help='Convert ping-pong buffers to single-section LS buffers wherever '
+      'tapacc estimates that the pipeline is not slowed down.',
+  )
+
   group = parser.add_argument_group(
       title='Compilation Steps',
       description='Selectively run compilation steps (advanced usage).',
@@ -609,6 +639,8 @@ def main(argv: Optional[List[str]] = None):
         '..',
         'src',
     )
+    if args.convert_ls_buffers:
+      tapacc_cmd += '-convert-ls-buffers',
     tapacc_cmd += '-top', args.top, '--', '-I', tapa_include_dir
 
     if args.enable_buffer_support:
@@ -710,17 +742,47 @@ def main(argv: Optional[List[str]] = None):
       with open(os.path.join(input_file_dirname, dep), 'r') as dep_fp:
         tapa_program_json_dict['headers'][dep] = dep_fp.read()
     tapa_program_json_dict['cflags'] = cflag_list
-    tapa_program_json_str = json.dumps(tapa_program_json_dict, indent=2)
+
+    # instantiate the replicas of tapa::replicated tasks
+    tapa.replicate.replicate_tasks(tapa_program_json_dict)
 
     # save program.json if work_dir is set or run_tapacc is the last step
+    tapa_program_json_file = ''
     if args.work_dir is not None or last_step == 'run_tapacc':
       if last_step == 'run_tapacc':
         tapa_program_json_file = args.output_file
       else:
         tapa_program_json_file = os.path.join(args.work_dir, 'program.json')
       os.makedirs(os.path.dirname(tapa_program_json_file) or '.', exist_ok=True)
+
+    def get_report_file(name: str) -> str:
+      if not tapa_program_json_file:
+        return ''
+      return os.path.join(os.path.dirname(tapa_program_json_file), name)
+
+    # estimate the throughput before spending time on HLS
+    throughput_reports = tapa.throughput.analyze_throughput(
+        tapa_program_json_dict, get_report_file('throughput.json'))
+
+    # set the depth of tapa::auto_depth FIFOs before program.json is saved
+    tapa.fifo_depth.infer_fifo_depths(tapa_program_json_dict,
+                                      throughput_reports,
+                                      get_report_file('fifo_depth.json'))
+
+    tapa.lsbuffer.report_ls_buffers(tapa_program_json_dict,
+                                    get_report_file('ls_buffers.json'))
+
+    if args.fuse_tasks:
+      tapa.fusion.fuse_tasks(tapa_program_json_dict,
+                             get_report_file('fusion.json'))
+
+    if args.pack_streams:
+      tapa.packing.pack_streams(tapa_program_json_dict,
+                                get_report_file('packing.json'))
+
+    if tapa_program_json_file:
       with open(tapa_program_json_file, 'w') as output_fp:
-        output_fp.write(tapa_program_json_str)
+        json.dump(tapa_program_json_dict, output_fp, indent=2)
     tapa_program_json = lambda: tapa_program_json_dict
   else:
     if args.input_file.endswith('.json') or args.work_dir is None:
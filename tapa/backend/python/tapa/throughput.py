@@ -0,0 +1,241 @@
+"""Static throughput estimation of the task graph.
+
+For every lower-level task, tapacc estimates the tokens per cycle that each
+stream port transfers in the steady state of the task, as `throughput` in the
+task metadata. Here the rates are propagated through the FIFOs of each
+upper-level task: both ends of a FIFO transfer the same number of tokens per
+cycle, so the faster end is slowed down to the slower one until all FIFOs
+agree. Every task instance ends up with a utilization, i.e., the fraction of
+its own peak rate that it sustains, and with the instance that slows it down.
+
+The estimates know nothing about the latency of tasks, the depth of FIFOs, or
+memory accesses; they are meant to spot rate-limiting tasks before running
+HLS. The distributors and collectors of replicated tasks are never reported
+as bottlenecks: by design, each replica only sustains a fraction of its peak
+rate.
+"""
+
+import collections
+import json
+import logging
+from typing import Dict, List, NamedTuple, Optional, Set, Tuple
+
+import toposort
+
+from tapa import util
+
+_logger = logging.getLogger().getChild(__name__)
+
+# relative tolerance of rate comparisons
+EPSILON = 1e-6
+
+# bound on the propagation rounds, reached only by cycles of mismatched rates
+MAX_ROUNDS = 1000
+
+
+class Channel(NamedTuple):
+  fifo: str
+  producer: str
+  producer_rate: float
+  consumer: str
+  consumer_rate: float
+
+
+def _get_port_rates(task: Dict) -> Dict[str, float]:
+  ports = task.get('throughput', {}).get('ports', {})
+  return {port: info['rate'] for port, info in ports.items()}
+
+
+def get_instance_ports(
+    task: Dict) -> Tuple[Dict[str, str], Dict[str, Dict[str, str]]]:
+  """Returns the task of each instance of an upper-level task, and the stream
+  port of each instance connected to each FIFO.
+  """
+  instances: Dict[str, str] = {}
+  ports: Dict[str, Dict[str, str]] = {}
+  for child, child_instances in task['tasks'].items():
+    for idx, instance in enumerate(child_instances):
+      instance_name = util.get_instance_name((child, idx))
+      instances[instance_name] = child
+      ports[instance_name] = {
+          arg['arg']: port
+          for port, arg in instance.get('args', {}).items()
+          if arg['cat'] in {'istream', 'ostream'}
+      }
+  return instances, ports
+
+
+def get_end(end: List) -> str:
+  return util.get_instance_name(tuple(end))
+
+
+def _analyze_upper_task(
+    name: str,
+    task: Dict,
+    port_rates: Dict[str, Dict[str, float]],
+    ignored: Set[str],
+) -> Dict:
+  """Propagates the port rates of the children of an upper-level task.
+
+  Returns the report of the task and sets `port_rates` of the task itself.
+  Instances of the tasks in `ignored` are not reported as the bottleneck.
+  """
+  instances, ports = get_instance_ports(task)
+
+  def get_rate(instance: str, fifo: str) -> float:
+    port = ports[instance].get(fifo)
+    return port_rates.get(instances[instance], {}).get(port, 0.)
+
+  channels: List[Channel] = []
+  external = {}  # port of the upper-level task -> instance
+  for fifo, fifo_obj in task.get('fifos', {}).items():
+    if 'produced_by' in fifo_obj and 'consumed_by' in fifo_obj:
+      producer = get_end(fifo_obj['produced_by'])
+      consumer = get_end(fifo_obj['consumed_by'])
+      channels.append(
+          Channel(fifo, producer, get_rate(producer, fifo), consumer,
+                  get_rate(consumer, fifo)))
+    else:
+      end = fifo_obj.get('produced_by', fifo_obj.get('consumed_by'))
+      if end is not None:
+        external[fifo] = get_end(end)
+
+  utilization = {instance: 1. for instance in instances}
+  limited_by: Dict[str, Optional[str]] = {x: None for x in instances}
+  via: Dict[str, Optional[str]] = {x: None for x in instances}
+
+  def slow_down(instance: str, rate: float, peak: float, other: str,
+                fifo: str) -> None:
+    utilization[instance] = rate / peak
+    limited_by[instance] = limited_by[other] or other
+    via[instance] = fifo
+
+  for _ in range(MAX_ROUNDS):
+    is_changed = False
+    for channel in channels:
+      # rates of 0 are unknown and do not constrain the other end
+      if channel.producer_rate <= 0 or channel.consumer_rate <= 0:
+        continue
+      produced = channel.producer_rate * utilization[channel.producer]
+      consumed = channel.consumer_rate * utilization[channel.consumer]
+      if produced < consumed * (1 - EPSILON):
+        slow_down(channel.consumer, produced, channel.consumer_rate,
+                  channel.producer, channel.fifo)
+        is_changed = True
+      elif consumed < produced * (1 - EPSILON):
+        slow_down(channel.producer, consumed, channel.producer_rate,
+                  channel.consumer, channel.fifo)
+        is_changed = True
+    if not is_changed:
+      break
+  else:
+    _logger.warning('  rates did not converge; a FIFO cycle may deadlock')
+
+  # the ports of this task run at the rates of the instances connected to them
+  port_rates[name] = {
+      port: get_rate(instance, port) * utilization[instance]
+      for port, instance in external.items()
+  }
+
+  # the instance that slows down the most others, and the FIFO through which
+  # it slows down the instance with the lowest utilization
+  bottleneck = None
+  counts = collections.Counter(
+      x for x in limited_by.values()
+      if x is not None and instances[x] not in ignored)
+  if counts:
+    instance = counts.most_common(1)[0][0]
+    limited = [x for x in instances if limited_by[x] == instance]
+    fifos = [
+        channel.fifo
+        for channel in channels
+        if instance in {channel.producer, channel.consumer}
+    ]
+    neighbors = [x for x in limited if via[x] in fifos] or limited
+    slowest = min(neighbors, key=utilization.__getitem__)
+    bottleneck = {
+        'instance': instance,
+        'task': instances[instance],
+        'fifo': via[slowest],
+        'limits': len(limited),
+    }
+
+  return {
+      'instances': {
+          instance: {
+              'task': instances[instance],
+              'utilization': utilization[instance],
+              'limited_by': limited_by[instance],
+              'via': via[instance],
+          } for instance in instances
+      },
+      'fifos': {
+          channel.fifo: {
+              'producer': channel.producer,
+              'producer_rate': channel.producer_rate,
+              'consumer': channel.consumer,
+              'consumer_rate': channel.consumer_rate,
+              'rate': min(
+                  channel.producer_rate * utilization[channel.producer],
+                  channel.consumer_rate * utilization[channel.consumer]),
+          } for channel in channels
+      },
+      'bottleneck': bottleneck,
+  }
+
+
+def _log_report(name: str, report: Dict) -> None:
+  _logger.info('estimated throughput of task %s:', name)
+  _logger.info('  %-32s %-24s %6s  %s', 'instance', 'task', 'util',
+               'limited by')
+  for instance, info in report['instances'].items():
+    limited_by = ''
+    if info['limited_by'] is not None:
+      limited_by = f"{info['limited_by']} via {info['via']}"
+    _logger.info('  %-32s %-24s %5.1f%%  %s', instance, info['task'],
+                 info['utilization'] * 100, limited_by)
+  if report['fifos']:
+    _logger.info('  %-32s %12s %12s %12s', 'fifo (tokens/cycle)', 'produced',
+                 'consumed', 'sustained')
+    for fifo, info in report['fifos'].items():
+      _logger.info('  %-32s %12.3f %12.3f %12.3f', fifo, info['producer_rate'],
+                   info['consumer_rate'], info['rate'])
+  bottleneck = report['bottleneck']
+  if bottleneck is not None:
+    _logger.info('  bottleneck: %s (%s) limits %d instance(s) via fifo %s',
+                 bottleneck['instance'], bottleneck['task'],
+                 bottleneck['limits'], bottleneck['fifo'])
+
+
+def analyze_throughput(program: Dict, report_file: str = '') -> Dict:
+  """Estimates the throughput of every upper-level task of a program.
+
+  Args:
+    program: The program as generated by tapacc.
+    report_file: If not empty, the report is also written to this JSON file.
+
+  Returns:
+    A dict mapping upper-level task names to reports: `instances` with the
+    utilization of every instance and the instance and FIFO limiting it,
+    `fifos` with the rates of both ends and the sustained rate in tokens per
+    cycle, and the `bottleneck` instance.
+  """
+  tasks = program['tasks']
+  port_rates: Dict[str, Dict[str, float]] = {}
+  replicators = {k for k, v in tasks.items() if 'replicates' in v}
+  reports = {}
+  # children go first
+  for name in toposort.toposort_flatten(
+      {k: set(v.get('tasks', ())) for k, v in tasks.items()}):
+    task = tasks[name]
+    if task.get('level') != 'upper':
+      port_rates[name] = _get_port_rates(task)
+    elif task.get('tasks'):
+      reports[name] = _analyze_upper_task(name, task, port_rates,
+                                          replicators)
+      _log_report(name, reports[name])
+
+  if report_file:
+    with open(report_file, 'w') as fp:
+      json.dump(reports, fp, indent=2)
+  return reports
@@ -5,7 +5,7 @@ import os.path
 import shutil
 import subprocess
 import time
-from typing import Dict, Iterator, Optional, TextIO, Tuple
+from typing import Dict, Iterable, Iterator, List, Optional, TextIO, Tuple
 
 import absl.logging
 import coloredlogs
@@ -36,6 +36,56 @@ def get_instance_name(item: Tuple[str, int]) -> str:
   return '_'.join(map(str, item))
 
 
+def get_stream_pragmas(name: str, is_input: bool, length: int = 0) -> str:
+  """Returns the code tapacc adds for a stream parameter of a lower task."""
+  lines = [f'#pragma HLS disaggregate variable = {name}']
+  names = [name]
+  if length:
+    lines.append(f'#pragma HLS array_partition variable = {name} complete')
+    names = [f'{name}[{i}]' for i in range(length)]
+  for var in names:
+    lines.append(f'#pragma HLS interface ap_fifo port = {var}._')
+    lines.append(f'#pragma HLS aggregate variable = {var}._ bit')
+    if is_input:
+      lines.append(f'#pragma HLS interface ap_fifo port = {var}._peek')
+      lines.append(f'#pragma HLS aggregate variable = {var}._peek bit')
+      lines.append(f'void({var}._.empty());')
+      lines.append(f'void({var}._peek.empty());')
+    else:
+      lines.append(f'void({var}._.full());')
+  return '\n'.join(lines)
+
+
+def move_instances(upper: Dict, moved: Dict[Tuple[str, int], str],
+                   removed_fifos: Iterable[str]) -> None:
+  """Moves instances of an upper-level task to the only instance of new tasks.
+
+  Args:
+    upper: The upper-level task, modified in place.
+    moved: Maps each moved instance to the new task that replaces it, which
+      `upper` already instantiates once.
+    removed_fifos: FIFOs to remove from `upper`.
+  """
+  index_map: Dict[Tuple[str, int], List] = {}
+  instances = {}
+  for task_name, task_instances in upper['tasks'].items():
+    for idx, instance in enumerate(task_instances):
+      if (task_name, idx) in moved:
+        index_map[(task_name, idx)] = [moved[(task_name, idx)], 0]
+        continue
+      kept = instances.setdefault(task_name, [])
+      index_map[(task_name, idx)] = [task_name, len(kept)]
+      kept.append(instance)
+  upper['tasks'] = instances
+
+  for fifo in removed_fifos:
+    del upper['fifos'][fifo]
+  for fifo_obj in upper['fifos'].values():
+    for end in ('produced_by', 'consumed_by'):
+      if end in fifo_obj:
+        fifo_obj[end] = index_map[tuple(fifo_obj[end])]
+
+
 def get_module_name(module: str) -> str:
   return f'{module}'
 
@@ -587,25 +587,14 @@ class Module:
       yield ast.make_port_arg(port='clk', arg=CLK)
       yield ast.make_port_arg(port='reset', arg=rst_q[-1])
 
-      # generate FIFO producer side ports
-      producer_buffer_fifo_ports = buffer_config.get_producer_fifo_port_names()
-      for port_name in producer_buffer_fifo_ports[:-2]:
-        yield ast.make_port_arg(port=port_name,
-                                arg=wire_name(name, f'{port_name}'))
-
-      # set the `*_ce` signals to always TRUE
-      yield ast.make_port_arg(port=producer_buffer_fifo_ports[-1], arg=TRUE)
-      yield ast.make_port_arg(port=producer_buffer_fifo_ports[-2], arg=TRUE)
-
-      # generate the FIFO consumer side ports
-      consumer_buffer_fifo_ports = buffer_config.get_consumer_fifo_port_names()
-      for port_name in consumer_buffer_fifo_ports[:-2]:
-        yield ast.make_port_arg(port=port_name,
-                                arg=wire_name(name, f'{port_name}'))
-
-      # set the `*_ce` signals to always TRUE
-      yield ast.make_port_arg(port=consumer_buffer_fifo_ports[-1], arg=TRUE)
-      yield ast.make_port_arg(port=consumer_buffer_fifo_ports[-2], arg=TRUE)
+      # generate FIFO ports, with the `*_ce` signals set to always TRUE
+      for port_name in (*buffer_config.get_producer_fifo_port_names(),
+                        *buffer_config.get_consumer_fifo_port_names()):
+        if port_name.endswith('_ce'):
+          yield ast.make_port_arg(port=port_name, arg=TRUE)
+        else:
+          yield ast.make_port_arg(port=port_name,
+                                  arg=wire_name(name, f'{port_name}'))
 
       dims_patterns = buffer_config.get_dim_patterns()
       for index in index_generator(dims_patterns):
@@ -669,6 +658,8 @@ class Module:
       max_wait_time: int = 3,
       max_burst_len: Optional[int] = None,
       offset_name: str = '',
+      max_read_gap: int = 0,
+      read_cache_depth: int = 0,
   ) -> 'Module':
     rst_q = Pipeline(f'{name}__rst', level=self.register_level)
     self.add_pipeline(rst_q, init=ast.Unot(RST_N))
@@ -711,6 +702,27 @@ class Module:
         ast.ParamArg(paramname='MaxBurstLen',
                      argname=ast.Constant(max_burst_len)))
 
+    # strided and gathered reads; see tapa::access_pattern
+    pattern_width = 8
+    for param, value in (('max_gap', max_read_gap),
+                         ('cache_depth', read_cache_depth)):
+      if not 0 <= value < 2**pattern_width:
+        raise ValueError(f'access_pattern {param} of async_mmap {name} must be '
+                         f'in [0, {2**pattern_width}); got {value}')
+    if max_read_gap > 0 or read_cache_depth > 0:
+      _logger.info(
+          'async_mmap %s folds read gaps of up to %d words into bursts and '
+          'serves repeated reads of the last %d words', name, max_read_gap,
+          read_cache_depth)
+      paramargs.extend((
+          ast.ParamArg(paramname='MaxReadGap',
+                       argname=ast.Constant(max_read_gap)),
+          ast.ParamArg(paramname='ReadCacheDepth',
+                       argname=ast.Constant(read_cache_depth)),
+          ast.ParamArg(paramname='PatternWidth',
+                       argname=ast.Constant(pattern_width)),
+      ))
+
     for channel, ports in M_AXI_PORTS.items():
       for port, direction in ports:
         portargs.append(
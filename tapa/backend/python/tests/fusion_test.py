@@ -0,0 +1,93 @@
+"""Tests of `tapa.fusion` on program.json fixtures."""
+
+import json
+import os.path
+import unittest
+
+from tapa import fusion
+
+_TESTDATA = os.path.join(os.path.dirname(__file__), 'testdata')
+
+
+def _load(name: str) -> dict:
+  with open(os.path.join(_TESTDATA, name)) as fp:
+    return json.load(fp)
+
+
+def _get_definition(code: str, name: str) -> str:
+  return code.split(f'void {name}(', 1)[1].split('\n}\n', 1)[0]
+
+
+class FuseTasksTest(unittest.TestCase):
+
+  def test_fuse_chain(self):
+    program = _load('fusion.json')
+    report = fusion.fuse_tasks(program)
+
+    self.assertEqual(list(report), ['Top'])
+    self.assertEqual(list(report['Top']), ['Top_fused_0'])
+    fused = report['Top']['Top_fused_0']
+    self.assertEqual(fused['instances'], ['A_0', 'B_0', 'C_0'])
+    self.assertEqual(fused['fifos'], {
+        'a_b': {
+            'width': 33,
+            'depth': 2
+        },
+        'b_c': {
+            'width': 33,
+            'depth': 4
+        },
+    })
+
+    tasks = program['tasks']
+    top = tasks['Top']
+    self.assertEqual(sorted(top['fifos']), ['in', 'out'])
+    self.assertEqual(list(top['tasks']), ['Top_fused_0'])
+    self.assertEqual(
+        top['tasks']['Top_fused_0'][0]['args'], {
+            'in_0': {
+                'cat': 'istream',
+                'arg': 'in'
+            },
+            'out_2': {
+                'cat': 'ostream',
+                'arg': 'out'
+            },
+        })
+    for name in ('A', 'B', 'C'):
+      self.assertNotIn(name, tasks)
+
+    code = tasks['Top_fused_0']['code']
+    self.assertIn(
+        'void Top_fused_0(tapa::istream<float> & in_0, '
+        'tapa::ostream<float> & out_2)', code)
+    self.assertIn('  tapa::internal::fused_stream<float, 2> a_b_fifo;', code)
+    self.assertIn('  tapa::internal::fused_stream<float, 4> b_c_fifo;', code)
+    self.assertIn('  Top_fused_0_1(a_b_fifo, b_c_fifo);', code)
+
+    # fused streams keep none of the pragmas of the streams they replace
+    head = _get_definition(code, 'Top_fused_0_0')
+    self.assertIn('port = in._peek', head)
+    self.assertNotIn('port = out._', head)
+    middle = _get_definition(code, 'Top_fused_0_1')
+    self.assertIn('tapa::internal::fused_istream<float, 2> in(a_b_fifo);',
+                  middle)
+    self.assertNotIn('#pragma', middle)
+    tail = _get_definition(code, 'Top_fused_0_2')
+    self.assertNotIn('port = in._', tail)
+    self.assertIn('port = out._', tail)
+
+  def test_keep_chain_out_of_lockstep(self):
+    program = _load('fusion.json')
+    # `B` only writes every other token it reads
+    program['tasks']['B']['throughput']['ports']['out']['rate'] = 0.5
+    report = fusion.fuse_tasks(program)
+
+    self.assertEqual(list(report['Top']), ['Top_fused_0'])
+    self.assertEqual(report['Top']['Top_fused_0']['instances'], ['A_0', 'B_0'])
+    self.assertIn('C', program['tasks'])
+    self.assertIn('b_c', program['tasks']['Top']['fifos'])
+
+
+if __name__ == '__main__':
+  unittest.main()
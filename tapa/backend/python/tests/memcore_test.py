@@ -0,0 +1,57 @@
+"""Tests of `tapa.codegen.memcore` on buffer configs."""
+
+import unittest
+
+from tapa.codegen.buffer import BufferConfig
+from tapa.codegen.memcore import select_memcores
+
+
+def _config(memcore_type: str) -> BufferConfig:
+  # 2 banks of 4096 x 72-bit, each taking 16 BRAM_18K or 1 URAM
+  return BufferConfig({
+      'width': 72,
+      'type': 'ap_uint<72>',
+      'dims': [8192],
+      'n_sections': 1,
+      'partitions': [{
+          'type': 'cyclic',
+          'factor': 2
+      }],
+      'memcore_type': memcore_type,
+  })
+
+
+class SelectMemcoresTest(unittest.TestCase):
+
+  def test_single_instance(self):
+    # URAM is scarcer for one buffer, which therefore takes BRAM only
+    selections = select_memcores(
+        {'buffer_0': _config('AUTO')},
+        device_memory={'BRAM_18K': 300, 'URAM': 40},
+        used_memory={'BRAM_18K': 0, 'URAM': 36},
+    )
+    self.assertEqual(selections, {'buffer_0': ('BRAM', 'BRAM')})
+
+  def test_instance_counts(self):
+    # 16 instances overflow the BRAM with BRAM only
+    selections = select_memcores(
+        {'buffer_0': _config('AUTO')},
+        device_memory={'BRAM_18K': 300, 'URAM': 40},
+        used_memory={'BRAM_18K': 0, 'URAM': 36},
+        instance_counts={'buffer_0': 16},
+    )
+    self.assertEqual(selections, {'buffer_0': ('URAM', 'BRAM')})
+
+  def test_fixed_instance_counts(self):
+    # 16 instances of a fixed BRAM buffer leave URAM for the `AUTO` one
+    selections = select_memcores(
+        {'buffer_0': _config('BRAM'), 'buffer_1': _config('AUTO')},
+        device_memory={'BRAM_18K': 600, 'URAM': 20},
+        used_memory={'BRAM_18K': 0, 'URAM': 0},
+        instance_counts={'buffer_0': 16},
+    )
+    self.assertEqual(selections, {'buffer_1': ('URAM', 'URAM')})
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -0,0 +1,88 @@
+"""Tests of `tapa.packing` on program.json fixtures."""
+
+import json
+import os.path
+import unittest
+
+from tapa import packing
+
+_TESTDATA = os.path.join(os.path.dirname(__file__), 'testdata')
+
+
+def _load(name: str) -> dict:
+  with open(os.path.join(_TESTDATA, name)) as fp:
+    return json.load(fp)
+
+
+class PackStreamsTest(unittest.TestCase):
+
+  def test_pack_lockstep_streams(self):
+    program = _load('packing.json')
+    report = packing.pack_streams(program)
+
+    self.assertEqual(list(report), ['Top'])
+    self.assertEqual(list(report['Top']), ['split_0_split_1'])
+    packed = report['Top']['split_0_split_1']
+    self.assertEqual(packed['producer'], 'Split_0')
+    self.assertEqual(packed['consumer'], 'Merge_0')
+    self.assertEqual(list(packed['fifos']), ['split_0', 'split_1'])
+    self.assertEqual(packed['width'], 65)
+    self.assertEqual(packed['depth'], 4)
+
+    tasks = program['tasks']
+    top = tasks['Top']
+    self.assertEqual(sorted(top['fifos']), ['in', 'out', 'split_0_split_1'])
+    self.assertEqual(top['fifos']['split_0_split_1']['depth'], 4)
+    self.assertEqual(sorted(top['tasks']), ['Top_packed_0', 'Top_packed_1'])
+    self.assertNotIn('Split', tasks)
+    self.assertNotIn('Merge', tasks)
+
+    # the producer writes and closes the packed stream on its last lane
+    producer = top['tasks']['Top_packed_0'][0]
+    self.assertEqual(sorted(producer['args']), ['in', 'out_0_out_1'])
+    self.assertEqual(
+        producer['args']['out_0_out_1'],
+        {'cat': 'ostream', 'arg': 'split_0_split_1'},
+    )
+    code = tasks['Top_packed_0']['code']
+    self.assertIn(
+        'tapa::ostream<tapa::internal::packed_t<float, 2>>& out_0_out_1', code)
+    self.assertIn(
+        'tapa::internal::ostream_lane<float, 2, 0, false> out_0(out_0_out_1, '
+        'out_0_out_1_lanes);', code)
+    self.assertIn(
+        'tapa::internal::ostream_lane<float, 2, 1, true> out_1(out_0_out_1, '
+        'out_0_out_1_lanes);', code)
+    self.assertNotIn('port = out_0._', code.split('void Top_packed_0')[1])
+
+    # the consumer reads and opens it on its first lane
+    consumer = top['tasks']['Top_packed_1'][0]
+    self.assertEqual(sorted(consumer['args']), ['in_0_in_1', 'out'])
+    self.assertEqual(
+        consumer['args']['in_0_in_1'],
+        {'cat': 'istream', 'arg': 'split_0_split_1'},
+    )
+    code = tasks['Top_packed_1']['code']
+    self.assertIn(
+        'tapa::internal::istream_lane<float, 2, 0, true> in_0(in_0_in_1, '
+        'in_0_in_1_lanes);', code)
+    self.assertIn(
+        'tapa::internal::istream_lane<float, 2, 1, false> in_1(in_0_in_1, '
+        'in_0_in_1_lanes);', code)
+
+  def test_keep_streams_out_of_lockstep(self):
+    program = _load('packing.json')
+    # `in_1` is read under a different branch than `in_0`
+    program['tasks']['Merge']['throughput']['loops'][0]['guards']['in_1'] = 1
+    self.assertEqual(packing.pack_streams(program), {})
+    self.assertIn('Split', program['tasks'])
+    self.assertIn('split_0', program['tasks']['Top']['fifos'])
+
+  def test_keep_streams_peeked_after_transfer(self):
+    program = _load('packing.json')
+    program['tasks']['Merge']['throughput']['peeked'] = ['in_1']
+    self.assertEqual(packing.pack_streams(program), {})
+
+
+if __name__ == '__main__':
+  unittest.main()
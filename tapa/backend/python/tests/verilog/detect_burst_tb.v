@@ -0,0 +1,139 @@
+`timescale 1ns / 1ps
+`default_nettype none
+
+// Feeds word addresses 0, 1, 2, 5, 4, 9 to detect_burst with MaxGap = 2 and
+// CacheDepth = 2, and checks the bursts and the patterns written out: 5 joins
+// the burst over the gap of 2 words, 4 is served by the burst as the 2nd most
+// recent word, and 9 starts a new burst that is written out after
+// max_wait_time cycles without addresses.
+module detect_burst_tb;
+  localparam AddrWidth = 32;
+  localparam DataWidthBytesLog = 6;
+  localparam BurstLenWidth = 8;
+  localparam PatternWidth = 8;
+  localparam AddrCount = 6;
+  localparam BurstCount = 2;
+
+  reg clk = 1'b0;
+  reg rst = 1'b1;
+  always #5 clk = !clk;
+
+  reg [AddrWidth-1:0] addrs [0:AddrCount-1];
+  reg [BurstLenWidth+AddrWidth-1:0] expected_bursts [0:BurstCount-1];
+  reg [PatternWidth:0] expected_patterns [0:AddrCount-1];
+  integer addr_idx = 0;
+  integer burst_idx = 0;
+  integer pattern_idx = 0;
+  integer errors = 0;
+
+  wire addr_read;
+  wire [BurstLenWidth+AddrWidth-1:0] addr_din;
+  wire addr_write;
+  wire [BurstLenWidth-1:0] burst_len_0_din;
+  wire burst_len_0_write;
+  wire [BurstLenWidth-1:0] burst_len_1_din;
+  wire burst_len_1_write;
+  wire [PatternWidth:0] pattern_din;
+  wire pattern_write;
+
+  detect_burst #(
+    .AddrWidth(AddrWidth),
+    .DataWidthBytesLog(DataWidthBytesLog),
+    .WaitTimeWidth(4),
+    .BurstLenWidth(BurstLenWidth),
+    .MaxGap(2),
+    .CacheDepth(2),
+    .PatternWidth(PatternWidth)
+  ) dut (
+    .clk(clk),
+    .rst(rst),
+    .max_wait_time(4'd3),
+    .max_burst_len(8'd255),
+    .addr_dout(addrs[addr_idx < AddrCount ? addr_idx : 0]),
+    .addr_empty_n(!rst && addr_idx < AddrCount),
+    .addr_read(addr_read),
+    .addr_din(addr_din),
+    .addr_full_n(1'b1),
+    .addr_write(addr_write),
+    .burst_len_0_din(burst_len_0_din),
+    .burst_len_0_full_n(1'b1),
+    .burst_len_0_write(burst_len_0_write),
+    .burst_len_1_din(burst_len_1_din),
+    .burst_len_1_full_n(1'b1),
+    .burst_len_1_write(burst_len_1_write),
+    .pattern_din(pattern_din),
+    .pattern_full_n(1'b1),
+    .pattern_write(pattern_write)
+  );
+
+  always @(posedge clk) begin
+    if (!rst) begin
+      if (addr_read) begin
+        addr_idx <= addr_idx + 1;
+      end
+      if (addr_write) begin
+        if (burst_idx >= BurstCount) begin
+          $display("unexpected burst %h", addr_din);
+          errors = errors + 1;
+        end else if (addr_din !== expected_bursts[burst_idx]) begin
+          $display("burst %0d: expected %h, got %h", burst_idx,
+                   expected_bursts[burst_idx], addr_din);
+          errors = errors + 1;
+        end
+        burst_idx <= burst_idx + 1;
+      end
+      if (pattern_write) begin
+        if (pattern_idx >= AddrCount) begin
+          $display("unexpected pattern %h", pattern_din);
+          errors = errors + 1;
+        end else if (pattern_din !== expected_patterns[pattern_idx]) begin
+          $display("pattern %0d: expected %h, got %h", pattern_idx,
+                   expected_patterns[pattern_idx], pattern_din);
+          errors = errors + 1;
+        end
+        pattern_idx <= pattern_idx + 1;
+      end
+    end
+  end
+
+  initial begin
+    addrs[0] = 0 << DataWidthBytesLog;
+    addrs[1] = 1 << DataWidthBytesLog;
+    addrs[2] = 2 << DataWidthBytesLog;
+    addrs[3] = 5 << DataWidthBytesLog;
+    addrs[4] = 4 << DataWidthBytesLog;
+    addrs[5] = 9 << DataWidthBytesLog;
+    // {burst_len, base_addr}; burst_len is the number of beats minus 1
+    expected_bursts[0] = {8'd5, 32'd0 << DataWidthBytesLog};
+    expected_bursts[1] = {8'd0, 32'd9 << DataWidthBytesLog};
+    expected_patterns[0] = {1'b0, 8'd0};
+    expected_patterns[1] = {1'b0, 8'd0};
+    expected_patterns[2] = {1'b0, 8'd0};
+    expected_patterns[3] = {1'b0, 8'd2};
+    expected_patterns[4] = {1'b1, 8'd1};
+    expected_patterns[5] = {1'b0, 8'd0};
+
+    repeat (4) @(posedge clk);
+    rst <= 1'b0;
+    repeat (64) @(posedge clk);
+
+    if (burst_idx != BurstCount) begin
+      $display("expected %0d bursts, got %0d", BurstCount, burst_idx);
+      errors = errors + 1;
+    end
+    if (pattern_idx != AddrCount) begin
+      $display("expected %0d patterns, got %0d", AddrCount, pattern_idx);
+      errors = errors + 1;
+    end
+    if (errors == 0) begin
+      $display("PASS!");
+    end else begin
+      $display("FAIL: %0d errors", errors);
+      $fatal(1);
+    end
+    $finish;
+  end
+
+endmodule  // detect_burst_tb
+
+`default_nettype wire
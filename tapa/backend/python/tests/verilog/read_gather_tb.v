@@ -0,0 +1,119 @@
+`timescale 1ns / 1ps
+`default_nettype none
+
+// Feeds read_gather the patterns that detect_burst writes out for word
+// addresses 0, 1, 2, 5, 4, 9, i.e., the bursts of words 0-5 and 9 with 3 and 4
+// dropped and 4 repeated, and checks the data of the addresses. The output
+// FIFO is full every third cycle to check the backpressure.
+module read_gather_tb;
+  localparam DataWidth = 32;
+  localparam PatternWidth = 8;
+  localparam AddrCount = 6;
+  localparam BeatCount = 7;
+
+  reg clk = 1'b0;
+  reg rst = 1'b1;
+  always #5 clk = !clk;
+
+  reg [PatternWidth:0] patterns [0:AddrCount-1];
+  reg [DataWidth-1:0] beats [0:BeatCount-1];
+  reg [DataWidth-1:0] expected_data [0:AddrCount-1];
+  integer pattern_idx = 0;
+  integer beat_idx = 0;
+  integer data_idx = 0;
+  integer cycle = 0;
+  integer errors = 0;
+
+  wire pattern_read;
+  wire beat_ready;
+  wire [DataWidth-1:0] read_data_din;
+  wire read_data_full_n = cycle % 3 != 2;
+  wire read_data_write;
+
+  read_gather #(
+    .DataWidth(DataWidth),
+    .PatternWidth(PatternWidth),
+    .CacheDepth(2)
+  ) dut (
+    .clk(clk),
+    .rst(rst),
+    .pattern_dout(patterns[pattern_idx < AddrCount ? pattern_idx : 0]),
+    .pattern_empty_n(!rst && pattern_idx < AddrCount),
+    .pattern_read(pattern_read),
+    .beat_data(beats[beat_idx < BeatCount ? beat_idx : 0]),
+    .beat_valid(!rst && beat_idx < BeatCount),
+    .beat_ready(beat_ready),
+    .read_data_din(read_data_din),
+    .read_data_full_n(read_data_full_n),
+    .read_data_write(read_data_write)
+  );
+
+  always @(posedge clk) begin
+    cycle <= cycle + 1;
+    if (!rst) begin
+      if (pattern_read) begin
+        pattern_idx <= pattern_idx + 1;
+      end
+      if (beat_ready && beat_idx < BeatCount) begin
+        beat_idx <= beat_idx + 1;
+      end
+      if (read_data_write) begin
+        if (data_idx >= AddrCount) begin
+          $display("unexpected data %h", read_data_din);
+          errors = errors + 1;
+        end else if (read_data_din !== expected_data[data_idx]) begin
+          $display("data %0d: expected %h, got %h", data_idx,
+                   expected_data[data_idx], read_data_din);
+          errors = errors + 1;
+        end
+        data_idx <= data_idx + 1;
+      end
+    end
+  end
+
+  initial begin
+    patterns[0] = {1'b0, 8'd0};
+    patterns[1] = {1'b0, 8'd0};
+    patterns[2] = {1'b0, 8'd0};
+    patterns[3] = {1'b0, 8'd2};
+    patterns[4] = {1'b1, 8'd1};
+    patterns[5] = {1'b0, 8'd0};
+    // data of each beat is its word address
+    beats[0] = 0;
+    beats[1] = 1;
+    beats[2] = 2;
+    beats[3] = 3;
+    beats[4] = 4;
+    beats[5] = 5;
+    beats[6] = 9;
+    expected_data[0] = 0;
+    expected_data[1] = 1;
+    expected_data[2] = 2;
+    expected_data[3] = 5;
+    expected_data[4] = 4;
+    expected_data[5] = 9;
+
+    repeat (4) @(posedge clk);
+    rst <= 1'b0;
+    repeat (64) @(posedge clk);
+
+    if (data_idx != AddrCount) begin
+      $display("expected %0d data, got %0d", AddrCount, data_idx);
+      errors = errors + 1;
+    end
+    if (beat_idx != BeatCount) begin
+      $display("expected %0d beats taken, got %0d", BeatCount, beat_idx);
+      errors = errors + 1;
+    end
+    if (errors == 0) begin
+      $display("PASS!");
+    end else begin
+      $display("FAIL: %0d errors", errors);
+      $fatal(1);
+    end
+    $finish;
+  end
+
+endmodule  // read_gather_tb
+
+`default_nettype wire
@@ -0,0 +1,640 @@
+#include "bank.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "clang/AST/AST.h"
+
+#include "buffer.h"
+#include "loop.h"
+
+using std::list;
+using std::map;
+using std::pair;
+using std::set;
+using std::string;
+using std::to_string;
+using std::vector;
+
+using clang::ArraySubscriptExpr;
+using clang::ASTContext;
+using clang::BinaryOperator;
+using clang::ClassTemplateSpecializationDecl;
+using clang::ConstantArrayType;
+using clang::CXXOperatorCallExpr;
+using clang::DeclRefExpr;
+using clang::Expr;
+using clang::ForStmt;
+using clang::Stmt;
+using clang::TapaPipelineAttr;
+using clang::TapaUnrollAttr;
+using clang::TemplateArgument;
+using clang::UnaryOperator;
+using clang::VarDecl;
+
+using llvm::dyn_cast;
+using llvm::dyn_cast_or_null;
+
+namespace tapa {
+namespace internal {
+
+namespace {
+
+using partition_t = BufferConfig::partition_t;
+using partition_type_t = BufferConfig::partition_type_t;
+
+// Upper bounds that keep the analysis cheap on large unroll factors.
+constexpr int64_t kMaxGroups = 16;
+constexpr int64_t kMaxInstances = 4096;
+constexpr int kMaxSuggestedFactor = 256;
+
+struct BankAccess {
+  vector<AffineExpr> indices;
+  bool is_write;
+};
+
+struct SectionAccesses {
+  string name;
+  // `GetBufferKey` of the section
+  string key;
+  vector<int> dims;
+  vector<partition_t> partitions;
+  // whether `partitions` are inferred from `array_partition<auto_partition>`
+  bool is_auto = false;
+  vector<BankAccess> accesses;
+};
+
+// Values of the unrolled loop variables in one unrolled copy of the body.
+using Instance = map<const VarDecl*, int64_t>;
+
+// Accesses to sections in the copies of the body of an analyzed loop that run
+// in the same iteration, for several consecutive iterations.
+struct LoopAccesses {
+  int target_ii = 1;
+  vector<vector<Instance>> groups;
+  vector<SectionAccesses> sections;
+};
+
+// Reads dims and partitions from the canonical template arguments of a
+// `tapa::section<T, n_sections, dims...>`.
+bool GetSectionLayout(const ClassTemplateSpecializationDecl* decl,
+                      vector<int>& dims, vector<partition_t>& partitions,
+                      bool& is_auto) {
+  const auto& args = decl->getTemplateArgs();
+  if (args.size() < 2 || args[0].getKind() != TemplateArgument::Type) {
+    return false;
+  }
+  auto array_type = dyn_cast<ConstantArrayType>(
+      args[0].getAsType().getCanonicalType().getTypePtr());
+  if (array_type == nullptr) return false;
+  clang::QualType base_type;
+  ParseDimensions(array_type, dims, base_type);
+  partitions.assign(dims.size(), partition_t(partition_type_t::NORMAL, 0));
+  if (args.size() < 3 || args[2].getKind() != TemplateArgument::Pack) {
+    return true;
+  }
+
+  auto get_spec = [](const TemplateArgument& arg) {
+    return arg.getKind() == TemplateArgument::Type
+               ? arg.getAsType()->getAsCXXRecordDecl()
+               : nullptr;
+  };
+  for (const auto& dim : args[2].pack_elements()) {
+    auto config = dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+        get_spec(dim));
+    if (config == nullptr || config->getNameAsString() != "array_partition" ||
+        config->getTemplateArgs().size() != 1 ||
+        config->getTemplateArgs()[0].getKind() != TemplateArgument::Pack) {
+      continue;
+    }
+    int i = 0;
+    for (const auto& arg : config->getTemplateArgs()[0].pack_elements()) {
+      auto partition = get_spec(arg);
+      if (partition == nullptr || i >= int(partitions.size())) return false;
+      const string name = partition->getNameAsString();
+      if (name == "auto_partition") {
+        is_auto = true;
+        auto inferred = GetInferredPartitions().find(GetBufferKey(decl));
+        if (inferred != GetInferredPartitions().end()) {
+          partitions = inferred->second;
+        }
+        break;
+      }
+      if (name == "complete") {
+        partitions[i] = partition_t(partition_type_t::COMPLETE, 0);
+      } else if (name == "cyclic" || name == "block") {
+        auto spec = dyn_cast<ClassTemplateSpecializationDecl>(partition);
+        if (spec == nullptr || spec->getTemplateArgs().size() != 1 ||
+            spec->getTemplateArgs()[0].getKind() !=
+                TemplateArgument::Integral) {
+          return false;
+        }
+        partitions[i] = partition_t(
+            name == "cyclic" ? partition_type_t::CYCLIC
+                             : partition_type_t::BLOCK,
+            spec->getTemplateArgs()[0].getAsIntegral().getSExtValue());
+      }
+      ++i;
+    }
+  }
+  return true;
+}
+
+// Returns the number of banks of a dimension of `extent` elements.
+int GetBankCount(const partition_t& partition, int extent) {
+  switch (partition.first) {
+    case partition_type_t::COMPLETE:
+      return extent;
+    case partition_type_t::CYCLIC:
+    case partition_type_t::BLOCK:
+      return std::max(1, std::min(partition.second, extent));
+    default:
+      return 1;
+  }
+}
+
+int GetBank(const partition_t& partition, int extent, int64_t index) {
+  const int banks = GetBankCount(partition, extent);
+  switch (partition.first) {
+    case partition_type_t::COMPLETE:
+    case partition_type_t::CYCLIC:
+      return index % banks;
+    case partition_type_t::BLOCK:
+      return index / ((extent + banks - 1) / banks);
+    default:
+      return 0;
+  }
+}
+
+int64_t Evaluate(const AffineExpr& expr, const Instance& instance) {
+  int64_t result = expr.constant;
+  for (const auto& coeff : expr.coeffs) {
+    auto value = instance.find(coeff.first);
+    // variables that are not unrolled are identical across all copies
+    if (value != instance.end()) result += coeff.second * value->second;
+  }
+  return result;
+}
+
+// Returns the maximum number of distinct accesses to any single bank in one
+// iteration of the analyzed loop.
+int GetMaxBankAccesses(const SectionAccesses& section,
+                       const vector<partition_t>& partitions,
+                       const vector<vector<Instance>>& groups) {
+  int result = 0;
+  for (const auto& group : groups) {
+    map<int, set<pair<int64_t, bool>>> bank_accesses;
+    for (const auto& instance : group) {
+      for (const auto& access : section.accesses) {
+        int bank = 0;
+        int64_t address = 0;
+        bool in_bounds = true;
+        for (size_t d = 0; d < section.dims.size(); ++d) {
+          const int extent = section.dims[d];
+          const int64_t index = Evaluate(access.indices[d], instance);
+          if (index < 0 || index >= extent) {
+            in_bounds = false;
+            break;
+          }
+          bank = bank * GetBankCount(partitions[d], extent) +
+                 GetBank(partitions[d], extent, index);
+          address = address * extent + index;
+        }
+        if (in_bounds) {
+          bank_accesses[bank].emplace(address, access.is_write);
+        }
+      }
+    }
+    for (const auto& bank : bank_accesses) {
+      result = std::max(result, int(bank.second.size()));
+    }
+  }
+  return result;
+}
+
+int GetII(int accesses) {
+  return std::max(1, (accesses + kPortsPerBank - 1) / kPortsPerBank);
+}
+
+class AccessCollector {
+ public:
+  AccessCollector(ASTContext& context, bool descend_into_loops)
+      : context_(context), descend_into_loops_(descend_into_loops) {}
+
+  void Collect(const Stmt* stmt, bool is_write = false) {
+    if (stmt == nullptr) return;
+    if (IsLoop(stmt) && !descend_into_loops_) return;
+    if (auto expr = dyn_cast<Expr>(stmt)) {
+      if (RecordAccess(expr, is_write)) return;
+    }
+    if (auto binary = dyn_cast<BinaryOperator>(stmt)) {
+      if (binary->isAssignmentOp()) {
+        Collect(binary->getLHS(), true);
+        if (binary->isCompoundAssignmentOp()) Collect(binary->getLHS());
+        Collect(binary->getRHS());
+        return;
+      }
+    }
+    if (auto unary = dyn_cast<UnaryOperator>(stmt)) {
+      if (unary->isIncrementDecrementOp()) {
+        Collect(unary->getSubExpr(), true);
+        Collect(unary->getSubExpr());
+        return;
+      }
+    }
+    if (auto call = dyn_cast<CXXOperatorCallExpr>(stmt)) {
+      if (call->isAssignmentOp() && call->getNumArgs() == 2) {
+        Collect(call->getArg(0), true);
+        Collect(call->getArg(1));
+        return;
+      }
+    }
+    for (auto child : stmt->children()) Collect(child);
+  }
+
+  vector<SectionAccesses>& sections() { return sections_; }
+
+ private:
+  // Records `view[i][j]...` if `view` is (a reference to) a `section()`.
+  bool RecordAccess(const Expr* expr, bool is_write) {
+    vector<const Expr*> indices;
+    const Expr* base = Strip(expr);
+    for (;;) {
+      if (auto subscript = dyn_cast<ArraySubscriptExpr>(base)) {
+        indices.push_back(subscript->getIdx());
+        base = Strip(subscript->getBase());
+      } else if (auto call = dyn_cast<CXXOperatorCallExpr>(base)) {
+        if (call->getOperator() != clang::OO_Subscript) break;
+        indices.push_back(call->getArg(1));
+        base = Strip(call->getArg(0));
+      } else {
+        break;
+      }
+    }
+    if (indices.empty()) return false;
+    std::reverse(indices.begin(), indices.end());
+
+    // `auto& view = section();` or `section()` itself
+    const clang::NamedDecl* view = nullptr;
+    if (auto ref = dyn_cast<DeclRefExpr>(base)) {
+      if (auto var = dyn_cast<VarDecl>(ref->getDecl())) {
+        if (var->hasInit()) {
+          view = var;
+          base = Strip(var->getInit());
+        }
+      }
+    }
+    auto call = dyn_cast<CXXOperatorCallExpr>(base);
+    if (call == nullptr || call->getOperator() != clang::OO_Call ||
+        !IsTapaType(call->getArg(0), "section")) {
+      return false;
+    }
+    const Expr* object = Strip(call->getArg(0));
+    auto object_ref = dyn_cast<DeclRefExpr>(object);
+    const clang::NamedDecl* key =
+        object_ref != nullptr ? object_ref->getDecl() : view;
+    if (key == nullptr) return false;
+
+    for (auto index : indices) Collect(index);
+
+    auto section = section_index_.find(key);
+    if (section == section_index_.end()) {
+      auto decl = dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+          object->getType()->getAsCXXRecordDecl());
+      SectionAccesses accesses;
+      accesses.name = key->getNameAsString();
+      if (decl == nullptr || !GetSectionLayout(decl, accesses.dims,
+                                               accesses.partitions,
+                                               accesses.is_auto)) {
+        return true;
+      }
+      accesses.key = GetBufferKey(decl);
+      section = section_index_.emplace(key, sections_.size()).first;
+      sections_.push_back(std::move(accesses));
+    }
+    auto& accesses = sections_[section->second];
+    if (indices.size() != accesses.dims.size()) return true;
+
+    BankAccess access{{}, is_write};
+    for (auto index : indices) {
+      access.indices.emplace_back();
+      if (!GetAffineExpr(index, context_, access.indices.back())) return true;
+    }
+    accesses.accesses.push_back(std::move(access));
+    return true;
+  }
+
+  ASTContext& context_;
+  const bool descend_into_loops_;
+  map<const clang::NamedDecl*, size_t> section_index_;
+  vector<SectionAccesses> sections_;
+};
+
+// Loops nested in a pipelined loop are fully unrolled.
+void GetNestedLoopVars(const Stmt* stmt, ASTContext& context,
+                       vector<LoopVar>& loop_vars, bool& ok) {
+  if (stmt == nullptr) return;
+  for (auto child : stmt->children()) {
+    if (child != nullptr && IsLoop(child)) {
+      LoopVar loop_var;
+      if (GetLoopVar(child, context, loop_var) && loop_var.trip_count >= 0) {
+        loop_vars.push_back(loop_var);
+      } else {
+        ok = false;
+      }
+    }
+    GetNestedLoopVars(child, context, loop_vars, ok);
+  }
+}
+
+// Collects the section accesses of a loop annotated with `[[tapa::pipeline]]`
+// and/or `[[tapa::unroll]]`. Sections that are not accessed, or whose indices
+// are offset by loops that are not unrolled, are skipped.
+bool CollectLoopAccesses(ASTContext& context, const Stmt* loop,
+                         llvm::ArrayRef<const clang::Attr*> attrs,
+                         LoopAccesses& result) {
+  bool is_pipelined = false;
+  int64_t unroll_factor = 1;
+  for (const auto* attr : attrs) {
+    if (auto pipeline = dyn_cast<TapaPipelineAttr>(attr)) {
+      is_pipelined = true;
+      result.target_ii = std::max(1, int(pipeline->getII()));
+    } else if (auto unroll = dyn_cast<TapaUnrollAttr>(attr)) {
+      // a factor of 0 means fully unrolled
+      unroll_factor = unroll->getFactor();
+    }
+  }
+
+  LoopVar loop_var;
+  if (!GetLoopVar(loop, context, loop_var)) return false;
+  if (unroll_factor == 0) unroll_factor = loop_var.trip_count;
+  if (unroll_factor <= 0) return false;
+
+  auto body = dyn_cast<ForStmt>(loop)->getBody();
+  vector<LoopVar> nested_loop_vars;
+  if (is_pipelined) {
+    bool ok = true;
+    GetNestedLoopVars(body, context, nested_loop_vars, ok);
+    if (!ok) return false;
+  }
+
+  AccessCollector collector(context, is_pipelined);
+  collector.Collect(body);
+  if (collector.sections().empty()) return false;
+
+  // Enumerate the copies of the loop body that run in the same iteration,
+  // for several consecutive iterations.
+  int64_t group_count = kMaxGroups;
+  if (loop_var.trip_count >= 0) {
+    group_count = std::min(
+        group_count, (loop_var.trip_count + unroll_factor - 1) / unroll_factor);
+  }
+  auto& groups = result.groups;
+  for (int64_t g = 0; g < group_count; ++g) {
+    vector<Instance> instances;
+    for (int64_t k = 0; k < unroll_factor; ++k) {
+      const int64_t i = g * unroll_factor + k;
+      if (loop_var.trip_count >= 0 && i >= loop_var.trip_count) break;
+      instances.push_back({{loop_var.var, loop_var.init + loop_var.step * i}});
+    }
+    for (const auto& nested : nested_loop_vars) {
+      vector<Instance> expanded;
+      for (const auto& instance : instances) {
+        for (int64_t i = 0; i < nested.trip_count; ++i) {
+          expanded.push_back(instance);
+          expanded.back()[nested.var] = nested.init + nested.step * i;
+        }
+      }
+      instances.swap(expanded);
+      if (int64_t(instances.size()) > kMaxInstances) return false;
+    }
+    groups.push_back(std::move(instances));
+  }
+  if (groups.empty()) return false;
+
+  for (auto& section : collector.sections()) {
+    if (section.accesses.empty()) continue;
+
+    // Variables that are not unrolled are assumed equal to 0, which only keeps
+    // bank assignment intact if all accesses are offset by them alike.
+    bool is_uniform = true;
+    for (const auto& access : section.accesses) {
+      for (size_t d = 0; d < section.dims.size(); ++d) {
+        auto offsets = [&](const AffineExpr& expr) {
+          map<const VarDecl*, int64_t> result;
+          for (const auto& coeff : expr.coeffs) {
+            if (groups.front().front().count(coeff.first) == 0 &&
+                coeff.second != 0) {
+              result.insert(coeff);
+            }
+          }
+          return result;
+        };
+        if (offsets(access.indices[d]) !=
+            offsets(section.accesses.front().indices[d])) {
+          is_uniform = false;
+        }
+      }
+    }
+    if (is_uniform) result.sections.push_back(std::move(section));
+  }
+  return !result.sections.empty();
+}
+
+// Collects the loops annotated with `[[tapa::pipeline]]` and/or
+// `[[tapa::unroll]]` in `stmt`.
+void GetAttributedLoops(const Stmt* stmt,
+                        vector<const clang::AttributedStmt*>& loops) {
+  if (stmt == nullptr) return;
+  if (auto attributed = dyn_cast<clang::AttributedStmt>(stmt)) {
+    for (const auto* attr : attributed->getAttrs()) {
+      if (llvm::isa<TapaPipelineAttr>(attr) ||
+          llvm::isa<TapaUnrollAttr>(attr)) {
+        loops.push_back(attributed);
+        break;
+      }
+    }
+  }
+  for (auto child : stmt->children()) GetAttributedLoops(child, loops);
+}
+
+// A section accessed in a loop, which must reach `target_ii` of the loop.
+struct PartitionConstraint {
+  const SectionAccesses* section;
+  const vector<vector<Instance>>* groups;
+  int target_ii;
+};
+
+// Returns by how many cycles `partitions` misses the target IIs in the worst
+// case; 0 if all target IIs are reached.
+int GetIIViolation(const vector<PartitionConstraint>& constraints,
+                   const vector<partition_t>& partitions) {
+  int result = 0;
+  for (const auto& constraint : constraints) {
+    const int ii = GetII(GetMaxBankAccesses(*constraint.section, partitions,
+                                            *constraint.groups));
+    result = std::max(result, ii - constraint.target_ii);
+  }
+  return result;
+}
+
+// Returns the partitions with the fewest banks that reach the target IIs of
+// all constraints, or those that miss them by the fewest cycles.
+//
+// Candidates partition a single dimension with `tapa::cyclic<F>` or
+// `tapa::block<F>`, or two dimensions with power-of-two cyclic factors, up to
+// `kMaxSuggestedFactor` banks in total. A factor equal to the extent is
+// `tapa::complete`. Cyclic is preferred over block for the same number of
+// banks.
+vector<partition_t> InferPartitions(
+    const vector<int>& dims, const vector<PartitionConstraint>& constraints) {
+  const vector<partition_t> normal(dims.size(),
+                                   partition_t(partition_type_t::NORMAL, 0));
+  auto partition = [&dims](size_t d, partition_type_t type, int factor) {
+    return factor >= dims[d] ? partition_t(partition_type_t::COMPLETE, 0)
+                             : partition_t(type, factor);
+  };
+
+  vector<pair<int, vector<partition_t>>> candidates;
+  for (size_t d = 0; d < dims.size(); ++d) {
+    const int max_factor = std::min(dims[d], kMaxSuggestedFactor);
+    for (int factor = 2; factor <= max_factor; ++factor) {
+      for (auto type : {partition_type_t::CYCLIC, partition_type_t::BLOCK}) {
+        candidates.emplace_back(factor, normal);
+        candidates.back().second[d] = partition(d, type, factor);
+        // both are `tapa::complete`
+        if (factor == dims[d]) break;
+      }
+    }
+  }
+  for (size_t d0 = 0; d0 < dims.size(); ++d0) {
+    for (size_t d1 = d0 + 1; d1 < dims.size(); ++d1) {
+      for (int f0 = 2; f0 <= dims[d0]; f0 *= 2) {
+        for (int f1 = 2; f1 <= dims[d1] && f0 * f1 <= kMaxSuggestedFactor;
+             f1 *= 2) {
+          candidates.emplace_back(f0 * f1, normal);
+          candidates.back().second[d0] =
+              partition(d0, partition_type_t::CYCLIC, f0);
+          candidates.back().second[d1] =
+              partition(d1, partition_type_t::CYCLIC, f1);
+        }
+      }
+    }
+  }
+  std::stable_sort(
+      candidates.begin(), candidates.end(),
+      [](const pair<int, vector<partition_t>>& lhs,
+         const pair<int, vector<partition_t>>& rhs) {
+        return lhs.first < rhs.first;
+      });
+
+  vector<partition_t> best = normal;
+  int best_violation = GetIIViolation(constraints, normal);
+  for (const auto& candidate : candidates) {
+    if (best_violation == 0) break;
+    const int violation = GetIIViolation(constraints, candidate.second);
+    if (violation < best_violation) {
+      best = candidate.second;
+      best_violation = violation;
+    }
+  }
+  return best;
+}
+
+}  // namespace
+
+void AnalyzeBankConflicts(ASTContext& context, const Stmt* loop,
+                          llvm::ArrayRef<const clang::Attr*> attrs) {
+  LoopAccesses loop_accesses;
+  if (!CollectLoopAccesses(context, loop, attrs, loop_accesses)) return;
+  const int target_ii = loop_accesses.target_ii;
+  const auto& groups = loop_accesses.groups;
+
+  auto& diagnostics = context.getDiagnostics();
+  static const auto conflict_diagnostic_id = diagnostics.getCustomDiagID(
+      clang::DiagnosticsEngine::Warning,
+      "%0 accesses per iteration to one bank of section '%1' exceed its %2 "
+      "ports; achievable II is %3 instead of %4");
+  static const auto suggestion_diagnostic_id = diagnostics.getCustomDiagID(
+      clang::DiagnosticsEngine::Note,
+      "partitioning dimension %0 of section '%1' with tapa::cyclic<%2> "
+      "reaches II=%3");
+
+  for (const auto& section : loop_accesses.sections) {
+    const int accesses =
+        GetMaxBankAccesses(section, section.partitions, groups);
+    const int achievable_ii = GetII(accesses);
+    if (achievable_ii <= target_ii) continue;
+
+    diagnostics.Report(loop->getBeginLoc(), conflict_diagnostic_id)
+        << to_string(accesses) << section.name << to_string(kPortsPerBank)
+        << to_string(achievable_ii) << to_string(target_ii);
+
+    // inferred partitions are already the best found
+    if (section.is_auto) continue;
+
+    // Look for the smallest cyclic factor on a single dimension that reaches
+    // the target II.
+    int best_dim = -1;
+    int best_factor = 0;
+    for (size_t d = 0; d < section.dims.size(); ++d) {
+      if (section.partitions[d].first == partition_type_t::COMPLETE) continue;
+      const int max_factor = std::min(section.dims[d], kMaxSuggestedFactor);
+      for (int factor = 2; factor <= max_factor; ++factor) {
+        if (best_dim >= 0 && factor >= best_factor) break;
+        auto partitions = section.partitions;
+        partitions[d] = partition_t(partition_type_t::CYCLIC, factor);
+        if (GetII(GetMaxBankAccesses(section, partitions, groups)) <=
+            target_ii) {
+          best_dim = d;
+          best_factor = factor;
+          break;
+        }
+      }
+    }
+    if (best_dim >= 0) {
+      diagnostics.Report(loop->getBeginLoc(), suggestion_diagnostic_id)
+          << to_string(best_dim + 1) << section.name << to_string(best_factor)
+          << to_string(target_ii);
+    }
+  }
+}
+
+void InferAutoPartitions(ASTContext& context,
+                         llvm::ArrayRef<const clang::FunctionDecl*> tasks) {
+  // `std::list` keeps the constraints pointing to the sections valid.
+  list<LoopAccesses> loops;
+  map<string, vector<int>> dims;
+  map<string, vector<PartitionConstraint>> constraints;
+  for (const auto* task : tasks) {
+    vector<const clang::AttributedStmt*> attributed_loops;
+    GetAttributedLoops(task->getBody(), attributed_loops);
+    for (const auto* loop : attributed_loops) {
+      loops.emplace_back();
+      if (!CollectLoopAccesses(context, loop->getSubStmt(), loop->getAttrs(),
+                               loops.back())) {
+        loops.pop_back();
+        continue;
+      }
+      for (const auto& section : loops.back().sections) {
+        if (!section.is_auto) continue;
+        dims[section.key] = section.dims;
+        constraints[section.key].push_back(
+            {&section, &loops.back().groups, loops.back().target_ii});
+      }
+    }
+  }
+  for (const auto& constraint : constraints) {
+    GetInferredPartitions()[constraint.first] =
+        InferPartitions(dims[constraint.first], constraint.second);
+  }
+}
+
+}  // namespace internal
+}  // namespace tapa
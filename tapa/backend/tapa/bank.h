@@ -0,0 +1,36 @@
+#ifndef TAPA_BANK_H_
+#define TAPA_BANK_H_
+
+#include "clang/AST/AST.h"
+
+namespace tapa {
+namespace internal {
+
+// Ports of a single BRAM or URAM bank; both are true dual-port.
+constexpr int kPortsPerBank = 2;
+
+// Analyzes accesses to `tapa::section` views in the body of a loop annotated
+// with `[[tapa::pipeline]]` and/or `[[tapa::unroll]]`. For every section whose
+// banks (as split by `array_partition`) are accessed more often per iteration
+// than they have ports, reports a warning with the achievable II, and a note
+// suggesting a `tapa::cyclic<F>` partition that reaches the target II if one
+// exists.
+//
+// Only `for` loops with a constant initial value and step are analyzed, and
+// only accesses whose indices are affine in the unrolled loop variables.
+void AnalyzeBankConflicts(clang::ASTContext& context, const clang::Stmt* loop,
+                          llvm::ArrayRef<const clang::Attr*> attrs);
+
+// Infers the partitions of buffers declared with
+// `array_partition<tapa::auto_partition>` from the loops of all `tasks` that
+// `AnalyzeBankConflicts` analyzes, so that the producer and the consumer of a
+// buffer both reach their target II. Buffers with the same layout share the
+// inferred partitions, which are the ones with the fewest banks. Must run
+// before any task is rewritten.
+void InferAutoPartitions(clang::ASTContext& context,
+                         llvm::ArrayRef<const clang::FunctionDecl*> tasks);
+
+}  // namespace internal
+}  // namespace tapa
+
+#endif  // TAPA_BANK_H_
@@ -7,6 +7,7 @@ using clang::QualType;
 using clang::Type;
 
 using llvm::dyn_cast;
+using llvm::dyn_cast_or_null;
 
 int64_t EvaluateConstantExpr(const clang::Expr *expression)
 {
@@ -114,8 +115,16 @@ json BufferConfig::toJson() {
   config["dims"] = dims;
   config["partitions"] = partitionInfo;
   config["n_sections"] = this->n_sections;
-  config["memcore_type"] =
-      (this->memcore == memcore_type_t::BRAM) ? "BRAM" : "URAM";
+  if (this->memcore == memcore_type_t::BRAM) {
+    config["memcore_type"] = "BRAM";
+  } else if (this->memcore == memcore_type_t::URAM) {
+    config["memcore_type"] = "URAM";
+  } else {
+    config["memcore_type"] = "AUTO";
+  }
+  config["watermark"] = this->watermark;
+  config["auto_partition"] = this->autoPartition;
+  config["ls_converted"] = this->lsConverted;
   return config;
 }
 
@@ -131,6 +140,8 @@ BufferConfig ParseBufferType(const clang::QualType& bufferType,
   std::vector<partition_t> partition_scheme;
   memcore_type_t memcore_type = memcore_type_t::BRAM;
   int arrayLength = 0;
+  bool watermark = false;
+  bool autoPartition = false;
 
   // TODO: This is qualififed type, should I strip it similar to
   // how GetStreamElemType works?
@@ -173,6 +184,12 @@ BufferConfig ParseBufferType(const clang::QualType& bufferType,
           configType->getAs<clang::TemplateSpecializationType>();
       if (!configTemplateSpecializationType) assert(1 == 0);
       const int numArgs = configTemplateSpecializationType->getNumArgs();
+      if (numArgs == 1 &&
+          GetRecordName(configTemplateSpecializationType->getArg(0)
+                            .getAsType()) == "auto_partition") {
+        autoPartition = true;
+        continue;
+      }
       for (int i = 0; i < numArgs; i++) {
         auto partitionSchemeType =
             configTemplateSpecializationType->getArg(i).getAsType();
@@ -209,8 +226,15 @@ BufferConfig ParseBufferType(const clang::QualType& bufferType,
       const int numArgs = configTemplateSpecializationType->getNumArgs();
       auto memoryCore = configTemplateSpecializationType->getArg(0).getAsType();
       std::string memoryCoreType = GetRecordName(memoryCore);
-      memcore_type = memoryCoreType == "uram" ? memcore_type_t::URAM
-                                              : memcore_type_t::BRAM;
+      if (memoryCoreType == "uram") {
+        memcore_type = memcore_type_t::URAM;
+      } else if (memoryCoreType == "auto_core") {
+        memcore_type = memcore_type_t::AUTO;
+      } else {
+        memcore_type = memcore_type_t::BRAM;
+      }
+    } else if (configName == "watermark") {
+      watermark = true;
     } else {
       break;
     }
@@ -218,9 +242,61 @@ BufferConfig ParseBufferType(const clang::QualType& bufferType,
 
   name = GetRecordName(baseType);
 
+  bool lsConverted = false;
+  const auto key = GetBufferKey(bufferType);
+  if (!key.empty()) {
+    auto inferred = GetInferredPartitions().find(key);
+    if (autoPartition && inferred != GetInferredPartitions().end()) {
+      partition_scheme = inferred->second;
+    }
+    if (n_sections == 2 && GetLsBufferKeys().count(key) > 0) {
+      n_sections = 1;
+      lsConverted = true;
+    }
+  }
+
   return BufferConfig{name,        baseType,         dims,
                       n_sections,  partition_scheme, memcore_type,
-                      isArrayType, arrayLength};
+                      isArrayType, arrayLength,      watermark,
+                      autoPartition, lsConverted};
+}
+
+std::string GetBufferKey(const ClassTemplateSpecializationDecl* decl) {
+  // skip `len` of `tapa::(i|o)?buffers`
+  const bool isArrayType = IsTapaType(decl, "(i|o)?buffers");
+  const auto& args = decl->getTemplateArgs();
+  std::string key;
+  llvm::raw_string_ostream oss{key};
+  for (unsigned i = 0; i < args.size(); ++i) {
+    if (isArrayType && i == 1) continue;
+    if (i > 0) oss << ", ";
+    args[i].print(clang::PrintingPolicy{clang::LangOptions{}}, oss);
+  }
+  return oss.str();
+}
+
+std::string GetBufferKey(const QualType& type) {
+  // `tapa::(i|o)buffers` are arrays of buffers in the HLS headers
+  const Type* elemType =
+      type.getNonReferenceType().getCanonicalType().getTypePtr();
+  while (const auto arrayType = elemType->getAsArrayTypeUnsafe()) {
+    elemType = arrayType->getElementType().getCanonicalType().getTypePtr();
+  }
+  const auto decl = dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+      elemType->getAsCXXRecordDecl());
+  return decl == nullptr ? "" : GetBufferKey(decl);
+}
+
+std::map<std::string, std::vector<BufferConfig::partition_t>>&
+GetInferredPartitions() {
+  static std::map<std::string, std::vector<BufferConfig::partition_t>>
+      inferred_partitions;
+  return inferred_partitions;
+}
+
+std::set<std::string>& GetLsBufferKeys() {
+  static std::set<std::string> ls_buffer_keys;
+  return ls_buffer_keys;
 }
 
 const ClassTemplateSpecializationDecl* GetTapaBufferDecl(const Type* type) {
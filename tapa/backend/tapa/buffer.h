@@ -2,6 +2,8 @@
 #define TAPA_BUFFER_H_
 
 #include <iostream>
+#include <map>
+#include <set>
 #include <string>
 
 #include "nlohmann/json.hpp"
@@ -20,6 +22,10 @@ inline std::string GetDataVar(const std::string& name) {
   return name + ".data";
 }
 
+inline std::string GetWatermarkVar(const std::string& name) {
+  return name + ".watermark";
+}
+
 template <typename T>
 inline bool IsBufferInterface(T obj) {
   return IsTapaType(obj, "(i|o)buffer");
@@ -42,7 +48,7 @@ std::string GetRecordName(const clang::QualType& qualType);
 struct BufferConfig {
   enum partition_type_t { NORMAL, COMPLETE, BLOCK, CYCLIC };
 
-  enum memcore_type_t { BRAM, URAM };
+  enum memcore_type_t { BRAM, URAM, AUTO };
 
   using partition_t = std::pair<partition_type_t, int>;
 
@@ -54,6 +60,14 @@ struct BufferConfig {
   memcore_type_t memcore;
   bool isArrayType = false;
   int length = 0;
+  // whether sections publish sub-tile progress through a watermark FIFO
+  bool watermark = false;
+  // whether `partition_config` is inferred, i.e., `array_partition` is
+  // `array_partition<auto_partition>`
+  bool autoPartition = false;
+  // whether the buffer had 2 sections and was converted to a 1-section LS
+  // buffer
+  bool lsConverted = false;
 
   BufferConfig() = default;
   json toJson();
@@ -65,6 +79,26 @@ void ParseDimensions(const clang::ConstantArrayType* constantArrayType,
 BufferConfig ParseBufferType(const clang::QualType& bufferType,
                              bool isArrayType = false);
 
+// Identifies the layout of a buffer, i.e., its element type, number of
+// sections, and dims, so that a buffer, its interfaces, and its sections
+// share the same key. Arrays of buffers, `tapa::(i|o)?buffers` or arrays of
+// `tapa::(i|o)?buffer`, share the key of their elements.
+std::string GetBufferKey(const clang::ClassTemplateSpecializationDecl* decl);
+
+// Returns the key of buffer or array of buffers `type`, or an empty string if
+// it is not a class template specialization or an array of them.
+std::string GetBufferKey(const clang::QualType& type);
+
+// Partitions inferred for `array_partition<auto_partition>`, by buffer key.
+// Filled before any task is rewritten and used by `ParseBufferType`; buffers
+// without an entry are not partitioned.
+std::map<std::string, std::vector<BufferConfig::partition_t>>&
+GetInferredPartitions();
+
+// Keys of the 2-section buffers that `ParseBufferType` reports with 1
+// section, as converted to LS buffers before any task is rewritten.
+std::set<std::string>& GetLsBufferKeys();
+
 const clang::ClassTemplateSpecializationDecl* GetTapaBufferDecl(
     const clang::Type* type);
 const clang::ClassTemplateSpecializationDecl* GetTapaBufferDecl(
@@ -0,0 +1,195 @@
+#include "loop.h"
+
+#include <cstdlib>
+#include <utility>
+
+#include "clang/AST/AST.h"
+
+using clang::ASTContext;
+using clang::BinaryOperator;
+using clang::DeclRefExpr;
+using clang::DeclStmt;
+using clang::Expr;
+using clang::ForStmt;
+using clang::Stmt;
+using clang::UnaryOperator;
+using clang::VarDecl;
+
+using llvm::dyn_cast;
+using llvm::dyn_cast_or_null;
+
+namespace tapa {
+namespace internal {
+
+const Expr* Strip(const Expr* expr) {
+  for (const Expr* prev = nullptr; expr != prev;) {
+    prev = expr;
+    expr = expr->IgnoreImplicit()->IgnoreParens();
+  }
+  return expr;
+}
+
+bool EvalConst(const Expr* expr, ASTContext& context, int64_t& value) {
+  clang::Expr::EvalResult result;
+  if (expr->isValueDependent() || !expr->EvaluateAsInt(result, context)) {
+    return false;
+  }
+  value = result.Val.getInt().getExtValue();
+  return true;
+}
+
+const VarDecl* GetVar(const Expr* expr) {
+  if (auto ref = dyn_cast<DeclRefExpr>(Strip(expr))) {
+    if (auto var = dyn_cast<VarDecl>(ref->getDecl())) {
+      return var->getCanonicalDecl();
+    }
+  }
+  return nullptr;
+}
+
+bool GetLoopVar(const Stmt* loop, ASTContext& context, LoopVar& result) {
+  auto for_stmt = dyn_cast_or_null<ForStmt>(loop);
+  if (for_stmt == nullptr) return false;
+
+  // init: `int i = c` or `i = c`
+  const Expr* init = nullptr;
+  if (auto decl_stmt = dyn_cast_or_null<DeclStmt>(for_stmt->getInit())) {
+    if (!decl_stmt->isSingleDecl()) return false;
+    if (auto var = dyn_cast<VarDecl>(decl_stmt->getSingleDecl())) {
+      result.var = var->getCanonicalDecl();
+      init = var->getInit();
+    }
+  } else if (auto binary =
+                 dyn_cast_or_null<BinaryOperator>(for_stmt->getInit())) {
+    if (binary->getOpcode() == clang::BO_Assign) {
+      result.var = GetVar(binary->getLHS());
+      init = binary->getRHS();
+    }
+  }
+  if (result.var == nullptr || init == nullptr ||
+      !EvalConst(init, context, result.init)) {
+    return false;
+  }
+
+  // increment: `++i`, `i++`, `--i`, `i--`, `i += c`, or `i -= c`
+  auto inc = for_stmt->getInc() ? Strip(for_stmt->getInc()) : nullptr;
+  if (auto unary = dyn_cast_or_null<UnaryOperator>(inc)) {
+    if (GetVar(unary->getSubExpr()) == result.var) {
+      if (unary->isIncrementOp()) result.step = 1;
+      if (unary->isDecrementOp()) result.step = -1;
+    }
+  } else if (auto binary = dyn_cast_or_null<BinaryOperator>(inc)) {
+    int64_t step;
+    if (GetVar(binary->getLHS()) == result.var &&
+        EvalConst(binary->getRHS(), context, step)) {
+      if (binary->getOpcode() == clang::BO_AddAssign) result.step = step;
+      if (binary->getOpcode() == clang::BO_SubAssign) result.step = -step;
+    }
+  }
+  if (result.step == 0) return false;
+
+  // condition: `i < c`, `i <= c`, `i > c`, `i >= c`, or `i != c`
+  auto cond = for_stmt->getCond() ? Strip(for_stmt->getCond()) : nullptr;
+  if (auto binary = dyn_cast_or_null<BinaryOperator>(cond)) {
+    int64_t bound;
+    if (GetVar(binary->getLHS()) == result.var &&
+        EvalConst(binary->getRHS(), context, bound)) {
+      bool is_bounded = true;
+      int64_t distance = 0;
+      switch (binary->getOpcode()) {
+        case clang::BO_LT:
+        case clang::BO_NE:
+        case clang::BO_GT:
+          distance = bound - result.init;
+          break;
+        case clang::BO_LE:
+          distance = bound + 1 - result.init;
+          break;
+        case clang::BO_GE:
+          distance = bound - 1 - result.init;
+          break;
+        default:
+          is_bounded = false;
+          break;
+      }
+      if (is_bounded) {
+        if (distance == 0 || (distance > 0) != (result.step > 0)) {
+          result.trip_count = 0;
+        } else {
+          const int64_t step = std::abs(result.step);
+          result.trip_count = (std::abs(distance) + step - 1) / step;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool IsLoop(const Stmt* stmt) {
+  return clang::isa<clang::DoStmt>(stmt) || clang::isa<ForStmt>(stmt) ||
+         clang::isa<clang::WhileStmt>(stmt) ||
+         clang::isa<clang::CXXForRangeStmt>(stmt);
+}
+
+bool ContainsLoop(const Stmt* stmt) {
+  for (auto child : stmt->children()) {
+    if (child != nullptr && (IsLoop(child) || ContainsLoop(child))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool GetAffineExpr(const Expr* expr, ASTContext& context, AffineExpr& result) {
+  expr = Strip(expr);
+  int64_t value;
+  if (EvalConst(expr, context, value)) {
+    result = {value, {}};
+    return true;
+  }
+  if (auto var = GetVar(expr)) {
+    result = {0, {{var, 1}}};
+    return true;
+  }
+  if (auto binary = dyn_cast<BinaryOperator>(expr)) {
+    AffineExpr lhs, rhs;
+    if (!GetAffineExpr(binary->getLHS(), context, lhs) ||
+        !GetAffineExpr(binary->getRHS(), context, rhs)) {
+      return false;
+    }
+    auto scale = [&result](const AffineExpr& expr, int64_t factor) {
+      result = expr;
+      result.constant *= factor;
+      for (auto& coeff : result.coeffs) coeff.second *= factor;
+    };
+    switch (binary->getOpcode()) {
+      case clang::BO_Add:
+      case clang::BO_Sub: {
+        const int64_t sign = binary->getOpcode() == clang::BO_Add ? 1 : -1;
+        result = lhs;
+        result.constant += sign * rhs.constant;
+        for (auto& coeff : rhs.coeffs) {
+          result.coeffs[coeff.first] += sign * coeff.second;
+        }
+        return true;
+      }
+      case clang::BO_Mul:
+        if (lhs.coeffs.empty()) std::swap(lhs, rhs);
+        if (!rhs.coeffs.empty()) return false;
+        scale(lhs, rhs.constant);
+        return true;
+      case clang::BO_Shl:
+        if (!rhs.coeffs.empty() || rhs.constant < 0 || rhs.constant > 62) {
+          return false;
+        }
+        scale(lhs, int64_t{1} << rhs.constant);
+        return true;
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+}  // namespace internal
+}  // namespace tapa
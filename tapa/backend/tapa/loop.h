@@ -0,0 +1,59 @@
+#ifndef TAPA_LOOP_H_
+#define TAPA_LOOP_H_
+
+#include <cstdint>
+#include <map>
+
+#include "clang/AST/AST.h"
+
+namespace tapa {
+namespace internal {
+
+// Estimated cycles to fill and drain the pipeline of a loop, which the next
+// loop waits for.
+constexpr int kLoopLatency = 8;
+
+// A `for` loop with `var` starting from `init` and advancing by `step`.
+struct LoopVar {
+  const clang::VarDecl* var = nullptr;
+  int64_t init = 0;
+  int64_t step = 0;
+  int64_t trip_count = -1;  // unknown
+};
+
+// Strips implicit casts, temporaries, and parentheses.
+const clang::Expr* Strip(const clang::Expr* expr);
+
+// Evaluates `expr` as an integer constant if possible.
+bool EvalConst(const clang::Expr* expr, clang::ASTContext& context,
+               int64_t& value);
+
+// Returns the canonical variable referenced by `expr`, or nullptr.
+const clang::VarDecl* GetVar(const clang::Expr* expr);
+
+// Returns true if `loop` is a `for` loop with a constant initial value and
+// step, and sets `result`; the trip count is also set if the bound is
+// constant.
+bool GetLoopVar(const clang::Stmt* loop, clang::ASTContext& context,
+                LoopVar& result);
+
+bool IsLoop(const clang::Stmt* stmt);
+
+// Returns true if any statement nested in `stmt` is a loop.
+bool ContainsLoop(const clang::Stmt* stmt);
+
+// `constant + sum(coeffs[var] * var)`
+struct AffineExpr {
+  int64_t constant = 0;
+  std::map<const clang::VarDecl*, int64_t> coeffs;
+};
+
+// Returns true if `expr` is affine in the variables it references, and sets
+// `result`.
+bool GetAffineExpr(const clang::Expr* expr, clang::ASTContext& context,
+                   AffineExpr& result);
+
+}  // namespace internal
+}  // namespace tapa
+
+#endif  // TAPA_LOOP_H_
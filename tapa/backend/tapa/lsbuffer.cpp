@@ -0,0 +1,362 @@
+#include "lsbuffer.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "clang/AST/AST.h"
+
+#include "nlohmann/json.hpp"
+
+#include "buffer.h"
+#include "loop.h"
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+using clang::ArraySubscriptExpr;
+using clang::ASTContext;
+using clang::AttributedStmt;
+using clang::CompoundStmt;
+using clang::CXXConstructExpr;
+using clang::CXXMemberCallExpr;
+using clang::CXXOperatorCallExpr;
+using clang::DeclRefExpr;
+using clang::DeclStmt;
+using clang::Expr;
+using clang::ForStmt;
+using clang::FunctionDecl;
+using clang::ParmVarDecl;
+using clang::SourceRange;
+using clang::Stmt;
+using clang::TapaPipelineAttr;
+using clang::TapaUnrollAttr;
+using clang::VarDecl;
+
+using llvm::dyn_cast;
+using llvm::dyn_cast_or_null;
+
+using nlohmann::json;
+
+namespace tapa {
+namespace internal {
+
+namespace {
+
+double EstimateCycles(const Stmt* stmt, ASTContext& context);
+
+double EstimateLoopCycles(const Stmt* loop,
+                          llvm::ArrayRef<const clang::Attr*> attrs,
+                          ASTContext& context) {
+  bool is_pipelined = false;
+  int target_ii = 1;
+  int64_t unroll_factor = 1;
+  for (const auto* attr : attrs) {
+    if (auto pipeline = dyn_cast<TapaPipelineAttr>(attr)) {
+      is_pipelined = true;
+      target_ii = std::max(1, int(pipeline->getII()));
+    } else if (auto unroll = dyn_cast<TapaUnrollAttr>(attr)) {
+      // a factor of 0 means fully unrolled
+      unroll_factor = unroll->getFactor();
+    }
+  }
+  LoopVar loop_var;
+  if (!GetLoopVar(loop, context, loop_var) || loop_var.trip_count < 0) {
+    return -1;
+  }
+  if (unroll_factor == 0) unroll_factor = loop_var.trip_count;
+  const int64_t iterations =
+      unroll_factor > 0
+          ? (loop_var.trip_count + unroll_factor - 1) / unroll_factor
+          : 0;
+
+  auto body = dyn_cast<ForStmt>(loop)->getBody();
+  if (is_pipelined || !ContainsLoop(body)) {
+    return kLoopLatency + double(iterations) * target_ii;
+  }
+  // the iterations of outer loops that are not pipelined do not overlap
+  const double body_cycles = EstimateCycles(body, context);
+  return body_cycles < 0 ? -1 : iterations * body_cycles;
+}
+
+// Returns the estimated cycles of `stmt`, or -1 if unknown. Statements other
+// than loops take no time.
+double EstimateCycles(const Stmt* stmt, ASTContext& context) {
+  if (stmt == nullptr) return 0;
+  if (auto attributed = dyn_cast<AttributedStmt>(stmt)) {
+    if (IsLoop(attributed->getSubStmt())) {
+      return EstimateLoopCycles(attributed->getSubStmt(),
+                                attributed->getAttrs(), context);
+    }
+  }
+  if (IsLoop(stmt)) return EstimateLoopCycles(stmt, {}, context);
+  double cycles = 0;
+  for (auto child : stmt->children()) {
+    const double child_cycles = EstimateCycles(child, context);
+    if (child_cycles < 0) return -1;
+    cycles += child_cycles;
+  }
+  return cycles;
+}
+
+// Returns the buffer parameter of `var` if it is `auto var = param.acquire();`.
+const ParmVarDecl* GetAcquiredParam(const VarDecl* var) {
+  if (var == nullptr || !var->hasInit()) return nullptr;
+  const Expr* init = Strip(var->getInit());
+  if (auto construct = dyn_cast<CXXConstructExpr>(init)) {
+    if (construct->getNumArgs() != 1) return nullptr;
+    init = Strip(construct->getArg(0));
+  }
+  auto call = dyn_cast<CXXMemberCallExpr>(init);
+  if (call == nullptr || call->getMethodDecl() == nullptr ||
+      call->getMethodDecl()->getNameAsString() != "acquire") {
+    return nullptr;
+  }
+  auto ref = dyn_cast<DeclRefExpr>(Strip(call->getImplicitObjectArgument()));
+  return ref == nullptr ? nullptr : dyn_cast<ParmVarDecl>(ref->getDecl());
+}
+
+class TileCollector {
+ public:
+  TileCollector(ASTContext& context, const FunctionDecl* func)
+      : context_(context) {
+    for (auto param : func->parameters()) {
+      if (IsBufferInterface(param)) {
+        auto& tile = tiles_[param];
+        const auto range = GetNSectionsRange(param);
+        tile.is_rewritable = range.isValid() && !range.getBegin().isMacroID();
+        dims_[param] = ParseBufferType(param->getType()).dims;
+      }
+    }
+  }
+
+  // Looks for the first section acquired from each buffer parameter in
+  // `stmt`, which runs once per iteration of a tile loop with `tile_body`.
+  void Collect(const Stmt* stmt, const Stmt* tile_body) {
+    if (stmt == nullptr) return;
+    if (auto loop = dyn_cast<ForStmt>(stmt)) {
+      tile_body = loop->getBody();
+    } else if (IsLoop(stmt)) {
+      // other loops have no trip count
+      tile_body = nullptr;
+    }
+    if (auto compound = dyn_cast<CompoundStmt>(stmt)) {
+      for (auto it = compound->body_begin(); it != compound->body_end(); ++it) {
+        auto decl_stmt = dyn_cast<DeclStmt>(*it);
+        if (decl_stmt == nullptr || !decl_stmt->isSingleDecl()) continue;
+        auto var = dyn_cast<VarDecl>(decl_stmt->getSingleDecl());
+        auto tile = tiles_.find(GetAcquiredParam(var));
+        if (tile == tiles_.end() || found_.count(tile->first) > 0) continue;
+        found_.insert(tile->first);
+        RecordTile(tile->second, dims_[tile->first], var, it,
+                   compound->body_end(), tile_body);
+      }
+    }
+    for (auto child : stmt->children()) Collect(child, tile_body);
+  }
+
+  map<string, BufferTile> tiles() const {
+    map<string, BufferTile> result;
+    for (const auto& tile : tiles_) {
+      result[tile.first->getNameAsString()] = tile.second;
+    }
+    return result;
+  }
+
+ private:
+  // The section is held from its declaration to the end of the block.
+  void RecordTile(BufferTile& tile, const vector<int>& dims,
+                  const VarDecl* section, CompoundStmt::const_body_iterator it,
+                  CompoundStmt::const_body_iterator end,
+                  const Stmt* tile_body) {
+    tile.hold = 0;
+    for (auto stmt = it; stmt != end; ++stmt) {
+      const double cycles = EstimateCycles(*stmt, context_);
+      if (cycles < 0) {
+        tile.hold = -1;
+        break;
+      }
+      tile.hold += cycles;
+    }
+    if (tile_body != nullptr) {
+      tile.interval = EstimateCycles(tile_body, context_);
+    }
+    if (tile.hold >= 0 && tile.interval >= 0) {
+      // a tile takes at least one cycle
+      tile.hold = std::max(tile.hold, 1.);
+      tile.interval = std::max(tile.interval, tile.hold);
+    }
+
+    vector<const VarDecl*> loop_vars;
+    for (auto stmt = it; stmt != end && tile.order.empty(); ++stmt) {
+      FindOrder(*stmt, section->getCanonicalDecl(), dims, loop_vars,
+                tile.order);
+    }
+  }
+
+  // Sets `order` from the first access `view[i][j]...` of `section`, where
+  // `view` is `section()` or a variable initialized with it.
+  void FindOrder(const Stmt* stmt, const VarDecl* section,
+                 const vector<int>& dims, vector<const VarDecl*>& loop_vars,
+                 vector<int64_t>& order) {
+    if (stmt == nullptr || !order.empty()) return;
+    if (IsLoop(stmt)) {
+      LoopVar loop_var;
+      GetLoopVar(stmt, context_, loop_var);
+      loop_vars.push_back(loop_var.var);
+      for (auto child : stmt->children()) {
+        FindOrder(child, section, dims, loop_vars, order);
+      }
+      loop_vars.pop_back();
+      return;
+    }
+    if (auto expr = dyn_cast<Expr>(stmt)) {
+      vector<const Expr*> indices;
+      const Expr* base = Strip(expr);
+      for (;;) {
+        if (auto subscript = dyn_cast<ArraySubscriptExpr>(base)) {
+          indices.push_back(subscript->getIdx());
+          base = Strip(subscript->getBase());
+        } else if (auto call = dyn_cast<CXXOperatorCallExpr>(base)) {
+          if (call->getOperator() != clang::OO_Subscript) break;
+          indices.push_back(call->getArg(1));
+          base = Strip(call->getArg(0));
+        } else {
+          break;
+        }
+      }
+      if (!indices.empty() && indices.size() == dims.size() &&
+          IsSectionView(base, section)) {
+        std::reverse(indices.begin(), indices.end());
+        AffineExpr address;
+        int64_t stride = 1;
+        for (size_t d = dims.size(); d-- > 0;) {
+          AffineExpr index;
+          if (!GetAffineExpr(indices[d], context_, index)) return;
+          for (const auto& coeff : index.coeffs) {
+            address.coeffs[coeff.first] += coeff.second * stride;
+          }
+          stride *= dims[d];
+        }
+        for (auto var : loop_vars) {
+          auto coeff = address.coeffs.find(var);
+          order.push_back(coeff == address.coeffs.end() ? 0 : coeff->second);
+        }
+        // accesses outside of loops are in the same order anyway
+        if (order.empty()) order.push_back(0);
+        return;
+      }
+    }
+    for (auto child : stmt->children()) {
+      FindOrder(child, section, dims, loop_vars, order);
+    }
+  }
+
+  static bool IsSectionView(const Expr* expr, const VarDecl* section) {
+    if (auto ref = dyn_cast<DeclRefExpr>(expr)) {
+      auto var = dyn_cast<VarDecl>(ref->getDecl());
+      if (var == nullptr || !var->hasInit()) return false;
+      expr = Strip(var->getInit());
+    }
+    auto call = dyn_cast<CXXOperatorCallExpr>(expr);
+    if (call == nullptr || call->getOperator() != clang::OO_Call) return false;
+    auto ref = dyn_cast<DeclRefExpr>(Strip(call->getArg(0)));
+    return ref != nullptr && ref->getDecl()->getCanonicalDecl() == section;
+  }
+
+  ASTContext& context_;
+  map<const ParmVarDecl*, BufferTile> tiles_;
+  map<const ParmVarDecl*, vector<int>> dims_;
+  set<const ParmVarDecl*> found_;
+};
+
+}  // namespace
+
+json BufferTile::ToJson() const {
+  return {{"hold", hold}, {"interval", interval}, {"order", order}};
+}
+
+map<string, BufferTile> AnalyzeBufferTiles(ASTContext& context,
+                                           const FunctionDecl* func) {
+  TileCollector collector(context, func);
+  collector.Collect(func->getBody(), func->getBody());
+  return collector.tiles();
+}
+
+bool IsLsBufferEligible(const BufferTile& producer,
+                        const BufferTile& consumer) {
+  if (producer.hold < 0 || producer.interval < 0 || consumer.hold < 0 ||
+      consumer.interval < 0) {
+    return false;
+  }
+  return producer.hold + consumer.hold <=
+         std::max(producer.interval, consumer.interval);
+}
+
+map<string, map<string, BufferTile>>& GetBufferTiles() {
+  static map<string, map<string, BufferTile>> buffer_tiles;
+  return buffer_tiles;
+}
+
+void SelectLsBuffers(ASTContext& context,
+                     llvm::ArrayRef<const FunctionDecl*> tasks, bool convert) {
+  map<string, vector<const BufferTile*>> producers;
+  map<string, vector<const BufferTile*>> consumers;
+  set<string> kept;
+  for (const auto* task : tasks) {
+    auto& tiles = GetBufferTiles()[task->getNameAsString()];
+    tiles = AnalyzeBufferTiles(context, task);
+    for (const auto param : task->parameters()) {
+      if (auto decl = GetTapaBuffersDecl(param->getType())) {
+        kept.insert(GetBufferKey(decl));
+        continue;
+      }
+      auto decl = GetTapaBufferDecl(param->getType());
+      if (decl == nullptr || !IsBufferInterface(param)) continue;
+      const string key = GetBufferKey(decl);
+      const auto config = ParseBufferType(param->getType());
+      const auto& tile = tiles[param->getNameAsString()];
+      if (config.n_sections != 2 || config.watermark || !tile.is_rewritable) {
+        kept.insert(key);
+      }
+      (IsTapaType(param, "obuffer") ? producers : consumers)[key].push_back(
+          &tile);
+    }
+  }
+  if (!convert) return;
+
+  for (const auto& producer : producers) {
+    const string& key = producer.first;
+    auto consumer = consumers.find(key);
+    if (kept.count(key) > 0 || consumer == consumers.end()) continue;
+    bool is_eligible = true;
+    for (auto producer_tile : producer.second) {
+      for (auto consumer_tile : consumer->second) {
+        is_eligible &= IsLsBufferEligible(*producer_tile, *consumer_tile);
+      }
+    }
+    if (is_eligible) GetLsBufferKeys().insert(key);
+  }
+}
+
+SourceRange GetNSectionsRange(const ParmVarDecl* param) {
+  if (param->getTypeSourceInfo() == nullptr) return {};
+  auto loc = param->getTypeSourceInfo()->getTypeLoc();
+  if (auto ref = loc.getAs<clang::ReferenceTypeLoc>()) {
+    loc = ref.getPointeeLoc();
+  }
+  loc = loc.getUnqualifiedLoc();
+  if (auto elaborated = loc.getAs<clang::ElaboratedTypeLoc>()) {
+    loc = elaborated.getNamedTypeLoc();
+  }
+  auto spec = loc.getAs<clang::TemplateSpecializationTypeLoc>();
+  if (!spec || spec.getNumArgs() < 2) return {};
+  return spec.getArgLoc(1).getSourceRange();
+}
+
+}  // namespace internal
+}  // namespace tapa
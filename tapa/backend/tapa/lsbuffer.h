@@ -0,0 +1,65 @@
+#ifndef TAPA_LSBUFFER_H_
+#define TAPA_LSBUFFER_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "clang/AST/AST.h"
+
+#include "nlohmann/json.hpp"
+
+namespace tapa {
+namespace internal {
+
+// How a lower-level task uses the sections of a buffer parameter.
+struct BufferTile {
+  // estimated cycles from acquiring a section until it is released, and
+  // between acquiring consecutive sections; -1 if unknown
+  double hold = -1;
+  double interval = -1;
+  // strides of the address of the first access to the section in the loops
+  // around it, from the outermost; empty if unknown
+  std::vector<int64_t> order;
+  // whether `n_sections` is spelled in the type of the parameter
+  bool is_rewritable = false;
+
+  nlohmann::json ToJson() const;
+};
+
+// Analyzes the `(i|o)buffer` parameters of a lower-level task. Sections are
+// expected to be acquired as `auto section = buffer.acquire();` and held
+// until the end of the enclosing block; cycles are estimated as in
+// `AnalyzeThroughput`, i.e., loops run one after another and innermost or
+// `[[tapa::pipeline]]` loops are pipelined at their target II.
+std::map<std::string, BufferTile> AnalyzeBufferTiles(
+    clang::ASTContext& context, const clang::FunctionDecl* func);
+
+// A buffer with one section serves its producer and its consumer in turns,
+// and still keeps up with the ping-pong buffer if both hold it for no longer
+// than the slower of them takes per section.
+bool IsLsBufferEligible(const BufferTile& producer,
+                        const BufferTile& consumer);
+
+// Tiles of the buffer parameters of all lower-level tasks, by task and
+// parameter name.
+std::map<std::string, std::map<std::string, BufferTile>>& GetBufferTiles();
+
+// Analyzes the buffer parameters of all `tasks` and, if `convert` is set,
+// converts 2-section buffers to 1-section LS buffers wherever every producer
+// and consumer of the buffer layout is eligible. Layouts used by arrays of
+// buffers or with `tapa::watermark` are kept. Must run before any task is
+// rewritten.
+void SelectLsBuffers(clang::ASTContext& context,
+                     llvm::ArrayRef<const clang::FunctionDecl*> tasks,
+                     bool convert);
+
+// Returns the `n_sections` template argument as spelled in the type of
+// `param`, or an invalid range if it is not, e.g., spelled via an alias.
+clang::SourceRange GetNSectionsRange(const clang::ParmVarDecl* param);
+
+}  // namespace internal
+}  // namespace tapa
+
+#endif  // TAPA_LSBUFFER_H_
@@ -6,9 +6,12 @@
 
 #include "type.h"
 
+using std::pair;
 using std::string;
 
+using clang::ClassTemplateSpecializationDecl;
 using clang::ParmVarDecl;
+using clang::TemplateArgument;
 
 string GetMmapElemType(const ParmVarDecl* param) {
   if (IsTapaType(param, "(async_)?mmaps?")) {
@@ -18,3 +21,30 @@ string GetMmapElemType(const ParmVarDecl* param) {
   }
   return "";
 }
+
+pair<int, int> GetAccessPattern(const ParmVarDecl* param) {
+  auto mmap = llvm::dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+      param->getType().getNonReferenceType()->getAsRecordDecl());
+  if (mmap == nullptr || mmap->getTemplateArgs().size() < 2 ||
+      mmap->getTemplateArgs()[1].getKind() != TemplateArgument::Type) {
+    return {0, 0};
+  }
+  auto pattern = llvm::dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+      mmap->getTemplateArgs()[1].getAsType()->getAsRecordDecl());
+  if (pattern == nullptr || pattern->getTemplateArgs().size() != 2) {
+    return {0, 0};
+  }
+  const auto& args = pattern->getTemplateArgs();
+  if (args[0].getKind() != TemplateArgument::Integral ||
+      args[1].getKind() != TemplateArgument::Integral) {
+    auto& diagnostics = param->getASTContext().getDiagnostics();
+    static const auto diagnostic_id = diagnostics.getCustomDiagID(
+        clang::DiagnosticsEngine::Error,
+        "access pattern of mmap '%0' must be an integer constant");
+    diagnostics.Report(param->getBeginLoc(), diagnostic_id)
+        << param->getName();
+    return {0, 0};
+  }
+  return {int(args[0].getAsIntegral().getSExtValue()),
+          int(args[1].getAsIntegral().getSExtValue())};
+}
@@ -2,6 +2,7 @@
 #define TAPA_MMAP_H_
 
 #include <string>
+#include <utility>
 
 #include "clang/AST/AST.h"
 
@@ -10,4 +11,9 @@
 // Works for both mmap and async_mmap.
 std::string GetMmapElemType(const clang::ParmVarDecl* param);
 
+// Returns the max_gap and cache_depth of the `tapa::access_pattern` of an
+// async_mmap, or {0, 0} by default. Reports an error and returns {0, 0} if
+// the arguments of the pattern are not integer constants.
+std::pair<int, int> GetAccessPattern(const clang::ParmVarDecl* param);
+
 #endif  // TAPA_MMAP_H_
@@ -1,6 +1,8 @@
 #ifndef TAPA_STREAM_H_
 #define TAPA_STREAM_H_
 
+#include <cstdint>
+
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -11,6 +13,9 @@
 
 #include "type.h"
 
+// Depth of a `tapa::stream` declared without one, as `kStreamDefaultDepth`.
+constexpr uint64_t kDefaultFifoDepth = 2;
+
 inline std::string GetPeekVar(const std::string& name) {
   return name + "._peek";
 }
@@ -11,9 +11,12 @@
 
 #include "nlohmann/json.hpp"
 
+#include "bank.h"
 #include "buffer.h"
+#include "lsbuffer.h"
 #include "mmap.h"
 #include "stream.h"
+#include "throughput.h"
 
 using std::initializer_list;
 using std::string;
@@ -22,6 +25,7 @@ using std::unordered_map;
 using std::vector;
 
 using clang::CharSourceRange;
+using clang::ClassTemplateSpecializationDecl;
 using clang::CXXBindTemporaryExpr;
 using clang::CXXMemberCallExpr;
 using clang::CXXMethodDecl;
@@ -183,6 +187,7 @@ bool Visitor::VisitFunctionDecl(FunctionDecl* func) {
 bool Visitor::VisitAttributedStmt(clang::AttributedStmt* stmt) {
   if (current_task && rewriting_func == current_task &&
       rewriters_.count(current_task) > 0) {
+    AnalyzeBankConflicts(context_, stmt->getSubStmt(), stmt->getAttrs());
     HandleAttrOnNodeWithBody(stmt, GetLoopBody(stmt->getSubStmt()),
                              stmt->getAttrs());
   }
@@ -259,6 +264,17 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
   }
 
   // Process stream declarations.
+  // A depth of 0 is `tapa::auto_depth`, inferred by tapac from the task graph;
+  // the default depth is used until then.
+  auto set_fifo_depth = [&](const string& name, uint64_t depth) {
+    auto& fifo = metadata["fifos"][name];
+    if (depth == 0) {
+      fifo["depth"] = kDefaultFifoDepth;
+      fifo["auto_depth"] = true;
+    } else {
+      fifo["depth"] = depth;
+    }
+  };
   unordered_map<string, const VarDecl*> fifo_decls;
   unordered_map<string, const VarDecl*> buffer_decls;
   for (const auto child : func->getBody()->children()) {
@@ -269,7 +285,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
           const string elem_type = GetTemplateArgName(args[0]);
           const uint64_t fifo_depth{*args[1].getAsIntegral().getRawData()};
           const string var_name{var_decl->getNameAsString()};
-          metadata["fifos"][var_name]["depth"] = fifo_depth;
+          set_fifo_depth(var_name, fifo_depth);
           fifo_decls[var_name] = var_decl;
         } else if (auto decl = GetTapaStreamsDecl(var_decl->getType())) {
           const auto args = decl->getTemplateArgs().asArray();
@@ -277,7 +293,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
           const uint64_t fifo_depth = *args[2].getAsIntegral().getRawData();
           for (int i = 0; i < GetArraySize(decl); ++i) {
             const string var_name = ArrayNameAt(var_decl->getNameAsString(), i);
-            metadata["fifos"][var_name]["depth"] = fifo_depth;
+            set_fifo_depth(var_name, fifo_depth);
             fifo_decls[var_name] = var_decl;
           }
         } else if (auto decl = GetTapaBufferDecl(var_decl->getType())) {
@@ -326,11 +342,23 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
     int step = -1;
     bool has_name = false;
     uint64_t vec_length = 1;
+    int64_t replicate = 0;  // not replicated
     if (const auto method = dyn_cast<CXXMethodDecl>(invoke->getCalleeDecl())) {
       auto args = method->getTemplateSpecializationArgs()->asArray();
+      const ClassTemplateSpecializationDecl* replicated = nullptr;
+      if (args.size() > 0 && args[0].getKind() == TemplateArgument::Type &&
+          IsTapaType(args[0].getAsType(), "replicated")) {
+        replicated = dyn_cast<ClassTemplateSpecializationDecl>(
+            args[0].getAsType()->getAsRecordDecl());
+      }
       if (args.size() > 0 && args[0].getKind() == TemplateArgument::Integral) {
         step =
             *reinterpret_cast<const int*>(args[0].getAsIntegral().getRawData());
+      } else if (replicated != nullptr) {
+        // invoke<tapa::replicated<n, mode>>; expanded by tapac
+        const auto& replicated_args = replicated->getTemplateArgs();
+        replicate = replicated_args[0].getAsIntegral().getExtValue();
+        step = replicated_args[1].getAsIntegral().getExtValue();
       } else {
         step = 0;  // default to join
       }
@@ -428,6 +456,11 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
             task_name = arg_name;
             metadata["tasks"][task_name].push_back({{"step", step}});
             task = decl_ref->getDecl()->getAsFunction();
+            if (replicate > 0) {
+              (*metadata["tasks"][task_name].rbegin())["replicate"] =
+                  replicate;
+              CheckReplicatedTask(task, arg);
+            }
           } else {
             assert(task != nullptr);
             auto param = task->getParamDecl(has_name ? i - 2 : i - 1);
@@ -443,6 +476,16 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
                   {"cat", param_cat}, {"arg", arg}};
             };
 
+            // tapac generates the distributor and collector of replicated
+            // tasks from the element type of their streams
+            auto register_replicated_stream = [&] {
+              auto& port = (*metadata["tasks"][task_name].rbegin())["args"]
+                                                                   [param_name];
+              port["type"] = GetStreamElemType(param);
+              port["width"] = GetTypeWidth(
+                  GetTemplateArg(param->getType(), 0)->getAsType());
+            };
+
             // regsiter stream info to task
             auto register_fifo_consumer = [&, ast_arg = arg](string arg = "") {
               // use global arg_name by default
@@ -530,6 +573,12 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
               // vector invocation can map mmaps to async_mmap
               register_arg(
                   get_name(arg_name, mmaps_access_pos[arg_name]++, decl_ref));
+              const auto [max_gap, cache_depth] = GetAccessPattern(param);
+              if (max_gap != 0 || cache_depth != 0) {
+                (*metadata["tasks"][task_name].rbegin())["args"][param_name]
+                    ["access_pattern"] = {{"max_gap", max_gap},
+                                          {"cache_depth", cache_depth}};
+              }
             } else if (IsTapaType(param, "istream")) {
               param_cat = "istream";
               // vector invocation can map istreams to istream
@@ -537,6 +586,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
                   get_name(arg_name, istreams_access_pos[arg_name]++, decl_ref);
               register_fifo_consumer(arg);
               register_arg(arg);
+              if (replicate > 0) register_replicated_stream();
             } else if (IsTapaType(param, "ostream")) {
               param_cat = "ostream";
               // vector invocation can map ostreams to ostream
@@ -544,6 +594,7 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
                   get_name(arg_name, ostreams_access_pos[arg_name]++, decl_ref);
               register_fifo_producer(arg);
               register_arg(arg);
+              if (replicate > 0) register_replicated_stream();
             } else if (IsTapaType(param, "istreams")) {
               param_cat = "istream";
               for (int i = 0; i < GetArraySize(param); ++i) {
@@ -710,10 +761,93 @@ void Visitor::ProcessUpperLevelTask(const ExprWithCleanups* task,
       }
     }
   }
+
+  // Compare the tiles of the producer and the consumer of each buffer, for
+  // tapac to report the buffers that can be LS buffers.
+  for (auto buffer = metadata["buffers"].begin();
+       buffer != metadata["buffers"].end(); ++buffer) {
+    auto get_tile = [&](const char* end) -> const BufferTile* {
+      if (!buffer.value().contains(end)) return nullptr;
+      const string task_name = buffer.value()[end][0];
+      const int idx = buffer.value()[end][1];
+      auto tiles = GetBufferTiles().find(task_name);
+      if (tiles == GetBufferTiles().end()) return nullptr;
+      auto& args = metadata["tasks"][task_name][idx]["args"];
+      for (const auto& arg : args.items()) {
+        if (arg.value()["arg"] == buffer.key()) {
+          auto tile = tiles->second.find(arg.key());
+          return tile == tiles->second.end() ? nullptr : &tile->second;
+        }
+      }
+      return nullptr;
+    };
+    auto producer = get_tile("produced_by");
+    auto consumer = get_tile("consumed_by");
+    if (producer == nullptr || consumer == nullptr) continue;
+    buffer.value()["ls_buffer"] = {
+        {"producer", producer->ToJson()},
+        {"consumer", consumer->ToJson()},
+        {"same_order",
+         !producer->order.empty() && producer->order == consumer->order},
+        {"eligible", IsLsBufferEligible(*producer, *consumer)},
+    };
+  }
+}
+
+// Reports an error unless `task` can be replicated by tapac, i.e., it has
+// exactly one istream and one ostream, and only scalars otherwise.
+void Visitor::CheckReplicatedTask(const FunctionDecl* task,
+                                  const Expr* invocation) {
+  int istream_count = 0;
+  int ostream_count = 0;
+  bool is_scalar_otherwise = true;
+  for (const auto param : task->parameters()) {
+    if (IsTapaType(param, "istream")) {
+      ++istream_count;
+    } else if (IsTapaType(param, "ostream")) {
+      ++ostream_count;
+    } else if (IsTapaType(param,
+                          "((async_)?mmaps?|(i|o)streams|(i|o)buffers?)")) {
+      is_scalar_otherwise = false;
+    }
+  }
+  if (istream_count != 1 || ostream_count != 1 || !is_scalar_otherwise) {
+    static const auto diagnostic_id =
+        this->context_.getDiagnostics().getCustomDiagID(
+            clang::DiagnosticsEngine::Error,
+            "replicated task '%0' must have exactly one istream and one "
+            "ostream, and only scalars otherwise");
+    this->context_.getDiagnostics()
+        .Report(invocation->getBeginLoc(), diagnostic_id)
+        .AddString(task->getNameAsString());
+  }
 }
 
 // Apply tapa s2s transformations on a lower-level task.
 void Visitor::ProcessLowerLevelTask(const FunctionDecl* func) {
+  auto& metadata = GetMetadata();
+  metadata["throughput"] = AnalyzeThroughput(context_, func);
+
+  // tapac redefines fused tasks from their parameters and rewritten bodies
+  metadata["params"] = json::array();
+  for (const auto param : func->parameters()) {
+    json param_meta = {{"name", param->getNameAsString()},
+                       {"type", param->getType().getAsString()}};
+    if (IsTapaType(param, "(i|o)stream")) {
+      param_meta["elem_type"] = GetStreamElemType(param);
+      param_meta["width"] = GetTypeWidth(
+          GetTemplateArg(param->getType(), 0)->getAsType());
+    }
+    metadata["params"].push_back(param_meta);
+
+    // buffers converted to LS buffers have a single section in hardware
+    if (IsBufferInterface(param)) {
+      auto decl = GetTapaBufferDecl(param->getType());
+      if (decl != nullptr && GetLsBufferKeys().count(GetBufferKey(decl)) > 0) {
+        GetRewriter().ReplaceText(GetNSectionsRange(param), "1");
+      }
+    }
+  }
   current_target->RewriteLowerLevelFunc(func, GetRewriter());
 }
 
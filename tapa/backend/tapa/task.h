@@ -64,6 +64,8 @@ class Visitor : public clang::RecursiveASTVisitor<Visitor> {
                              const clang::FunctionDecl* func);
 
   void ProcessLowerLevelTask(const clang::FunctionDecl* func);
+  void CheckReplicatedTask(const clang::FunctionDecl* task,
+                           const clang::Expr* invocation);
   std::string GetFrtInterface(const clang::FunctionDecl* func);
 
   clang::CharSourceRange GetCharSourceRange(const clang::Stmt* stmt);
@@ -0,0 +1,621 @@
+#include "throughput.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "clang/AST/AST.h"
+
+#include "nlohmann/json.hpp"
+
+#include "loop.h"
+#include "stream.h"
+
+using std::deque;
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+using clang::AbstractConditionalOperator;
+using clang::ASTContext;
+using clang::AttributedStmt;
+using clang::BinaryOperator;
+using clang::ConditionalOperator;
+using clang::CXXMemberCallExpr;
+using clang::CXXOperatorCallExpr;
+using clang::DeclRefExpr;
+using clang::Expr;
+using clang::FunctionDecl;
+using clang::IfStmt;
+using clang::ParmVarDecl;
+using clang::Stmt;
+using clang::SwitchStmt;
+using clang::TapaPipelineAttr;
+using clang::TapaUnrollAttr;
+
+using llvm::dyn_cast;
+
+using nlohmann::json;
+
+namespace tapa {
+namespace internal {
+
+namespace {
+
+// Methods that transfer one token through a FIFO port; `open` and `close`
+// transfer the end-of-transaction token.
+bool IsTransfer(const string& name) {
+  return name == "read" || name == "try_read" || name == "open" ||
+         name == "try_open" || name == "write" || name == "try_write" ||
+         name == "close" || name == "try_close";
+}
+
+// Methods that transfer the end-of-transaction token around the tokens of a
+// transaction.
+bool IsFraming(const string& name) { return name == "open" || name == "close"; }
+
+// Methods that read whether the next token ends a transaction.
+bool IsEot(const string& name) { return name == "eot" || name == "try_eot"; }
+
+// Methods that read a token without removing it from a FIFO port.
+bool IsPeek(const string& name) {
+  return name == "peek" || name == "try_peek" || IsEot(name);
+}
+
+// Methods that transfer a token only if one is available, or space for it.
+bool IsNonBlocking(const CXXMemberCallExpr* call) {
+  const string name = call->getMethodDecl()->getNameAsString();
+  return llvm::StringRef(name).startswith("try_") ||
+         (name == "read" && call->getNumArgs() > 0);
+}
+
+// Returns whether `child` runs only under a condition evaluated by `parent`.
+bool IsBranch(const Stmt* parent, const Stmt* child) {
+  if (auto if_stmt = dyn_cast<IfStmt>(parent)) {
+    return child == if_stmt->getThen() || child == if_stmt->getElse();
+  }
+  if (auto switch_stmt = dyn_cast<SwitchStmt>(parent)) {
+    return child == switch_stmt->getBody();
+  }
+  if (auto conditional = dyn_cast<AbstractConditionalOperator>(parent)) {
+    return child == conditional->getTrueExpr() ||
+           child == conditional->getFalseExpr();
+  }
+  if (auto binary = dyn_cast<BinaryOperator>(parent)) {
+    return binary->isLogicalOp() && child == binary->getRHS();
+  }
+  return false;
+}
+
+// Returns whether `child` runs instead of another child of `parent`, e.g., the
+// `else` branch instead of the `then` branch.
+bool IsAlternative(const Stmt* parent, const Stmt* child) {
+  if (auto if_stmt = dyn_cast<IfStmt>(parent)) {
+    return child == if_stmt->getThen() || child == if_stmt->getElse();
+  }
+  if (auto conditional = dyn_cast<ConditionalOperator>(parent)) {
+    return child == conditional->getTrueExpr() ||
+           child == conditional->getFalseExpr();
+  }
+  return false;
+}
+
+// Returns whether the statements of a `case` ending with `stmt` leave the
+// `switch` instead of falling through to the next `case`.
+bool EndsCase(const Stmt* stmt) {
+  while (auto switch_case = dyn_cast<clang::SwitchCase>(stmt)) {
+    stmt = switch_case->getSubStmt();
+  }
+  return clang::isa<clang::BreakStmt>(stmt) ||
+         clang::isa<clang::ContinueStmt>(stmt) ||
+         clang::isa<clang::GotoStmt>(stmt) ||
+         clang::isa<clang::ReturnStmt>(stmt);
+}
+
+// Adds to `tokens` the tokens of each port in `other` or, if `is_max`, takes
+// the larger of the two.
+void Merge(map<string, double>& tokens, const map<string, double>& other,
+           bool is_max) {
+  for (const auto& port : other) {
+    auto& value = tokens[port.first];
+    value = is_max ? std::max(value, port.second) : value + port.second;
+  }
+}
+
+string Format(double value) {
+  std::ostringstream oss;
+  oss << value;
+  return oss.str();
+}
+
+// A loop that transfers tokens through stream ports in every iteration.
+struct StreamLoop {
+  const Stmt* loop = nullptr;
+  bool is_pipelined = false;
+  int target_ii = 1;
+  int64_t trip_count = -1;     // unknown
+  map<string, double> tokens;  // per iteration, by port
+  vector<string> order;        // ports in the order they are first accessed
+  bool has_jump = false;       // whether an iteration may end early
+  // branches and nested loops of unknown trip count around the accesses of
+  // each port
+  map<string, vector<const Stmt*>> guards;
+};
+
+class StreamAccessCollector {
+ public:
+  StreamAccessCollector(ASTContext& context, const FunctionDecl* func)
+      : context_(context) {
+    for (auto param : func->parameters()) {
+      if (IsTapaType(param, "(i|o)streams")) {
+        ports_[param] = GetArraySize(param);
+      } else if (IsStreamInterface(param)) {
+        ports_[param] = 0;
+      }
+    }
+  }
+
+  // Collects the accesses in `stmt`, which runs `weight` times per iteration
+  // of `loop`.
+  void Collect(const Stmt* stmt, StreamLoop* loop, double weight) {
+    if (stmt == nullptr) return;
+    if (auto attributed = dyn_cast<AttributedStmt>(stmt)) {
+      if (IsLoop(attributed->getSubStmt())) {
+        CollectLoop(attributed->getSubStmt(), attributed->getAttrs(), loop,
+                    weight);
+        return;
+      }
+    } else if (IsLoop(stmt)) {
+      CollectLoop(stmt, {}, loop, weight);
+      return;
+    } else if (auto switch_stmt = dyn_cast<SwitchStmt>(stmt)) {
+      if (loop != nullptr) {
+        CollectSwitch(switch_stmt, loop, weight);
+        return;
+      }
+    }
+    // `break` in a `switch` only ends its `case`
+    const bool is_loop_break = clang::isa<clang::BreakStmt>(stmt) &&
+                               (breakables_.empty() || !breakables_.back());
+    if (loop != nullptr &&
+        (is_loop_break || clang::isa<clang::ContinueStmt>(stmt) ||
+         clang::isa<clang::GotoStmt>(stmt) ||
+         clang::isa<clang::ReturnStmt>(stmt))) {
+      loop->has_jump = true;
+    }
+    if (auto expr = dyn_cast<Expr>(stmt)) {
+      RecordPeek(expr, loop);
+      RecordAccess(expr, loop, weight);
+      RecordRef(expr);
+    }
+    // mutually exclusive branches take the tokens of the busier one per port
+    map<string, double> alternative_tokens;
+    for (auto child : stmt->children()) {
+      const bool is_branch = IsBranch(stmt, child);
+      const bool is_alternative = loop != nullptr && IsAlternative(stmt, child);
+      if (is_branch) guards_.push_back(child);
+      map<string, double> tokens;
+      if (is_alternative) tokens.swap(loop->tokens);
+      // e.g., `if (in_valid)` after `in.eot(in_valid)`
+      const size_t ready_size = ready_.size();
+      if (auto if_stmt = dyn_cast<IfStmt>(stmt)) {
+        if (child == if_stmt->getThen()) AddReady(if_stmt->getCond());
+      }
+      Collect(child, loop, weight);
+      ready_.resize(ready_size);
+      if (is_alternative) {
+        tokens.swap(loop->tokens);
+        Merge(alternative_tokens, tokens, /*is_max=*/true);
+      }
+      if (is_branch) guards_.pop_back();
+    }
+    if (loop != nullptr) Merge(loop->tokens, alternative_tokens, false);
+  }
+
+  const deque<StreamLoop>& loops() const { return loops_; }
+  const set<string>& peeked() const { return peeked_; }
+  const map<string, vector<size_t>>& framing() const { return framing_; }
+
+  // Ports not accessed by blocking reads or writes only, each in a loop that
+  // runs them under the same guards in every iteration, besides the `open`
+  // and `close` that frame the transactions outside of the loops, or that
+  // are used other than via their methods, e.g., passed to another function.
+  set<string> irregular() const {
+    set<string> result = irregular_;
+    for (const auto& ref : refs_) {
+      auto known = known_refs_.find(ref.first);
+      if (known == known_refs_.end() || known->second < ref.second) {
+        result.insert(ref.first->getNameAsString());
+      }
+    }
+    for (const auto& loop : loops_) {
+      if (!loop.has_jump) continue;
+      for (const auto& port : loop.tokens) result.insert(port.first);
+    }
+    return result;
+  }
+
+ private:
+  // Collects the accesses of the `case`s of `stmt` in `loop`, which are
+  // mutually exclusive, except that a `case` not ending with a jump falls
+  // through to the next one.
+  void CollectSwitch(const SwitchStmt* stmt, StreamLoop* loop, double weight) {
+    Collect(stmt->getInit(), loop, weight);
+    Collect(stmt->getConditionVariableDeclStmt(), loop, weight);
+    Collect(stmt->getCond(), loop, weight);
+
+    guards_.push_back(stmt->getBody());
+    breakables_.push_back(true);
+    map<string, double> tokens;
+    tokens.swap(loop->tokens);
+    // tokens of the statements from each `case` to the next one, and whether
+    // they fall through to the next one
+    vector<map<string, double>> cases;
+    vector<bool> falls_through;
+    const Stmt* last = nullptr;
+    auto end_case = [&](bool is_last) {
+      cases.emplace_back();
+      cases.back().swap(loop->tokens);
+      falls_through.push_back(!is_last && !EndsCase(last));
+    };
+    if (auto body = dyn_cast_or_null<clang::CompoundStmt>(stmt->getBody())) {
+      for (auto child : body->body()) {
+        if (clang::isa<clang::SwitchCase>(child) && last != nullptr) {
+          end_case(/*is_last=*/false);
+        }
+        Collect(child, loop, weight);
+        last = child;
+      }
+    } else {
+      Collect(stmt->getBody(), loop, weight);
+    }
+    end_case(/*is_last=*/true);
+    breakables_.pop_back();
+    guards_.pop_back();
+
+    // the busiest `case` per port, including those it falls through to
+    map<string, double> busiest;
+    map<string, double> next;
+    for (size_t i = cases.size(); i-- > 0;) {
+      if (falls_through[i]) Merge(cases[i], next, /*is_max=*/false);
+      Merge(busiest, cases[i], /*is_max=*/true);
+      next.swap(cases[i]);
+    }
+    loop->tokens.swap(tokens);
+    Merge(loop->tokens, busiest, /*is_max=*/false);
+  }
+
+  void CollectLoop(const Stmt* stmt, llvm::ArrayRef<const clang::Attr*> attrs,
+                   StreamLoop* loop, double weight) {
+    bool is_pipelined = false;
+    int target_ii = 1;
+    int64_t unroll_factor = 1;
+    for (const auto* attr : attrs) {
+      if (auto pipeline = dyn_cast<TapaPipelineAttr>(attr)) {
+        is_pipelined = true;
+        target_ii = std::max(1, int(pipeline->getII()));
+      } else if (auto unroll = dyn_cast<TapaUnrollAttr>(attr)) {
+        // a factor of 0 means fully unrolled
+        unroll_factor = unroll->getFactor();
+      }
+    }
+    LoopVar loop_var;
+    const int64_t trip_count =
+        GetLoopVar(stmt, context_, loop_var) ? loop_var.trip_count : -1;
+    if (unroll_factor == 0) unroll_factor = trip_count;
+    // unknown factors are taken as 1
+    if (unroll_factor < 0) unroll_factor = 1;
+
+    if (loop != nullptr) {
+      // loops nested in a pipelined loop are fully unrolled; those with
+      // unknown trip counts run their accesses conditionally
+      const double copies = trip_count >= 0 ? trip_count : 1;
+      if (trip_count < 0) guards_.push_back(stmt);
+      breakables_.push_back(false);
+      for (auto child : stmt->children()) {
+        Collect(child, loop, weight * copies);
+      }
+      breakables_.pop_back();
+      if (trip_count < 0) guards_.pop_back();
+    } else if (is_pipelined || !ContainsLoop(stmt)) {
+      loops_.emplace_back();
+      auto& stream_loop = loops_.back();
+      stream_loop.loop = stmt;
+      stream_loop.is_pipelined = is_pipelined;
+      stream_loop.target_ii = target_ii;
+      if (trip_count >= 0 && unroll_factor > 0) {
+        stream_loop.trip_count =
+            (trip_count + unroll_factor - 1) / unroll_factor;
+      }
+      // branches around the loop guard all of its accesses alike
+      vector<const Stmt*> guards;
+      guards.swap(guards_);
+      vector<bool> breakables;
+      breakables.swap(breakables_);
+      for (auto child : stmt->children()) {
+        Collect(child, &stream_loop, unroll_factor);
+      }
+      breakables_.swap(breakables);
+      guards_.swap(guards);
+    } else {
+      // the iterations of outer loops that are not pipelined do not overlap,
+      // so only their inner loops stream
+      for (auto child : stmt->children()) Collect(child, nullptr, 1);
+    }
+  }
+
+  void RecordAccess(const Expr* expr, StreamLoop* loop, double weight) {
+    const Expr* object = nullptr;
+    string method;
+    bool is_blocking = true;
+    if (auto call = dyn_cast<CXXMemberCallExpr>(expr)) {
+      if (IsStreamInterface(call->getRecordDecl()) &&
+          call->getMethodDecl() != nullptr &&
+          IsTransfer(call->getMethodDecl()->getNameAsString())) {
+        object = call->getImplicitObjectArgument();
+        method = call->getMethodDecl()->getNameAsString();
+        is_blocking = !IsNonBlocking(call);
+      }
+    } else if (auto call = dyn_cast<CXXOperatorCallExpr>(expr)) {
+      if ((call->getOperator() == clang::OO_GreaterGreater ||
+           call->getOperator() == clang::OO_LessLess) &&
+          call->getNumArgs() == 2 && IsStreamInterface(call->getArg(0))) {
+        object = call->getArg(0);
+      }
+    }
+    if (object == nullptr) return;
+    object = Strip(object);
+
+    // `port` or `ports[index]`
+    const Expr* index = nullptr;
+    if (auto call = dyn_cast<CXXOperatorCallExpr>(object)) {
+      if (call->getOperator() != clang::OO_Subscript) return;
+      object = Strip(call->getArg(0));
+      index = call->getArg(1);
+    }
+    auto ref = dyn_cast<DeclRefExpr>(object);
+    if (ref == nullptr) return;
+    auto port = ports_.find(dyn_cast<ParmVarDecl>(ref->getDecl()));
+    if (port == ports_.end() || (index != nullptr) != (port->second > 0)) {
+      return;
+    }
+    const string name = port->first->getNameAsString();
+    vector<string> names;
+    int64_t value;
+    if (index == nullptr) {
+      names.push_back(name);
+    } else if (EvalConst(index, context_, value)) {
+      names.push_back(ArrayNameAt(name, value));
+    } else {
+      // spread over all elements, as done by unrolled loops over the array
+      for (uint64_t i = 0; i < port->second; ++i) {
+        names.push_back(ArrayNameAt(name, i));
+      }
+      irregular_.insert(names.begin(), names.end());
+    }
+    // a non-blocking read cannot fail once `eot` or `peek` found a token
+    if (method == "read" && index == nullptr &&
+        std::find(ready_.begin(), ready_.end(), name) != ready_.end()) {
+      is_blocking = true;
+    }
+    if (loop == nullptr) {
+      // `open` and `close` outside of the loops frame the transactions
+      if (IsFraming(method) && guards_.empty()) {
+        for (const auto& port_name : names) {
+          framing_[port_name].push_back(loops_.size());
+        }
+      } else {
+        irregular_.insert(names.begin(), names.end());
+      }
+      return;
+    }
+    if (!is_blocking) irregular_.insert(names.begin(), names.end());
+    for (const auto& port_name : names) {
+      loop->tokens[port_name] += weight / names.size();
+      if (std::find(loop->order.begin(), loop->order.end(), port_name) ==
+          loop->order.end()) {
+        loop->order.push_back(port_name);
+        loop->guards[port_name] = guards_;
+      } else if (loop->guards[port_name] != guards_) {
+        irregular_.insert(port_name);
+      }
+    }
+  }
+
+  // Adds the ports that `cond` tells have a token, e.g., `in_valid` set by
+  // `in.eot(in_valid)`, to `ready_`.
+  void AddReady(const Expr* cond) {
+    cond = Strip(cond);
+    if (auto binary = dyn_cast<BinaryOperator>(cond)) {
+      if (binary->getOpcode() == clang::BO_LAnd) {
+        AddReady(binary->getLHS());
+        AddReady(binary->getRHS());
+      }
+    } else if (auto ref = dyn_cast<DeclRefExpr>(cond)) {
+      auto var = ready_vars_.find(ref->getDecl());
+      if (var != ready_vars_.end()) ready_.push_back(var->second);
+    }
+  }
+
+  // Counts the references to each port, and those that call its methods.
+  void RecordRef(const Expr* expr) {
+    if (auto ref = dyn_cast<DeclRefExpr>(expr)) {
+      auto param = dyn_cast<ParmVarDecl>(ref->getDecl());
+      if (ports_.count(param) > 0) ++refs_[param];
+      return;
+    }
+    const Expr* object = nullptr;
+    if (auto call = dyn_cast<CXXMemberCallExpr>(expr)) {
+      if (IsStreamInterface(call->getRecordDecl())) {
+        object = call->getImplicitObjectArgument();
+      }
+    } else if (auto call = dyn_cast<CXXOperatorCallExpr>(expr)) {
+      if ((call->getOperator() == clang::OO_GreaterGreater ||
+           call->getOperator() == clang::OO_LessLess) &&
+          call->getNumArgs() == 2 && IsStreamInterface(call->getArg(0))) {
+        object = call->getArg(0);
+      }
+    }
+    if (object == nullptr) return;
+    object = Strip(object);
+    if (auto subscript = dyn_cast<CXXOperatorCallExpr>(object)) {
+      if (subscript->getOperator() != clang::OO_Subscript) return;
+      object = Strip(subscript->getArg(0));
+    }
+    if (auto ref = dyn_cast<DeclRefExpr>(object)) {
+      auto param = dyn_cast<ParmVarDecl>(ref->getDecl());
+      if (ports_.count(param) > 0) ++known_refs_[param];
+    }
+  }
+
+  // Records the ports peeked other than via `eot` before any token of the
+  // iteration of `loop` is transferred, which tells if the next token of the
+  // iteration ends a transaction, and the variables set by `eot` and `peek`
+  // to tell that a port has a token.
+  void RecordPeek(const Expr* expr, const StreamLoop* loop) {
+    auto call = dyn_cast<CXXMemberCallExpr>(expr);
+    if (call == nullptr || !IsStreamInterface(call->getRecordDecl()) ||
+        call->getMethodDecl() == nullptr ||
+        !IsPeek(call->getMethodDecl()->getNameAsString())) {
+      return;
+    }
+    const Expr* object = Strip(call->getImplicitObjectArgument());
+    const bool is_subscript = clang::isa<CXXOperatorCallExpr>(object);
+    if (auto subscript = dyn_cast<CXXOperatorCallExpr>(object)) {
+      if (subscript->getOperator() != clang::OO_Subscript) return;
+      object = Strip(subscript->getArg(0));
+    }
+    auto ref = dyn_cast<DeclRefExpr>(object);
+    if (ref == nullptr) return;
+    auto param = dyn_cast<ParmVarDecl>(ref->getDecl());
+    if (ports_.count(param) == 0) return;
+    const string name = param->getNameAsString();
+    const string method = call->getMethodDecl()->getNameAsString();
+    if (!IsEot(method) || (loop != nullptr && !loop->order.empty())) {
+      peeked_.insert(name);
+    }
+    if ((method == "eot" || method == "peek") && call->getNumArgs() > 0 &&
+        !is_subscript) {
+      if (auto valid = dyn_cast<DeclRefExpr>(Strip(call->getArg(0)))) {
+        ready_vars_[valid->getDecl()] = name;
+      }
+    }
+  }
+
+  ASTContext& context_;
+  // stream ports and their array sizes, or 0 for single streams
+  map<const ParmVarDecl*, uint64_t> ports_;
+  deque<StreamLoop> loops_;
+  // names of the stream parameters that are peeked anywhere in the task
+  set<string> peeked_;
+  set<string> irregular_;
+  // indices of the loops before which each port is opened or closed
+  map<string, vector<size_t>> framing_;
+  // branches and nested loops of unknown trip count around the current
+  // statement in its stream loop
+  vector<const Stmt*> guards_;
+  // whether each `switch` and nested loop around the current statement in its
+  // stream loop, innermost last, is a `switch`, which `break` leaves
+  vector<bool> breakables_;
+  // ports that have a token for the current statement, and the variables
+  // that tell so
+  vector<string> ready_;
+  map<const clang::ValueDecl*, string> ready_vars_;
+  map<const ParmVarDecl*, int> refs_;
+  map<const ParmVarDecl*, int> known_refs_;
+};
+
+}  // namespace
+
+json AnalyzeThroughput(ASTContext& context, const FunctionDecl* func) {
+  StreamAccessCollector collector(context, func);
+  collector.Collect(func->getBody(), nullptr, 1);
+
+  auto& diagnostics = context.getDiagnostics();
+  static const auto diagnostic_id = diagnostics.getCustomDiagID(
+      clang::DiagnosticsEngine::Warning,
+      "%0 tokens per iteration through stream '%1' limit II to %2 instead of "
+      "%3");
+  auto& source_manager = context.getSourceManager();
+
+  json result = {{"loops", json::array()},
+                 {"ports", json::object()},
+                 {"peeked", collector.peeked()},
+                 {"irregular", collector.irregular()},
+                 {"framing", json::object()}};
+  // indices of the loops in `result`, by index in `collector.loops()`
+  vector<size_t> indices;
+  // cycles from the start of the task until the current loop starts
+  double start = 0;
+  for (const auto& loop : collector.loops()) {
+    indices.push_back(result["loops"].size());
+    int ii = loop.target_ii;
+    const int64_t trip_count = std::max<int64_t>(loop.trip_count, 0);
+    if (loop.tokens.empty()) {
+      start += kLoopLatency + double(trip_count) * ii;
+      continue;
+    }
+    auto busiest = loop.tokens.begin();
+    for (auto it = loop.tokens.begin(); it != loop.tokens.end(); ++it) {
+      if (it->second > busiest->second) busiest = it;
+    }
+    const int port_ii = std::max(1, int(std::ceil(busiest->second)));
+    if (port_ii > ii) {
+      if (loop.is_pipelined) {
+        diagnostics.Report(loop.loop->getBeginLoc(), diagnostic_id)
+            << Format(busiest->second) << busiest->first
+            << std::to_string(port_ii) << std::to_string(ii);
+      }
+      ii = port_ii;
+    }
+
+    const unsigned line =
+        source_manager.getPresumedLineNumber(loop.loop->getBeginLoc());
+    json tokens = json::object();
+    json guards = json::object();
+    vector<vector<const Stmt*>> distinct_guards;
+    for (const auto& port : loop.guards) {
+      auto it = std::find(distinct_guards.begin(), distinct_guards.end(),
+                          port.second);
+      guards[port.first] = it - distinct_guards.begin();
+      if (it == distinct_guards.end()) distinct_guards.push_back(port.second);
+    }
+    for (const auto& port : loop.tokens) {
+      tokens[port.first] = port.second;
+      const double rate = port.second / ii;
+      auto& summary = result["ports"][port.first];
+      if (summary.is_null()) {
+        summary = {{"rate", rate}, {"line", line}, {"start", start}};
+      } else if (summary["rate"].get<double>() < rate) {
+        summary["rate"] = rate;
+        summary["line"] = line;
+      }
+    }
+    result["loops"].push_back({{"line", line},
+                               {"target_ii", loop.target_ii},
+                               {"ii", ii},
+                               {"trip_count", loop.trip_count},
+                               {"start", start},
+                               {"tokens", tokens},
+                               {"order", loop.order},
+                               {"guards", guards}});
+    start += kLoopLatency + double(trip_count) * ii;
+  }
+  indices.push_back(result["loops"].size());
+  for (const auto& port : collector.framing()) {
+    auto& framing = result["framing"][port.first];
+    framing = json::array();
+    for (auto index : port.second) framing.push_back(indices[index]);
+  }
+  return result;
+}
+
+}  // namespace internal
+}  // namespace tapa
@@ -0,0 +1,57 @@
+#ifndef TAPA_THROUGHPUT_H_
+#define TAPA_THROUGHPUT_H_
+
+#include "clang/AST/AST.h"
+
+#include "nlohmann/json.hpp"
+
+namespace tapa {
+namespace internal {
+
+// Estimates the stream throughput of a lower-level task.
+//
+// Stream accesses are attributed to the loop that streams them: the innermost
+// loop annotated with `[[tapa::pipeline]]`, or else the innermost loop, which
+// HLS pipelines by default. Loops nested in that loop are fully unrolled, so
+// their accesses count once per iteration of their trip count, and a
+// `[[tapa::unroll]]` factor on that loop multiplies all of its accesses.
+// Mutually exclusive branches, i.e., the branches of `if` and `?:` and the
+// `case`s of `switch` with those they fall through to, count the tokens of
+// the branch with the most tokens of each port. As
+// every FIFO port transfers at most one token per cycle, the II of a loop is
+// at least the largest number of tokens of one port per iteration; a warning
+// is reported if that exceeds the II of `[[tapa::pipeline]]`.
+//
+// Loops run one after another, so a loop starts once all earlier loops have
+// run their trip counts and drained their pipelines; loops with unknown trip
+// counts only count their pipeline latency.
+//
+// Returns the metadata
+//   {"loops": [{line, target_ii, ii, trip_count, start,
+//               tokens: {port: tokens}, order: [port], guards: {port: id}}],
+//    "ports": {port: {rate, line, start}},
+//    "peeked": [param],
+//    "irregular": [port],
+//    "framing": {port: [loop index]}}
+// where `tokens` are per iteration, `order` lists the ports of the loop in
+// the order they are first accessed, `guards` tells which ports of the loop
+// are accessed under the same branches and nested loops of unknown trip
+// count by the same `id`, `rate` is the highest number of tokens per cycle of
+// a port over all loops, `start` is the estimated cycle at which the loop, or
+// the first loop accessing the port, starts, and `peeked` lists the stream
+// parameters whose tokens are peeked; `eot` only counts if called after a
+// token of the iteration of its loop is transferred. Ports accessed outside
+// of the loops above, other than by the `open` and `close` listed in
+// `framing` with the index of the next loop, under different guards, without
+// blocking, in a loop that may end an iteration early, or used other than
+// via their methods are `irregular`; the others transfer the same tokens
+// whenever their guards hold in an iteration of their loops. Non-blocking
+// `read`s count as blocking under a condition that `eot` or `peek` found a
+// token, e.g., in `TAPA_WHILE_NOT_EOT`.
+nlohmann::json AnalyzeThroughput(clang::ASTContext& context,
+                                 const clang::FunctionDecl* func);
+
+}  // namespace internal
+}  // namespace tapa
+
+#endif  // TAPA_THROUGHPUT_H_
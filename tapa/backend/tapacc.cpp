@@ -17,6 +17,8 @@
 
 #include "nlohmann/json.hpp"
 
+#include "tapa/bank.h"
+#include "tapa/lsbuffer.h"
 #include "tapa/task.h"
 
 using std::make_shared;
@@ -54,6 +56,7 @@ namespace tapa {
 namespace internal {
 
 const string* top_name;
+bool convert_ls_buffers = false;
 
 class Consumer : public ASTConsumer {
  public:
@@ -122,6 +125,15 @@ class Consumer : public ASTConsumer {
     }
 
     // funcs_ has been reset to only contain the tasks.
+    // Buffer partitions and sections are decided from all tasks before any is
+    // rewritten.
+    InferAutoPartitions(context, funcs_);
+    vector<const FunctionDecl*> lower_tasks;
+    for (auto task : funcs_) {
+      if (GetTapaTask(task->getBody()) == nullptr) lower_tasks.push_back(task);
+    }
+    SelectLsBuffers(context, lower_tasks, convert_ls_buffers);
+
     // Traverse the AST for each task and obtain the transformed source code.
     for (auto task : funcs_) {
       visitor_.VisitTask(task);
@@ -138,6 +150,11 @@ class Consumer : public ASTConsumer {
       code["tasks"][task_name]["code"] = code_table[task];
       bool is_upper = GetTapaTask(task->getBody()) != nullptr;
       code["tasks"][task_name]["level"] = is_upper ? "upper" : "lower";
+      if (!is_upper) {
+        // fused tasks are redefined by tapac with the rewritten body
+        code["tasks"][task_name]["body"] = rewriters_[task].getRewrittenText(
+            task->getBody()->getSourceRange());
+      }
       code["tasks"][task_name].update(metadata_[task]);
     }
     code["top"] = *top_name;
@@ -169,12 +186,18 @@ static OptionCategory tapa_option_category("TAPA Compiler Companion");
 static llvm::cl::opt<string> tapa_opt_top_name(
     "top", NumOccurrencesFlag::Required, ValueExpected::ValueRequired,
     llvm::cl::desc("Top-level task name"), llvm::cl::cat(tapa_option_category));
+static llvm::cl::opt<bool> tapa_opt_convert_ls_buffers(
+    "convert-ls-buffers",
+    llvm::cl::desc("Convert 2-section buffers to 1-section LS buffers where "
+                   "the throughput is kept"),
+    llvm::cl::cat(tapa_option_category));
 
 int main(int argc, const char** argv) {
   CommonOptionsParser parser{argc, argv, tapa_option_category};
   ClangTool tool{parser.getCompilations(), parser.getSourcePathList()};
   string top_name{tapa_opt_top_name.getValue()};
   tapa::internal::top_name = &top_name;
+  tapa::internal::convert_ls_buffers = tapa_opt_convert_ls_buffers.getValue();
   int ret = tool.run(newFrontendActionFactory<tapa::internal::Action>().get());
   return ret;
 }
@@ -89,6 +89,11 @@ static void AddDummyBufferRW(ADD_FOR_PARAMS_ARGS_DEF) {
     }
   }
 
+  const bool isArrayType = IsTapaType(param, "(i|o)buffers");
+  const bool watermark =
+      ParseBufferType(param->getType(), isArrayType).watermark;
+  const bool is_producer = IsTapaType(param, "obuffers?");
+
   for (auto const &name : names) {
     const auto src_var = GetSrcVar(name);
     const auto sink_var = GetSinkVar(name);
@@ -97,6 +102,13 @@ static void AddDummyBufferRW(ADD_FOR_PARAMS_ARGS_DEF) {
     add_dummy_read_fifo(src_var);
     add_dummy_write_fifo(sink_var);
     add_dummy_buffer_rw(data_var);
+    if (watermark) {
+      if (is_producer) {
+        add_dummy_write_fifo(GetWatermarkVar(name));
+      } else {
+        add_dummy_read_fifo(GetWatermarkVar(name));
+      }
+    }
   }
 }
 
@@ -291,6 +303,18 @@ void XilinxHLSTarget::AddCodeForLowerLevelBuffer(ADD_FOR_PARAMS_ARGS_DEF) {
     // direction of the FIFOs
     add_line("void(" + src_var + ".empty());");
     add_line("void(" + sink_var + ".full());");
+
+    // the watermark FIFO flows from the obuffer to the ibuffer side
+    if (bufferConfig.watermark) {
+      const auto watermark_var = GetWatermarkVar(name);
+      add_pragma({"HLS interface ap_fifo port =", watermark_var});
+      add_pragma({"HLS interface aggregate port =", watermark_var});
+      if (IsTapaType(param, "obuffers?")) {
+        add_line("void(" + watermark_var + ".full());");
+      } else {
+        add_line("void(" + watermark_var + ".empty());");
+      }
+    }
   }
 }
 
@@ -1,6 +1,8 @@
 #ifndef TAPA_BASE_BUFFER_H
 #define TAPA_BASE_BUFFER_H
 
+#include <climits>
+
 namespace tapa {
 
 struct normal {};
@@ -16,15 +18,34 @@ struct block {
   const int factor = ft;
 };
 
+// let tapacc pick the partition of every dimension from the loops that access
+// the sections of the buffer, as `array_partition<auto_partition>`
+struct auto_partition {};
+
 template <typename... partitions>
 struct array_partition {};
 
 struct bram {};
 struct uram {};
+// let tapac pick BRAM, URAM, or a mix of both per bank from the buffer shape
+// and the resources left on the device
+struct auto_core {};
 
 template <typename core_type>
 struct memcore {};
 
+// Adds a watermark FIFO to the buffer, so that the producer can publish its
+// progress within a section and the consumer can start before the section is
+// complete.
+struct watermark {};
+
+namespace internal {
+
+// watermark published by the producer when it releases a section
+inline constexpr int kWatermarkDone = INT_MAX;
+
+}  // namespace internal
+
 }  // namespace tapa
 
 #endif  // TAPA_BASE_BUFFER_H
\ No newline at end of file
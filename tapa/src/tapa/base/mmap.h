@@ -1,6 +1,108 @@
 #ifndef TAPA_BASE_MMAP_H_
 #define TAPA_BASE_MMAP_H_
 
-namespace tapa {}  // namespace tapa
+#include <cstdint>
+
+namespace tapa {
+
+/// Access pattern of the reads of a @c tapa::async_mmap, passed as its second
+/// template argument and exploited when coalescing read requests into bursts,
+/// both by the generated RTL and by the memory model of software simulation.
+///
+/// @tparam max_gap     Maximum number of unrequested elements between a read
+///                     request and the end of the current burst for the burst
+///                     to be extended over them; the extra elements are
+///                     fetched and dropped. Suits strided reads with small
+///                     strides. 0 coalesces consecutive addresses only.
+/// @tparam cache_depth Number of the most recent elements of the current burst
+///                     that serve repeated read requests without fetching
+///                     them again. Suits gathers through small index windows.
+///
+/// Both must be less than 256.
+template <int max_gap = 0, int cache_depth = 0>
+struct access_pattern {
+  static_assert(0 <= max_gap && max_gap < 256, "max_gap must be in [0, 256)");
+  static_assert(0 <= cache_depth && cache_depth < 256,
+                "cache_depth must be in [0, 256)");
+  static constexpr int kMaxGap = max_gap;
+  static constexpr int kCacheDepth = cache_depth;
+};
+
+namespace internal {
+
+// Returns the number of elements of an array of `size` elements stored in
+// channel `ch` of `S` channels in blocks of `granularity` elements.
+constexpr uint64_t get_striped_channel_size(uint64_t size, uint64_t S,
+                                            uint64_t granularity,
+                                            uint64_t ch) {
+  // elements in the last, partial round of blocks across the channels
+  const uint64_t rest = size % (granularity * S);
+  const uint64_t begin = ch * granularity;
+  const uint64_t last = rest <= begin ? 0 : rest - begin;
+  return size / (granularity * S) * granularity +
+         (last < granularity ? last : granularity);
+}
+
+}  // namespace internal
+
+/// Layout of an array interleaved across @c S memory channels in blocks of
+/// @c granularity elements: block @c b of the array is stored as block
+/// <tt>b / S</tt> of channel <tt>b % S</tt>, so that reading the array in
+/// order spreads the accesses evenly across the channels.
+///
+/// @tparam S           Number of channels.
+/// @tparam granularity Number of consecutive elements stored in one channel.
+template <uint64_t S, uint64_t granularity = 1>
+struct striped_layout {
+  static_assert(S > 0, "S must be positive");
+  static_assert(granularity > 0, "granularity must be positive");
+
+  /// Returns the channel storing element @c idx.
+  static constexpr uint64_t channel(uint64_t idx) {
+    return idx / granularity % S;
+  }
+
+  /// Returns the index of element @c idx in its channel.
+  static constexpr uint64_t offset(uint64_t idx) {
+    return idx / (granularity * S) * granularity + idx % granularity;
+  }
+
+  /// Returns the number of elements of an array of @c size elements stored in
+  /// channel @c ch.
+  static constexpr uint64_t channel_size(uint64_t size, uint64_t ch) {
+    return internal::get_striped_channel_size(size, S, granularity, ch);
+  }
+};
+
+/// Merges the channels of a striped array into one stream in array order.
+///
+/// To be called in a task. @c channels[c] must provide the elements stored in
+/// channel @c c in order, e.g., from a reader task per channel invoked on the
+/// @c tapa::mmaps of a @c tapa::striped_mmap, each reading
+/// <tt>striped_layout<S, granularity>::channel_size(n, c)</tt> elements.
+///
+/// @tparam S           Number of channels.
+/// @tparam granularity Number of consecutive elements stored in one channel.
+/// @param channels     @c tapa::istreams of the channels.
+/// @param out          @c tapa::ostream of the array.
+/// @param n            Number of elements of the array.
+template <uint64_t S, uint64_t granularity = 1, typename InStreams,
+          typename OutStream>
+inline void merge_striped(InStreams& channels, OutStream& out, uint64_t n) {
+  uint64_t ch = 0;
+  uint64_t count = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+#ifdef __SYNTHESIS__
+#pragma HLS pipeline II = 1
+#endif  // __SYNTHESIS__
+    out.write(channels[ch].read());
+    if (++count == granularity) {
+      count = 0;
+      ch = ch + 1 == S ? 0 : ch + 1;
+    }
+  }
+}
+
+}  // namespace tapa
 
 #endif  // TAPA_BASE_MMAP_H_
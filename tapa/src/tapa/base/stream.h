@@ -1,12 +1,28 @@
 #ifndef TAPA_BASE_STREAM_H_
 #define TAPA_BASE_STREAM_H_
 
+#include <cstdint>
+
 namespace tapa {
 
 inline constexpr int kStreamDefaultDepth = 2;
 
+/// Depth of a @c tapa::stream to be inferred by tapac, e.g.,
+/// <tt>tapa::stream<T, tapa::auto_depth></tt>. The inferred depth is large
+/// enough for the tokens that wait on the faster of reconvergent paths in the
+/// task graph, and the default depth otherwise.
+inline constexpr uint64_t auto_depth = 0;
+
 namespace internal {
 
+// Depth of `auto_depth` streams in software simulation, where the inferred
+// depth is unknown; deep enough not to stall where the hardware would not.
+inline constexpr uint64_t kStreamAutoDepthSim = 1024;
+
+constexpr uint64_t get_stream_depth(uint64_t depth) {
+  return depth == auto_depth ? kStreamAutoDepthSim : depth;
+}
+
 template <typename T>
 struct elem_t {
   T val;
@@ -6,6 +6,31 @@ namespace tapa {
 inline constexpr int join = 0;
 inline constexpr int detach = -1;
 
+/// Instantiation mode that replicates a task invoked with
+/// <tt>tapa::task().invoke<tapa::replicated<n>>(func, args...)</tt>.
+///
+/// @c func must be a stateless task with exactly one @c tapa::istream and one
+/// @c tapa::ostream parameter, and scalars otherwise, which are passed to
+/// every instance. It must write one token for every token it reads, and close
+/// its output when its input is closed.
+///
+/// Instead of one instance, @c n instances are instantiated, each with the
+/// given instantiation mode. The tokens of the input stream are distributed to
+/// them in round-robin order, and the results are collected from them in the
+/// same order, so the output stream receives them in the order of the input.
+/// The distributor and the collector are generated by the runtime in software
+/// simulation and by tapac in hardware; both are detached and forward any
+/// number of transactions.
+///
+/// @tparam n Number of instances.
+/// @tparam m Instantiation mode of the instances (@c join or @c detach).
+template <int n, int m = join>
+struct replicated {
+  static_assert(n > 0, "a task must be replicated at least once");
+  static constexpr int length = n;
+  static constexpr int mode = m;
+};
+
 /// Class that generates a sequence of integers as task arguments.
 ///
 /// Canonical usage:
@@ -32,6 +57,65 @@ struct seq {
   int pos = 0;
 };
 
+namespace internal {
+
+// Distributes the tokens of `in` to `out[0]`, ..., `out[n - 1]` in round-robin
+// order, and closes all of `out` at the end of each transaction.
+template <int n, typename InStream, typename OutStreams>
+inline void distribute_round_robin(InStream& in, OutStreams& out) {
+  for (;;) {
+    int i = 0;
+    for (bool is_valid;;) {
+#ifdef __SYNTHESIS__
+#pragma HLS pipeline II = 1
+#endif  // __SYNTHESIS__
+      const bool is_eot = in.eot(is_valid);
+      if (is_valid) {
+        if (is_eot) break;
+        out[i].write(in.read(nullptr));
+        i = i + 1 == n ? 0 : i + 1;
+      }
+    }
+    in.open();
+    for (int j = 0; j < n; ++j) {
+#ifdef __SYNTHESIS__
+#pragma HLS unroll
+#endif  // __SYNTHESIS__
+      out[j].close();
+    }
+  }
+}
+
+// Collects the tokens of `in[0]`, ..., `in[n - 1]` in round-robin order, as
+// distributed by `distribute_round_robin`, and closes `out` once the
+// transaction ends.
+template <int n, typename InStreams, typename OutStream>
+inline void collect_round_robin(InStreams& in, OutStream& out) {
+  for (;;) {
+    int i = 0;
+    for (bool is_valid;;) {
+#ifdef __SYNTHESIS__
+#pragma HLS pipeline II = 1
+#endif  // __SYNTHESIS__
+      const bool is_eot = in[i].eot(is_valid);
+      if (is_valid) {
+        if (is_eot) break;
+        out.write(in[i].read(nullptr));
+        i = i + 1 == n ? 0 : i + 1;
+      }
+    }
+    for (int j = 0; j < n; ++j) {
+#ifdef __SYNTHESIS__
+#pragma HLS unroll
+#endif  // __SYNTHESIS__
+      in[j].open();
+    }
+    out.close();
+  }
+}
+
+}  // namespace internal
+
 }  // namespace tapa
 
 #endif  // TAPA_BASE_TASK_H_
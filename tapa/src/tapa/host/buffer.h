@@ -1,8 +1,23 @@
 #ifndef TAPA_HOST_BUFFER_H_
 #define TAPA_HOST_BUFFER_H_
 
+#include <climits>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
 #include "tapa/base/buffer.h"
 #include "tapa/host/stream.h"
+#include "tapa/host/task.h"
 
 namespace tapa {
 
@@ -32,15 +47,340 @@ namespace internal {
 template <typename T, int len, int n_sections, typename... dims>
 class basic_buffers;
 
-template <typename T, int n_sections>
+// HLS array_partition kinds; `complete` is handled as `cyclic` with a factor
+// equal to the extent of the dimension.
+enum class partition_kind { kNormal, kCyclic, kBlock };
+
+template <typename partition>
+struct partition_traits;
+
+template <>
+struct partition_traits<normal> {
+  static constexpr partition_kind kKind = partition_kind::kNormal;
+  static constexpr int kFactor = 1;
+};
+
+template <>
+struct partition_traits<complete> {
+  static constexpr partition_kind kKind = partition_kind::kCyclic;
+  static constexpr int kFactor = INT_MAX;  // clamped to the extent
+};
+
+// partitions inferred by tapacc only change the banks in hardware
+template <>
+struct partition_traits<auto_partition> {
+  static constexpr partition_kind kKind = partition_kind::kNormal;
+  static constexpr int kFactor = 1;
+};
+
+template <int ft>
+struct partition_traits<cyclic<ft>> {
+  static_assert(ft > 0, "cyclic partition factor must be positive");
+  static constexpr partition_kind kKind = partition_kind::kCyclic;
+  static constexpr int kFactor = ft;
+};
+
+template <int ft>
+struct partition_traits<block<ft>> {
+  static_assert(ft > 0, "block partition factor must be positive");
+  static constexpr partition_kind kKind = partition_kind::kBlock;
+  static constexpr int kFactor = ft;
+};
+
+// finds the `array_partition<...>` among the buffer dims; defaults to no
+// partitioning at all
+template <typename... dims>
+struct find_array_partition {
+  using type = array_partition<>;
+};
+
+template <typename... partitions, typename... rest>
+struct find_array_partition<array_partition<partitions...>, rest...> {
+  using type = array_partition<partitions...>;
+};
+
+template <typename first, typename... rest>
+struct find_array_partition<first, rest...> : find_array_partition<rest...> {};
+
+// finds the `memcore<...>` among the buffer dims; BRAM if not specified
+template <typename... dims>
+struct find_memcore {
+  static constexpr const char* kName = "BRAM";
+};
+
+template <typename... rest>
+struct find_memcore<memcore<uram>, rest...> {
+  static constexpr const char* kName = "URAM";
+};
+
+template <typename... rest>
+struct find_memcore<memcore<bram>, rest...> {
+  static constexpr const char* kName = "BRAM";
+};
+
+template <typename... rest>
+struct find_memcore<memcore<auto_core>, rest...> {
+  static constexpr const char* kName = "AUTO";
+};
+
+template <typename first, typename... rest>
+struct find_memcore<first, rest...> : find_memcore<rest...> {};
+
+// Maps the multi-dimensional index of a section element to its bank and to
+// its offset inside that bank, following `#pragma HLS array_partition`
+// semantics. Each bank is stored contiguously, i.e., element (bank, offset)
+// lives at `bank * bank_size() + offset` of the section storage.
+template <typename T, typename partition_spec>
+class buffer_layout;
+
+template <typename T, typename... partitions>
+class buffer_layout<T, array_partition<partitions...>> {
+ public:
+  using elem_t = std::remove_all_extents_t<T>;
+  static constexpr int kRank = std::rank<T>::value;
+  static_assert(sizeof...(partitions) <= kRank,
+                "array_partition has more partitions than the buffer has "
+                "dimensions");
+
+  // whether any dimension is split into more than one bank; buffers that are
+  // not banked keep the plain row-major layout
+  static constexpr bool kIsBanked =
+      (false || ... ||
+       (partition_traits<partitions>::kKind != partition_kind::kNormal &&
+        partition_traits<partitions>::kFactor > 1));
+
+  using index_t = std::array<int, kRank>;
+
+  buffer_layout() {
+    const index_t extents = get_extents(std::make_index_sequence<kRank>());
+    const std::array<partition_kind, sizeof...(partitions)> kinds = {
+        partition_traits<partitions>::kKind...};
+    const std::array<int, sizeof...(partitions)> factors = {
+        partition_traits<partitions>::kFactor...};
+    for (int d = 0; d < kRank; ++d) {
+      extent_[d] = extents[d];
+      kind_[d] = d < int(kinds.size()) ? kinds[d] : partition_kind::kNormal;
+      banks_[d] = kind_[d] == partition_kind::kNormal
+                      ? 1
+                      : std::min(factors[d], extent_[d]);
+      bank_extent_[d] = (extent_[d] + banks_[d] - 1) / banks_[d];
+      bank_count_ *= banks_[d];
+      bank_size_ *= bank_extent_[d];
+    }
+  }
+
+  int extent(int dim) const { return extent_[dim]; }
+  int bank_count() const { return bank_count_; }
+  int bank_size() const { return bank_size_; }
+
+  // number of elements a section occupies, including the padding of banks
+  // when the extent is not divisible by the partition factor
+  int section_size() const { return bank_count_ * bank_size_; }
+
+  int bank(const index_t& index) const {
+    int result = 0;
+    for (int d = 0; d < kRank; ++d) {
+      int bank = 0;
+      switch (kind_[d]) {
+        case partition_kind::kNormal:
+          break;
+        case partition_kind::kCyclic:
+          bank = index[d] % banks_[d];
+          break;
+        case partition_kind::kBlock:
+          bank = index[d] / bank_extent_[d];
+          break;
+      }
+      result = result * banks_[d] + bank;
+    }
+    return result;
+  }
+
+  int offset(const index_t& index) const {
+    int result = 0;
+    for (int d = 0; d < kRank; ++d) {
+      int offset = index[d];
+      switch (kind_[d]) {
+        case partition_kind::kNormal:
+          break;
+        case partition_kind::kCyclic:
+          offset = index[d] / banks_[d];
+          break;
+        case partition_kind::kBlock:
+          offset = index[d] % bank_extent_[d];
+          break;
+      }
+      result = result * bank_extent_[d] + offset;
+    }
+    return result;
+  }
+
+ private:
+  template <size_t... dims>
+  static constexpr index_t get_extents(std::index_sequence<dims...>) {
+    return {int(std::extent<T, dims>::value)...};
+  }
+
+  index_t extent_;
+  std::array<partition_kind, kRank> kind_;
+  index_t banks_;
+  index_t bank_extent_;
+  int bank_count_ = 1;
+  int bank_size_ = 1;
+};
+
+template <typename T, typename... dims>
+using buffer_layout_t =
+    buffer_layout<T, typename find_array_partition<dims...>::type>;
+
+template <typename data_t, int level, bool is_const>
+class banked_ref;
+
+// What `section()` returns for a banked buffer. Indexing it like the original
+// array type reaches the element through the bank-interleaved layout, and
+// every access is counted against the bank it hits so that more accesses per
+// iteration than a bank has ports can be reported by `next_iteration`, which
+// must be called at the end of every iteration of the loop accessing the
+// section for the counts to be per iteration.
+template <typename data_t>
+class banked_section_ref {
+ public:
+  using layout_t = typename data_t::layout_t;
+  using elem_t = typename layout_t::elem_t;
+  using index_t = typename layout_t::index_t;
+
+  // BRAM and URAM are both true dual-port
+  static constexpr int kPortsPerBank = 2;
+
+  decltype(auto) operator[](int pos) {
+    return banked_ref<data_t, 0, false>(this, index_t{})[pos];
+  }
+  // reads through a `const section` are counted all the same
+  decltype(auto) operator[](int pos) const {
+    return banked_ref<data_t, 0, true>(const_cast<banked_section_ref*>(this),
+                                       index_t{})[pos];
+  }
+
+  /// Marks the end of one iteration of the (unrolled) loop accessing this
+  /// section, and warns if any bank was accessed more times than it has ports.
+  void next_iteration() {
+    for (int bank = 0; bank < int(hits_.size()); ++bank) {
+      if (hits_[bank] > kPortsPerBank &&
+          !data_->port_conflict_reported.exchange(true)) {
+        LOG(WARNING) << "buffer '" << data_->get_name() << "': " << hits_[bank]
+                     << " accesses to bank " << bank << " of "
+                     << hits_.size() << " in one iteration, but each "
+                     << data_->memcore_name() << " bank only has "
+                     << kPortsPerBank
+                     << " ports; the loop will not achieve its target II "
+                        "unless the buffer is partitioned further";
+      }
+      hits_[bank] = 0;
+    }
+  }
+
+ private:
+  template <typename T, int n_sections, typename... dims>
+  friend class ::tapa::section;
+  template <typename, int, bool>
+  friend class banked_ref;
+
+  banked_section_ref() = default;
+
+  void reset(data_t* data, int section_id) {
+    data_ = data;
+    base_ = data->banked.get() + section_id * data->layout.section_size();
+    hits_.assign(data->layout.bank_count(), 0);
+  }
+
+  elem_t& at(const index_t& index) {
+    const int bank = data_->layout.bank(index);
+    ++hits_[bank];
+    return base_[bank * data_->layout.bank_size() +
+                 data_->layout.offset(index)];
+  }
+
+  data_t* data_ = nullptr;
+  elem_t* base_ = nullptr;
+  std::vector<int> hits_;
+};
+
+// partially indexed banked section, e.g., `section()[i]` of a 2-D buffer;
+// elements are read-only if `is_const`
+template <typename data_t, int level, bool is_const>
+class banked_ref {
+ public:
+  using layout_t = typename data_t::layout_t;
+  using index_t = typename layout_t::index_t;
+
+  banked_ref(banked_section_ref<data_t>* root, const index_t& index)
+      : root_(root), index_(index) {}
+
+  decltype(auto) operator[](int pos) const {
+    CHECK_GE(pos, 0);
+    CHECK_LT(pos, root_->data_->layout.extent(level));
+    index_t index = index_;
+    index[level] = pos;
+    if constexpr (level + 1 == layout_t::kRank && is_const) {
+      return std::as_const(root_->at(index));
+    } else if constexpr (level + 1 == layout_t::kRank) {
+      return root_->at(index);
+    } else {
+      return banked_ref<data_t, level + 1, is_const>(root_, index);
+    }
+  }
+
+ private:
+  banked_section_ref<data_t>* root_;
+  index_t index_;
+};
+
+// whether the buffer dims include `watermark`
+template <typename... dims>
+struct has_watermark : std::disjunction<std::is_same<dims, watermark>...> {};
+
+// depth of the FIFO carrying the producer's watermarks to the consumer; it is
+// shared by all sections, so marks that do not fit are dropped by `publish`
+inline constexpr int kWatermarkDepth = 4;
+
+// allocates `count` zero-initialized objects of type `U` owned by a `Ptr`;
+// trivial types are mapped with the page size and NUMA placement given by
+// TAPA_HUGE_PAGES and TAPA_NUMA_NODE, same as `aligned_allocator`, but
+// privately, as buffers are never passed to the worker process
+template <typename Ptr, typename U>
+Ptr allocate_sections(size_t count) {
+  if constexpr (std::is_trivially_default_constructible_v<U> &&
+                std::is_trivially_destructible_v<U>) {
+    const size_t length = count * sizeof(U);
+    return Ptr(static_cast<U*>(
+                   allocate(length, page_size::kDefault, kNumaDefault,
+                            /*is_shared=*/false)),
+               [length](U* ptr) {
+                 deallocate(ptr, length, page_size::kDefault);
+               });
+  } else {
+    return Ptr(new U[count]());
+  }
+}
+
+template <typename T, int n_sections, typename... dims>
 struct buffer_data {
-  buffer_data(const std::string& name = "")
-      : name(name), ptr(new T[n_sections]) {
+  using layout_t = buffer_layout_t<T, dims...>;
+  using elem_t = typename layout_t::elem_t;
+
+  buffer_data(const std::string& name = "") : name(name) {
+    if constexpr (layout_t::kIsBanked) {
+      banked = allocate_sections<decltype(banked), elem_t>(
+          n_sections * layout.section_size());
+    } else {
+      ptr = allocate_sections<decltype(ptr), T>(n_sections);
+    }
     for (int i = 0; i < n_sections; i++) {
       free_sections.write(i);
     }
     free_sections.set_name(name + "'s free sections FIFO");
     occupied_sections.set_name(name + "'s occupied sections FIFO");
+    watermarks.set_name(name + "'s watermark FIFO");
   }
 
   ~buffer_data() {
@@ -55,23 +395,38 @@ struct buffer_data {
     this->name = name;
     free_sections.set_name(this->name + "'s free sections FIFO");
     occupied_sections.set_name(this->name + "'s occupied sections FIFO");
+    watermarks.set_name(this->name + "'s watermark FIFO");
+  }
+
+  static constexpr const char* memcore_name() {
+    return find_memcore<dims...>::kName;
   }
 
   stream<int, n_sections> free_sections;
   stream<int, n_sections> occupied_sections;
+  // progress of the producer within the section being written, only used by
+  // buffers with `watermark`
+  stream<int, kWatermarkDepth> watermarks;
   // the memory buffer is an std::array wrapped by std::shared_ptr because
   // while being passed down to the task, the buffer object gets copied
   // because of std::forward; it should be a single unique buffer in all
   // copies and should not be freed when these copies go out of scope;
   // std::shared_ptr insures this
   std::shared_ptr<T[n_sections]> ptr;
+  // for buffers with an `array_partition` that splits them into banks, the
+  // sections are instead stored bank by bank, as laid out by `layout`
+  const layout_t layout;
+  std::shared_ptr<elem_t[]> banked;
+  // bank port conflicts are reported only once per buffer
+  std::atomic<bool> port_conflict_reported{false};
   std::string name;
 };
 
-template <typename T, int n_sections>
+template <typename T, int n_sections, typename... dims>
 class basic_buffer {
  protected:
-  basic_buffer(const std::shared_ptr<buffer_data<T, n_sections>>& ptr)
+  basic_buffer(
+      const std::shared_ptr<buffer_data<T, n_sections, dims...>>& ptr)
       : inner_data(ptr) {}
 
   basic_buffer(const basic_buffer&) = default;
@@ -83,7 +438,7 @@ class basic_buffer {
   void set_name(const std::string& name) { inner_data->set_name(name); }
 
  public:
-  std::shared_ptr<buffer_data<T, n_sections>> inner_data;
+  std::shared_ptr<buffer_data<T, n_sections, dims...>> inner_data;
 };
 
 }  // namespace internal
@@ -111,9 +466,9 @@ class basic_buffer {
 /// }
 /// ```
 template <typename T, int n_sections, typename... dims>
-class obuffer : public virtual internal::basic_buffer<T, n_sections> {
+class obuffer : public virtual internal::basic_buffer<T, n_sections, dims...> {
  protected:
-  obuffer() : internal::basic_buffer<T, n_sections>(nullptr) {}
+  obuffer() : internal::basic_buffer<T, n_sections, dims...>(nullptr) {}
 
  public:
   using section_t = section<T, n_sections, dims...>;
@@ -152,9 +507,9 @@ class obuffer : public virtual internal::basic_buffer<T, n_sections> {
 /// }
 /// ```
 template <typename T, int n_sections, typename... dims>
-class ibuffer : public virtual internal::basic_buffer<T, n_sections> {
+class ibuffer : public virtual internal::basic_buffer<T, n_sections, dims...> {
  protected:
-  ibuffer() : internal::basic_buffer<T, n_sections>(nullptr) {}
+  ibuffer() : internal::basic_buffer<T, n_sections, dims...>(nullptr) {}
 
  public:
   using section_t = section<T, n_sections, dims...>;
@@ -185,6 +540,10 @@ class ibuffer : public virtual internal::basic_buffer<T, n_sections> {
 /// free if it can be written to by the producer task and it is said to
 /// be occupied if it can be read from by the consumer task.
 ///
+/// With @c tapa::watermark among the @c dims, the producer hands a section
+/// over on its first @c section::publish instead of on release, and the
+/// consumer reads the section as it is written using @c section::wait_until.
+///
 /// @tparam T the data type to store in the buffer
 /// @tparam n_sections the total number of PingPong buffers; mostly two.
 template <typename T, int n_sections, typename... dims>
@@ -192,38 +551,96 @@ class buffer : public ibuffer<T, n_sections, dims...>,
                public obuffer<T, n_sections, dims...> {
  public:
   buffer(const std::string& name = "")
-      : internal::basic_buffer<T, n_sections>(
-            std::make_shared<internal::buffer_data<T, n_sections>>(name)) {}
+      : internal::basic_buffer<T, n_sections, dims...>(
+            std::make_shared<internal::buffer_data<T, n_sections, dims...>>(
+                name)) {}
 };
 
 // A helper class to let users access a section of
 // the pingpong buffer memory core
+//
+// If the buffer is split into banks by `array_partition`, the section is
+// stored bank-interleaved like the partitioned memory core, and `section()`
+// returns a view that is indexed like `T` instead of a `T&`.
 template <typename T, int n_sections, typename... dims>
 class section {
+  using data_t = internal::buffer_data<T, n_sections, dims...>;
+  static constexpr bool kIsBanked = data_t::layout_t::kIsBanked;
+  static constexpr bool kHasWatermark = internal::has_watermark<dims...>::value;
+
  public:
-  T& operator()() { return data.inner_data->ptr[section_id]; }
-  const T& operator()() const { return data.inner_data->ptr[section_id]; }
+  using view_t =
+      std::conditional_t<kIsBanked, internal::banked_section_ref<data_t>, T>;
 
-#ifdef TAPA_BUFFER_EXPLICIT_RELEASE
-  void release_section() {
-    if (for_producer) {
-      data.inner_data->occupied_sections.write(section_id);
+  view_t& operator()() {
+    if constexpr (kIsBanked) {
+      return view;
     } else {
-      data.inner_data->free_sections.write(section_id);
+      return data.inner_data->ptr[section_id];
     }
   }
-#else
-  ~section() {
-    if (for_producer) {
-      data.inner_data->occupied_sections.write(section_id);
+  const view_t& operator()() const {
+    if constexpr (kIsBanked) {
+      return view;
     } else {
-      data.inner_data->free_sections.write(section_id);
+      return data.inner_data->ptr[section_id];
+    }
+  }
+
+  /// Marks the end of one iteration of the loop accessing this section. For
+  /// banked buffers, warns if a bank was accessed more times in the iteration
+  /// than it has ports.
+  ///
+  /// Bank conflicts are only checked here, so the loop must call this at the
+  /// end of every iteration; it is not called when the section is released.
+  /// In hardware, it does nothing.
+  void next_iteration() {
+    if constexpr (kIsBanked) {
+      view.next_iteration();
     }
   }
+
+  /// Publishes that the producer has written elements before @c index of the
+  /// section. The first call hands the section over to the consumer, which
+  /// can then start reading the published part with @c wait_until.
+  ///
+  /// Only available if the buffer has @c tapa::watermark. The producer must
+  /// publish at least once per section. Publishing never blocks: if the
+  /// watermark FIFO is full, the mark is dropped and the consumer waits for a
+  /// later one or for the release of the section.
+  void publish(int index) {
+    static_assert(kHasWatermark, "publish() requires a tapa::watermark buffer");
+    CHECK(for_producer) << "buffer '" << data.inner_data->get_name()
+                        << "': publish() called by the consumer";
+    if (!published) {
+      data.inner_data->occupied_sections.write(section_id);
+      published = true;
+    }
+    data.inner_data->watermarks.try_write(index);
+  }
+
+  /// Blocks until the producer has published element @c index of the
+  /// section, or has released the whole section.
+  ///
+  /// Only available if the buffer has @c tapa::watermark.
+  void wait_until(int index) {
+    static_assert(kHasWatermark,
+                  "wait_until() requires a tapa::watermark buffer");
+    CHECK(!for_producer) << "buffer '" << data.inner_data->get_name()
+                         << "': wait_until() called by the producer";
+    while (watermark <= index) {
+      watermark = data.inner_data->watermarks.read();
+    }
+  }
+
+#ifdef TAPA_BUFFER_EXPLICIT_RELEASE
+  void release_section() { finish(); }
+#else
+  ~section() { finish(); }
 #endif
 
  private:
-  using buffer_t = internal::basic_buffer<T, n_sections>;
+  using buffer_t = internal::basic_buffer<T, n_sections, dims...>;
 
   // section class should be instantiated only by an `ibuffer`
   // or `obuffer`; Hence private constructor and friend class
@@ -242,9 +659,34 @@ class section {
     } else {
       section_id = data.inner_data->occupied_sections.read();
     }
+    if constexpr (kIsBanked) {
+      view.reset(data.inner_data.get(), section_id);
+    }
     valid = true;
   }
 
+  // hands the section over to the other side; with watermarks, the producer
+  // already did so on its first `publish`
+  void finish() {
+    if (for_producer) {
+      if constexpr (kHasWatermark) {
+        CHECK(published) << "buffer '" << data.inner_data->get_name()
+                         << "': section released without publish()";
+        data.inner_data->watermarks.write(internal::kWatermarkDone);
+      } else {
+        data.inner_data->occupied_sections.write(section_id);
+      }
+    } else {
+      if constexpr (kHasWatermark) {
+        // drain the remaining watermarks of this section
+        while (watermark != internal::kWatermarkDone) {
+          watermark = data.inner_data->watermarks.read();
+        }
+      }
+      data.inner_data->free_sections.write(section_id);
+    }
+  }
+
   // the actual buffer object and the section_id this instance
   // is supposed to access
   buffer_t& data;
@@ -252,6 +694,12 @@ class section {
   // whether the instance is for a producer task or a consumer task
   const bool for_producer;
   bool valid = false; // init default as dummy buffer
+  // producer: whether the section was handed over by `publish`;
+  // consumer: the last watermark received
+  bool published = false;
+  int watermark = 0;
+  // bank-interleaved view of the section; unused if the buffer is not banked
+  std::conditional_t<kIsBanked, view_t, std::tuple<>> view;
 };
 
 namespace internal {
@@ -0,0 +1,379 @@
+#ifndef TAPA_HOST_DEVICE_H_
+#define TAPA_HOST_DEVICE_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include <frt.h>
+
+#include "tapa/host/logging.h"
+
+namespace tapa {
+
+namespace internal {
+
+// Byte address ranges [first, second) of host memory.
+using address_ranges = std::vector<std::pair<uintptr_t, uintptr_t>>;
+
+inline std::mutex& dirty_ranges_mutex() {
+  static std::mutex mtx;
+  return mtx;
+}
+
+// Host memory marked by `tapa::mark_dirty` since the last invocation.
+inline address_ranges& dirty_ranges() {
+  static address_ranges ranges;
+  return ranges;
+}
+
+// Returns and forgets the marked ranges, sorted and merged.
+inline address_ranges take_dirty_ranges() {
+  address_ranges ranges;
+  {
+    std::unique_lock<std::mutex> lock(dirty_ranges_mutex());
+    ranges.swap(dirty_ranges());
+  }
+  std::sort(ranges.begin(), ranges.end());
+  address_ranges merged;
+  for (const auto& range : ranges) {
+    if (!merged.empty() && range.first <= merged.back().second) {
+      merged.back().second = std::max(merged.back().second, range.second);
+    } else {
+      merged.push_back(range);
+    }
+  }
+  return merged;
+}
+
+template <typename Instance, typename = void>
+struct can_suspend_buffer : std::false_type {};
+
+template <typename Instance>
+struct can_suspend_buffer<
+    Instance, std::void_t<decltype(std::declval<Instance&>().SuspendBuf(0))>>
+    : std::true_type {};
+
+// Excludes buffer argument `index` from the transfers of `instance` until it
+// is set again. Returns false if the runtime does not support it.
+template <typename Instance>
+bool suspend_buffer(Instance& instance, int index) {
+  if constexpr (can_suspend_buffer<Instance>::value) {
+    instance.SuspendBuf(index);
+    return true;
+  }
+  return false;
+}
+
+// FPGA programmed with a bitstream, together with the host memory bound to
+// its buffer arguments, so that an invocation passing the same host memory
+// again reuses the device buffers instead of creating new ones.
+class device {
+ public:
+  explicit device(const std::string& bitstream) : bitstream_(bitstream) {
+    const auto tic = std::chrono::steady_clock::now();
+    instance_ = std::make_unique<fpga::Instance>(bitstream);
+    const auto toc = std::chrono::steady_clock::now();
+    program_time_ns_ =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic)
+            .count();
+  }
+  device(const device&) = delete;
+  device& operator=(const device&) = delete;
+  ~device() { finish_deferred(); }
+
+  const std::string& bitstream() const { return bitstream_; }
+  fpga::Instance& instance() { return *instance_; }
+
+  // Time spent programming the bitstream, in nanoseconds.
+  int64_t program_time_ns() const { return program_time_ns_; }
+
+  // Number of buffer arguments whose device buffer was reused by the last
+  // invocation.
+  int reused_buffer_count() const { return reused_buffer_count_; }
+
+  // Held while an invocation enqueues its work and, unless deferred, until it
+  // finishes; the instance runs one kernel at a time.
+  std::mutex& mutex() { return mtx_; }
+
+  // Defers waiting for the kernel last executed to `finish`, which calls
+  // `Finish()` and returns the kernel time. The next invocation runs it after
+  // enqueuing its host-to-device transfers, so that they overlap the kernel;
+  // the destructor runs it if there is no next invocation.
+  std::future<int64_t> defer_finish(std::function<int64_t()> finish) {
+    deferred_finish_ = std::packaged_task<int64_t()>(std::move(finish));
+    return deferred_finish_.get_future();
+  }
+
+  // Runs the deferred `finish`, if any.
+  void finish_deferred() {
+    if (deferred_finish_.valid()) {
+      deferred_finish_();
+      deferred_finish_ = std::packaged_task<int64_t()>();
+    }
+  }
+
+  // Starts binding the arguments of a new invocation. If `use_dirty_ranges`,
+  // the host memory marked by `tapa::mark_dirty` is taken into account.
+  void begin_invocation(bool use_dirty_ranges) {
+    reused_buffer_count_ = 0;
+    output_resumes_.clear();
+    dirty_ranges_ =
+        use_dirty_ranges ? take_dirty_ranges() : address_ranges();
+  }
+
+  // Binds argument `index` to `buffer`, which wraps `bytes` bytes of host
+  // memory at `addr` that the kernel reads if `is_input` and writes if
+  // `is_output`, unless the argument is already bound to the same host memory
+  // in the same direction.
+  //
+  // Once host memory bound to an argument that the kernel reads is marked
+  // dirty, the argument is tracked, and its host-to-device transfers are
+  // skipped while none of its memory is marked, as the device buffer then
+  // holds the host memory as last transferred or read back. This is only
+  // correct if every modification of tracked host memory is marked, which
+  // cannot be checked here. Outputs are still read back; see `resume_outputs`.
+  template <typename Buffer>
+  void set_buffer(int index, const void* addr, size_t bytes, bool is_input,
+                  bool is_output, Buffer buffer) {
+    if (index >= static_cast<int>(bindings_.size())) {
+      bindings_.resize(index + 1);
+    }
+    auto& binding = bindings_[index];
+    const uint64_t dirty_bytes = get_dirty_bytes(addr, bytes);
+    if (binding.type != nullptr && *binding.type == typeid(Buffer) &&
+        binding.addr == addr && binding.bytes == bytes) {
+      ++reused_buffer_count_;
+      binding.is_tracked |= dirty_bytes > 0;
+      if (binding.is_tracked && dirty_bytes == 0 && is_input) {
+        if (!binding.is_suspended) {
+          binding.is_suspended = suspend_buffer(*instance_, index);
+          if (!binding.is_suspended) {
+            static std::atomic<bool> warned{false};
+            if (!warned.exchange(true)) {
+              LOG(WARNING) << "the FPGA runtime cannot suspend buffers; clean "
+                              "inputs marked by tapa::mark_dirty are still "
+                              "transferred";
+            }
+          }
+        }
+      } else if (binding.is_suspended) {
+        // resumes the transfers
+        instance_->SetArg(index, buffer);
+        binding.is_suspended = false;
+      }
+    } else {
+      instance_->SetArg(index, buffer);
+      binding = {&typeid(Buffer), addr, bytes};
+      binding.is_tracked = dirty_bytes > 0;
+    }
+    binding.is_input = is_input;
+    binding.is_output = is_output;
+    binding.is_write_skipped = binding.is_suspended;
+    binding.dirty_bytes = dirty_bytes;
+    if (binding.is_suspended && is_output) {
+      output_resumes_.push_back([this, index, buffer] {
+        instance_->SetArg(index, buffer);
+        bindings_[index].is_suspended = false;
+      });
+    }
+  }
+
+  // Resumes the transfers of the outputs whose host-to-device transfers are
+  // skipped, so that they are read back. Called after `WriteToDevice()`.
+  void resume_outputs() {
+    for (const auto& resume : output_resumes_) resume();
+    output_resumes_.clear();
+  }
+
+  template <typename T>
+  void set_scalar(int index, T arg) {
+    instance_->SetArg(index, arg);
+  }
+
+  // Returns the bytes transferred for each buffer argument of the last
+  // invocation.
+  std::string get_transfer_report() const {
+    std::ostringstream os;
+    for (size_t i = 0; i < bindings_.size(); ++i) {
+      const auto& binding = bindings_[i];
+      if (binding.type == nullptr) continue;
+      if (os.tellp() > 0) os << "; ";
+      os << "arg #" << i << ": "
+         << (binding.is_input && !binding.is_write_skipped ? binding.bytes : 0)
+         << " B to device";
+      if (binding.is_tracked) os << " (" << binding.dirty_bytes << " B dirty)";
+      os << ", " << (binding.is_output ? binding.bytes : 0)
+         << " B from device";
+    }
+    return os.str();
+  }
+
+ private:
+  struct buffer_binding {
+    // type of the FRT buffer, which encodes the element type and direction
+    const std::type_info* type = nullptr;
+    const void* addr = nullptr;
+    size_t bytes = 0;
+    bool is_input = false;
+    bool is_output = false;
+    // whether the host memory has been marked dirty
+    bool is_tracked = false;
+    // whether the buffer is excluded from transfers
+    bool is_suspended = false;
+    // whether the host-to-device transfer of the last invocation is skipped
+    bool is_write_skipped = false;
+    // bytes marked dirty for the last invocation
+    uint64_t dirty_bytes = 0;
+  };
+
+  uint64_t get_dirty_bytes(const void* addr, size_t bytes) const {
+    const auto begin = reinterpret_cast<uintptr_t>(addr);
+    const auto end = begin + bytes;
+    uint64_t dirty_bytes = 0;
+    for (const auto& range : dirty_ranges_) {
+      if (range.first >= end) break;
+      if (range.second > begin) {
+        dirty_bytes +=
+            std::min(range.second, end) - std::max(range.first, begin);
+      }
+    }
+    return dirty_bytes;
+  }
+
+  const std::string bitstream_;
+  int64_t program_time_ns_ = 0;
+  std::unique_ptr<fpga::Instance> instance_;
+  std::vector<buffer_binding> bindings_;
+  std::vector<std::function<void()>> output_resumes_;
+  int reused_buffer_count_ = 0;
+  address_ranges dirty_ranges_;
+  std::packaged_task<int64_t()> deferred_finish_;
+  std::mutex mtx_;
+};
+
+inline std::mutex& cached_device_mutex() {
+  static std::mutex mtx;
+  return mtx;
+}
+
+inline std::shared_ptr<device>& cached_device() {
+  static std::shared_ptr<device> instance;
+  return instance;
+}
+
+inline std::mutex& async_invocation_mutex() {
+  static std::mutex mtx;
+  return mtx;
+}
+
+// Execution of the kernel of the invocation last started by
+// `tapa::invoke_async`, which the next one waits for.
+inline std::shared_future<void>& last_async_invocation() {
+  static std::shared_future<void> invocation;
+  return invocation;
+}
+
+// Number of invocations started by `tapa::invoke_async` whose kernels are not
+// executed yet.
+inline std::atomic<int>& queued_async_invocations() {
+  static std::atomic<int> count{0};
+  return count;
+}
+
+// Returns whether devices are kept across invocations, which can be disabled
+// with `TAPA_DEVICE_CACHE=0`.
+inline bool is_device_cache_enabled() {
+  static const bool is_enabled = [] {
+    const char* env = getenv("TAPA_DEVICE_CACHE");
+    return env == nullptr || strcmp(env, "0") != 0;
+  }();
+  return is_enabled;
+}
+
+}  // namespace internal
+
+/// Releases the device kept by @c tapa::invoke, if any.
+///
+/// The device programmed for @c tapa::invoke stays programmed afterwards, and
+/// the device buffers of its arguments stay allocated, so that another
+/// invocation of the same bitstream skips programming and reuses the buffers
+/// of arguments passed again with the same host memory. The device is released
+/// when a different bitstream is invoked, when this function is called, and
+/// at exit.
+inline void release_device() {
+  std::unique_lock<std::mutex> lock(internal::cached_device_mutex());
+  internal::cached_device().reset();
+}
+
+/// Marks host memory in [@c begin, @c end) as modified since the last
+/// @c tapa::invoke.
+///
+/// Without marks, every input of the kernel is transferred to the device on
+/// every invocation. Once the host memory of an argument that the kernel reads
+/// (@c tapa::read_only_mmap or @c tapa::read_write_mmap) is marked, the
+/// argument is tracked by the device kept by @c tapa::invoke: it is
+/// transferred to the device only if part of it is marked again before the
+/// invocation, so every later modification by the host must be marked, or the
+/// kernel reads stale data. Outputs are read back on every invocation. The
+/// runtime transfers whole buffers, so a buffer with any marked range is
+/// transferred in full; transfers are skipped only if the runtime supports
+/// @c SuspendBuf.
+template <typename T>
+inline void mark_dirty(const T* begin, const T* end) {
+  std::unique_lock<std::mutex> lock(internal::dirty_ranges_mutex());
+  internal::dirty_ranges().emplace_back(reinterpret_cast<uintptr_t>(begin),
+                                        reinterpret_cast<uintptr_t>(end));
+}
+
+namespace internal {
+
+// Forgets the kept device without releasing it; used by a forked process,
+// which must not share the device of its parent.
+inline void forget_device() {
+  new std::shared_ptr<device>(std::move(cached_device()));
+}
+
+// Returns the device kept for `bitstream`, programming it first if the kept
+// device, if any, is programmed with a different bitstream; `*is_reused` tells
+// which. Always programs a new device if the cache is disabled.
+inline std::shared_ptr<device> acquire_device(const std::string& bitstream,
+                                              bool* is_reused) {
+  if (!is_device_cache_enabled()) {
+    *is_reused = false;
+    return std::make_shared<device>(bitstream);
+  }
+  std::unique_lock<std::mutex> lock(cached_device_mutex());
+  auto& cached = cached_device();
+  *is_reused = cached != nullptr && cached->bitstream() == bitstream;
+  if (!*is_reused) {
+    // release the old device before programming the new one
+    cached.reset();
+    cached = std::make_shared<device>(bitstream);
+    // registered after the runtime's own static objects are created so that
+    // the device is released before they are destroyed
+    static const int _ = std::atexit(release_device);
+    (void)_;
+  }
+  return cached;
+}
+
+}  // namespace internal
+
+}  // namespace tapa
+
+#endif  // TAPA_HOST_DEVICE_H_
@@ -0,0 +1,135 @@
+#ifndef TAPA_HOST_MEMORY_MODEL_H_
+#define TAPA_HOST_MEMORY_MODEL_H_
+
+#include <cstdint>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tapa {
+
+/// Timing model of one off-chip memory channel.
+///
+/// In software simulation, memory is served instantly. With a memory model
+/// set, every @c tapa::async_mmap is treated as a separate channel and its
+/// bursts are replayed on the model, assuming a kernel that issues requests as
+/// fast as the channel accepts them. At the end of @c tapa::invoke, the
+/// estimated cycles of each channel are reported; the slowest channel bounds
+/// the kernel time of memory-bound designs.
+///
+/// Accesses through @c tapa::mmap are plain pointer dereferences and cannot be
+/// modeled.
+struct memory_model {
+  /// Name of the model used in reports.
+  std::string name;
+
+  /// Kernel clock frequency in MHz, in which cycles are counted.
+  double frequency_mhz;
+
+  /// Cycles from issuing a request until its first data beat.
+  int latency;
+
+  /// Peak bandwidth of the channel in bytes per kernel cycle.
+  double bytes_per_cycle;
+
+  /// Maximum number of requests in flight.
+  int max_outstanding;
+
+  /// Fraction of the peak bandwidth reached by bursts of at least the given
+  /// number of bytes, sorted by bytes.
+  std::vector<std::pair<uint64_t, double>> burst_efficiency;
+
+  /// Maximum bytes in one burst; longer bursts are split.
+  uint64_t max_burst_bytes = 4096;
+
+  /// Returns the fraction of the peak bandwidth reached by a burst.
+  double get_efficiency(uint64_t burst_bytes) const;
+
+  /// One pseudo-channel of the Alveo U280 HBM2 at a 300 MHz kernel clock.
+  static memory_model u280_hbm();
+
+  /// One DDR4-2400 channel at a 300 MHz kernel clock.
+  static memory_model ddr4();
+};
+
+/// Models every @c tapa::async_mmap scheduled afterwards with @c model.
+///
+/// Without a call to this function, the @c TAPA_MEMORY_MODEL environment
+/// variable may select a preset, either `hbm` or `ddr4`.
+void set_memory_model(const memory_model& model);
+
+/// Stops modeling @c tapa::async_mmap scheduled afterwards.
+void reset_memory_model();
+
+namespace internal {
+
+// Replays the bursts of one async_mmap on a memory_model.
+class memory_channel {
+ public:
+  explicit memory_channel(const memory_model& model) : model_(model) {}
+
+  // Sets the `tapa::access_pattern` of the reads of elements of `elem_bytes`
+  // bytes.
+  void set_read_pattern(uint64_t elem_bytes, int max_gap, int cache_depth) {
+    elem_bytes_ = elem_bytes;
+    max_read_gap_ = max_gap;
+    read_cache_depth_ = cache_depth;
+  }
+
+  // Records an access to `bytes` consecutive bytes at byte address `addr`;
+  // accesses continuing the previous one in the same direction are merged
+  // into one burst, as the RTL does. Reads are also merged over gaps and
+  // served from the most recent elements as allowed by the access pattern.
+  void access(uint64_t addr, uint64_t bytes, bool is_write);
+
+  // Replays the pending burst.
+  void flush();
+
+  const memory_model& model() const { return model_; }
+  uint64_t read_bytes() const { return read_bytes_; }
+  uint64_t write_bytes() const { return write_bytes_; }
+  uint64_t bursts() const { return bursts_; }
+  // bytes fetched over read gaps and dropped
+  uint64_t skipped_bytes() const { return skipped_bytes_; }
+  // bytes read from the most recent elements without fetching
+  uint64_t cached_bytes() const { return cached_bytes_; }
+  // cycle at which the last burst completes
+  double cycles() const { return bus_free_; }
+
+ private:
+  void access_burst(uint64_t bytes);
+
+  const memory_model model_;
+  uint64_t pending_addr_ = 0;
+  uint64_t pending_bytes_ = 0;
+  bool pending_is_write_ = false;
+  // start of the burst that the pending bytes belong to
+  uint64_t burst_addr_ = 0;
+  uint64_t elem_bytes_ = 1;
+  int max_read_gap_ = 0;
+  int read_cache_depth_ = 0;
+  uint64_t skipped_bytes_ = 0;
+  uint64_t cached_bytes_ = 0;
+  uint64_t read_bytes_ = 0;
+  uint64_t write_bytes_ = 0;
+  uint64_t bursts_ = 0;
+  // cycle at which the data bus becomes free
+  double bus_free_ = 0;
+  // completion cycles of the requests in flight, as a ring buffer
+  std::vector<double> completions_;
+  size_t next_completion_ = 0;
+};
+
+// Returns a new channel if a memory model is set, nullptr otherwise.
+std::shared_ptr<memory_channel> create_memory_channel();
+
+// Logs and forgets the channels created since the last report.
+void report_memory_channels();
+
+}  // namespace internal
+
+}  // namespace tapa
+
+#endif  // TAPA_HOST_MEMORY_MODEL_H_
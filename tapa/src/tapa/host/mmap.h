@@ -3,8 +3,11 @@
 
 #include <cstddef>
 
+#include <algorithm>
+#include <memory>
 #include <queue>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
@@ -13,6 +16,8 @@
 #include "tapa/base/mmap.h"
 
 #include "tapa/host/coroutine.h"
+#include "tapa/host/device.h"
+#include "tapa/host/memory_model.h"
 #include "tapa/host/stream.h"
 #include "tapa/host/vec.h"
 
@@ -23,9 +28,14 @@ namespace internal {
 template <typename Param, typename Arg>
 struct accessor;
 
+// Maps the file at `path` privately and copy-on-write, and returns its address
+// and size in `bytes`, or nullptr for an empty file.
+void* map_file(const std::string& path, size_t* bytes);
+void unmap_file(const void* addr, size_t bytes);
+
 }  // namespace internal
 
-template <typename T>
+template <typename T, typename Pattern = access_pattern<>>
 class async_mmap;
 
 /// Defines a view of a piece of consecutive memory with synchronous random
@@ -97,6 +107,17 @@ class mmap {
   /// @return The size of the mapped memory (in unit of element count).
   uint64_t size() const { return size_; }
 
+  /// Marks elements [@c begin, @c end) as modified on the host since the last
+  /// @c tapa::invoke; see @c tapa::mark_dirty.
+  ///
+  /// This should be used on the host only.
+  ///
+  /// @param begin Index of the first modified element.
+  /// @param end   Index past the last modified element.
+  void mark_dirty(uint64_t begin, uint64_t end) const {
+    tapa::mark_dirty(get() + begin, get() + end);
+  }
+
   /// Reinterprets the element type of the mapped memory as
   /// <tt>tapa::vec_t<T, N></tt>.
   ///
@@ -170,7 +191,10 @@ class mmap {
 
 /// Defines a view of a piece of consecutive memory with asynchronous random
 /// accesses.
-template <typename T>
+///
+/// @tparam T       Element type.
+/// @tparam Pattern Access pattern of the reads; see @c tapa::access_pattern.
+template <typename T, typename Pattern>
 class async_mmap : public mmap<T> {
  public:
   /// Type of the addresses.
@@ -188,6 +212,26 @@ class async_mmap : public mmap<T> {
   stream<T, 64> write_data_q_{"write_data"};
   stream<resp_t, 64> write_resp_q_{"write_resp"};
 
+  // timing model of the memory channel, if any
+  std::shared_ptr<internal::memory_channel> channel_;
+
+  // Returns the number of consecutive addresses starting at `addrs`, up to `n`,
+  // after checking that they are all inside the mapped memory.
+  uint64_t get_burst_length(const internal::elem_t<addr_t>* addrs,
+                            uint64_t n) const {
+    uint64_t length = 1;
+    while (length < n && addrs[length].val == addrs[0].val + addr_t(length)) {
+      ++length;
+    }
+    const addr_t first = addrs[0].val;
+    const addr_t last = first + addr_t(length) - 1;
+    CHECK_GE(first, 0);
+    if (last != 0) {
+      CHECK_LT(last, this->size_);
+    }
+    return length;
+  }
+
   // Only convert when scheduled.
   async_mmap(const super& mem)
       : super(mem),
@@ -213,9 +257,9 @@ class async_mmap : public mmap<T> {
   T operator--(int) { return *super::ptr_--; }
 
   // Arithmetic not permitted.
-  async_mmap<T> operator+(std::ptrdiff_t diff) { return super::ptr_ + diff; }
-  async_mmap<T> operator-(std::ptrdiff_t diff) { return super::ptr_ - diff; }
-  std::ptrdiff_t operator-(async_mmap<T> ptr) { return super::ptr_ - ptr; }
+  async_mmap operator+(std::ptrdiff_t diff) { return super::ptr_ + diff; }
+  async_mmap operator-(std::ptrdiff_t diff) { return super::ptr_ - diff; }
+  std::ptrdiff_t operator-(async_mmap ptr) { return super::ptr_ - ptr; }
 
  public:
   /// Provides access to the <i>read address</i> channel.
@@ -249,29 +293,85 @@ class async_mmap : public mmap<T> {
   istream<resp_t> write_resp;
 
   void operator()() {
+    // Requests are drained in batches of up to one queue depth. Runs of
+    // consecutive addresses in a batch are bounds-checked once and copied as a
+    // single burst. Drained requests wait in the batch until their read data
+    // fit in read_data_q_ or their write data arrive, like outstanding
+    // requests of the memory system.
+    constexpr uint64_t kBatchSize = 64;
+    constexpr int16_t kMaxWriteCount = 256;
+    internal::elem_t<addr_t> read_addrs[kBatchSize];
+    internal::elem_t<T> read_data[kBatchSize];
+    uint64_t read_begin = 0;
+    uint64_t read_end = 0;
+    internal::elem_t<addr_t> write_addrs[kBatchSize];
+    internal::elem_t<T> write_data[kBatchSize];
+    uint64_t write_addr_count = 0;
     int16_t write_count = 0;
+    const std::string idle_msg =
+        "async_mmap of '" + read_addr_q_.get_name() + "' is idle";
     for (;;) {
-      if (!read_addr_q_.empty() && !read_data_q_.full()) {
-        const auto addr = read_addr_q_.read();
-        CHECK_GE(addr, 0);
-        if (addr != 0) {
-          CHECK_LT(addr, this->size_);
+      bool is_active = false;
+      bool is_writing = false;
+
+      if (read_begin == read_end) {
+        read_begin = 0;
+        read_end = read_addr_q_.pop_n(read_addrs, kBatchSize);
+        for (uint64_t i = 0; i < read_end;) {
+          const uint64_t n = get_burst_length(read_addrs + i, read_end - i);
+          if (channel_) channel_->access(read_addrs[i].val * sizeof(T),
+                                          n * sizeof(T), /*is_write=*/false);
+          const T* src = this->ptr_ + read_addrs[i].val;
+          for (uint64_t j = 0; j < n; ++j) {
+            read_data[i + j] = {src[j], false};
+          }
+          i += n;
+        }
+      }
+      if (read_begin != read_end) {
+        const uint64_t n = read_data_q_.push_n(read_data + read_begin,
+                                               read_end - read_begin);
+        read_begin += n;
+        is_active |= n > 0;
+      }
+
+      if (write_count != kMaxWriteCount) {
+        write_addr_count += write_addr_q_.pop_n(
+            write_addrs + write_addr_count,
+            std::min<uint64_t>(kBatchSize,
+                               kMaxWriteCount - write_count) -
+                write_addr_count);
+        const uint64_t count =
+            write_data_q_.pop_n(write_data, write_addr_count);
+        for (uint64_t i = 0; i < count;) {
+          const uint64_t n = get_burst_length(write_addrs + i, count - i);
+          if (channel_) channel_->access(write_addrs[i].val * sizeof(T),
+                                          n * sizeof(T), /*is_write=*/true);
+          T* dst = this->ptr_ + write_addrs[i].val;
+          for (uint64_t j = 0; j < n; ++j) {
+            dst[j] = write_data[i + j].val;
+          }
+          i += n;
         }
-        read_data_q_.write(this->ptr_[addr]);
+        std::copy(write_addrs + count, write_addrs + write_addr_count,
+                  write_addrs);
+        write_addr_count -= count;
+        write_count += count;
+        is_writing = count > 0;
+        is_active |= is_writing;
       }
-      if (write_count != 256 && !write_addr_q_.empty() &&
-          !write_data_q_.empty()) {
-        const auto addr = write_addr_q_.read();
-        CHECK_GE(addr, 0);
-        if (addr != 0) {
-          CHECK_LT(addr, this->size_);
+      // acknowledge once no more writes are available, as the RTL does
+      if (write_count > 0 &&
+          (write_count == kMaxWriteCount || !is_writing)) {
+        const internal::elem_t<resp_t> resp{resp_t(write_count - 1), false};
+        if (write_resp_q_.push_n(&resp, 1) == 1) {
+          write_count = 0;
+          is_active = true;
         }
-        this->ptr_[addr] = write_data_q_.read();
-        ++write_count;
-      } else if (write_count > 0 &&
-                 this->write_resp_q_.try_write(resp_t(write_count - 1))) {
-        CHECK_LE(write_count, 256);
-        write_count = 0;
+      }
+
+      if (!is_active) {
+        internal::yield(idle_msg);
       }
     }
   }
@@ -279,6 +379,11 @@ class async_mmap : public mmap<T> {
   static async_mmap schedule(super mem) {
     // a copy of async_mem is stored in std::function<void()>
     async_mmap async_mem(mem);
+    async_mem.channel_ = internal::create_memory_channel();
+    if (async_mem.channel_) {
+      async_mem.channel_->set_read_pattern(sizeof(T), Pattern::kMaxGap,
+                                           Pattern::kCacheDepth);
+    }
     internal::schedule(/*detach=*/true, async_mem);
     return async_mem;
   }
@@ -477,22 +582,95 @@ TAPA_DEFINE_MMAPS(write_only);
 TAPA_DEFINE_MMAPS(read_write);
 #undef TAPA_DEFINE_MMAPS
 
+/// Maps a file into host memory, which is paged in lazily on access instead of
+/// being read up front.
+///
+/// A @c tapa::file_mmap holds the file contents as an array of @c T, and can
+/// be used wherever a container constructs a @c tapa::mmap, e.g.,
+/// <tt>tapa::read_only_mmap<const T>(file)</tt>. The mapping is page-aligned,
+/// as required for device transfers.
+///
+/// This should be used on the host only.
+///
+/// The file is mapped copy-on-write, so modifications are private to the
+/// process and never written back to the file. This holds even if @c T is
+/// const, because the FPGA runtime pins the host pages of a transfer for
+/// writing, which fails on read-only pages; pinning may copy the pages.
+///
+/// @tparam T Element type.
+template <typename T>
+class file_mmap {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "T must be trivially copyable");
+
+ public:
+  /// Maps the file at @c path, whose size must be a multiple of @c sizeof(T).
+  ///
+  /// @param path Path to the file.
+  explicit file_mmap(const std::string& path) {
+    size_t bytes = 0;
+    ptr_ = static_cast<T*>(internal::map_file(path, &bytes));
+    size_ = bytes / sizeof(T);
+    if (bytes % sizeof(T) != 0) {
+      internal::unmap_file(ptr_, bytes);
+      LOG(FATAL) << "size of " << path << " must be a multiple of sizeof(T) = "
+                 << sizeof(T) << "; got " << bytes << " bytes";
+    }
+  }
+  file_mmap(file_mmap&& other) noexcept
+      : ptr_{other.ptr_}, size_{other.size_} {
+    other.ptr_ = nullptr;
+    other.size_ = 0;
+  }
+  file_mmap& operator=(file_mmap&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      ptr_ = other.ptr_;
+      size_ = other.size_;
+      other.ptr_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+  file_mmap(const file_mmap&) = delete;
+  file_mmap& operator=(const file_mmap&) = delete;
+  ~file_mmap() { unmap(); }
+
+  /// Retrieves the start of the mapped file.
+  T* data() const { return ptr_; }
+
+  /// Retrieves the size of the mapped file (in unit of element count).
+  uint64_t size() const { return size_; }
+
+  T* begin() const { return ptr_; }
+  T* end() const { return ptr_ + size_; }
+  T& operator[](uint64_t idx) const { return ptr_[idx]; }
+
+ private:
+  void unmap() {
+    if (ptr_ != nullptr) internal::unmap_file(ptr_, size_ * sizeof(T));
+  }
+
+  T* ptr_ = nullptr;
+  uint64_t size_ = 0;
+};
+
 namespace internal {
 
-template <typename T>
-struct accessor<async_mmap<T>, mmap<T>&> {
+template <typename T, typename Pattern>
+struct accessor<async_mmap<T, Pattern>, mmap<T>&> {
   [[deprecated("please use async_mmap<T>& in formal parameters")]]  //
-  static async_mmap<T>
+  static async_mmap<T, Pattern>
   access(mmap<T>& arg) {
     LOG_FIRST_N(ERROR, 1) << "please use async_mmap<T>& in formal parameters";
-    return async_mmap<T>::schedule(arg);
+    return async_mmap<T, Pattern>::schedule(arg);
   }
 };
 
-template <typename T>
-struct accessor<async_mmap<T>&, mmap<T>&> {
-  static async_mmap<T> access(mmap<T>& arg) {
-    return async_mmap<T>::schedule(arg);
+template <typename T, typename Pattern>
+struct accessor<async_mmap<T, Pattern>&, mmap<T>&> {
+  static async_mmap<T, Pattern> access(mmap<T>& arg) {
+    return async_mmap<T, Pattern>::schedule(arg);
   }
 };
 
@@ -501,48 +679,60 @@ struct accessor<mmap<T>, mmaps<T, S>&> {
   static mmap<T> access(mmaps<T, S>& arg) { return arg.access(); }
 };
 
-template <typename T, uint64_t S>
-struct accessor<async_mmap<T>, mmaps<T, S>&> {
+template <typename T, typename Pattern, uint64_t S>
+struct accessor<async_mmap<T, Pattern>, mmaps<T, S>&> {
   [[deprecated("please use async_mmap<T>& in formal parameters")]]  //
-  static async_mmap<T>
+  static async_mmap<T, Pattern>
   access(mmaps<T, S>& arg) {
     LOG_FIRST_N(ERROR, 1) << "please use async_mmap<T>& in formal parameters";
-    return async_mmap<T>::schedule(arg.access());
+    return async_mmap<T, Pattern>::schedule(arg.access());
   }
 };
 
-template <typename T, uint64_t S>
-struct accessor<async_mmap<T>&, mmaps<T, S>&> {
-  static async_mmap<T> access(mmaps<T, S>& arg) {
-    return async_mmap<T>::schedule(arg.access());
+template <typename T, typename Pattern, uint64_t S>
+struct accessor<async_mmap<T, Pattern>&, mmaps<T, S>&> {
+  static async_mmap<T, Pattern> access(mmaps<T, S>& arg) {
+    return async_mmap<T, Pattern>::schedule(arg.access());
   }
 };
 
-#define TAPA_DEFINE_ACCESSER(tag, frt_tag)                     \
-  template <typename T>                                        \
-  struct accessor<mmap<T>, tag##_mmap<T>> {                    \
-    static mmap<T> access(tag##_mmap<T> arg) { return arg; }   \
-    static void access(fpga::Instance& instance, int& idx,     \
-                       tag##_mmap<T> arg) {                    \
-      auto buf = fpga::frt_tag(arg.get(), arg.size());         \
-      instance.SetArg(idx++, buf);                             \
-    }                                                          \
-  };                                                           \
-  template <typename T, uint64_t S>                            \
-  struct accessor<mmaps<T, S>, tag##_mmaps<T, S>> {            \
-    static void access(fpga::Instance& instance, int& idx,     \
-                       tag##_mmaps<T, S> arg) {                \
-      for (uint64_t i = 0; i < S; ++i) {                       \
-        auto buf = fpga::frt_tag(arg[i].get(), arg[i].size()); \
-        instance.SetArg(idx++, buf);                           \
-      }                                                        \
-    }                                                          \
+#define TAPA_DEFINE_ACCESSER(tag, frt_tag, is_input, is_output)             \
+  template <typename T>                                                    \
+  struct accessor<mmap<T>, tag##_mmap<T>> {                                \
+    static mmap<T> access(tag##_mmap<T> arg) { return arg; }               \
+    static void access(device& dev, int& idx, tag##_mmap<T> arg) {         \
+      dev.set_buffer(idx++, arg.get(), arg.size() * sizeof(T), is_input,   \
+                     is_output, fpga::frt_tag(arg.get(), arg.size()));     \
+    }                                                                      \
+    static void get_host_memory(tag##_mmap<T> arg, address_ranges& ranges) { \
+      if (!is_input && !is_output) return;                                 \
+      const auto addr = reinterpret_cast<uintptr_t>(arg.get());            \
+      ranges.emplace_back(addr, addr + arg.size() * sizeof(T));            \
+    }                                                                      \
+  };                                                                       \
+  template <typename T, uint64_t S>                                        \
+  struct accessor<mmaps<T, S>, tag##_mmaps<T, S>> {                        \
+    static void access(device& dev, int& idx, tag##_mmaps<T, S> arg) {     \
+      for (uint64_t i = 0; i < S; ++i) {                                   \
+        dev.set_buffer(idx++, arg[i].get(), arg[i].size() * sizeof(T),     \
+                       is_input, is_output,                                \
+                       fpga::frt_tag(arg[i].get(), arg[i].size()));        \
+      }                                                                    \
+    }                                                                      \
+    static void get_host_memory(tag##_mmaps<T, S> arg,                     \
+                                address_ranges& ranges) {                  \
+      if (!is_input && !is_output) return;                                 \
+      for (uint64_t i = 0; i < S; ++i) {                                   \
+        const auto addr = reinterpret_cast<uintptr_t>(arg[i].get());       \
+        ranges.emplace_back(addr, addr + arg[i].size() * sizeof(T));       \
+      }                                                                    \
+    }                                                                      \
   }
-TAPA_DEFINE_ACCESSER(placeholder, Placeholder);
+TAPA_DEFINE_ACCESSER(placeholder, Placeholder, false, false);
 // read/write are with respect to the kernel in tapa but host in frt
-TAPA_DEFINE_ACCESSER(read_only, WriteOnly);
-TAPA_DEFINE_ACCESSER(write_only, ReadOnly);
-TAPA_DEFINE_ACCESSER(read_write, ReadWrite);
+TAPA_DEFINE_ACCESSER(read_only, WriteOnly, true, false);
+TAPA_DEFINE_ACCESSER(write_only, ReadOnly, false, true);
+TAPA_DEFINE_ACCESSER(read_write, ReadWrite, true, true);
 #undef TAPA_DEFINE_ACCESSER
 template <typename T>
 struct accessor<mmap<T>, mmap<T>> {
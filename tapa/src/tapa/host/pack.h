@@ -0,0 +1,217 @@
+#ifndef TAPA_HOST_PACK_H_
+#define TAPA_HOST_PACK_H_
+
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+
+#include <glog/logging.h>
+
+#include "tapa/host/mmap.h"
+#include "tapa/host/util.h"
+#include "tapa/host/vec.h"
+
+namespace tapa {
+
+// Host-only routines that copy data between the layout used by the host and
+// the layout expected by the kernel. Unlike `vectorized()` and
+// `reinterpret()`, which only re-view memory whose layout already matches,
+// these copy, split over all hardware threads in contiguous chunks so that
+// the inner loops are plain sequential copies.
+
+namespace internal {
+
+// Minimum number of elements copied by each thread.
+constexpr uint64_t kPackGrain = 64 * 1024;
+
+// Returns the pointers to the channels of `arg`, checking that they can hold
+// an array of `n` elements.
+template <typename T, uint64_t S>
+inline std::array<T*, S> get_striped_channels(mmaps<T, S>& arg, uint64_t n,
+                                              uint64_t granularity) {
+  std::array<T*, S> channels;
+  for (uint64_t ch = 0; ch < S; ++ch) {
+    CHECK_GE(arg[ch].size(), get_striped_channel_size(n, S, granularity, ch))
+        << "channel " << ch << " is too small";
+    channels[ch] = arg[ch].get();
+  }
+  return channels;
+}
+
+// Calls `func(begin, count, ch, offset)` for every block of an array of `n`
+// elements, where `count` elements starting from index `begin` of the array
+// are stored from index `offset` of channel `ch`. Rounds of S blocks are split
+// among threads so that each thread reads the array sequentially.
+template <uint64_t S, typename Func>
+inline void for_each_striped_block(uint64_t n, uint64_t granularity,
+                                   const Func& func) {
+  const uint64_t round_size = granularity * S;
+  parallel_for(
+      (n + round_size - 1) / round_size,
+      [&](uint64_t round) {
+        for (uint64_t ch = 0; ch < S; ++ch) {
+          const uint64_t begin = round * round_size + ch * granularity;
+          if (begin >= n) break;
+          func(begin, std::min(granularity, n - begin), ch,
+               round * granularity);
+        }
+      },
+      std::max<uint64_t>(kPackGrain / round_size, 1));
+}
+
+}  // namespace internal
+
+/// Writes <tt>func(src[i])</tt> to @c dst[i] for every @c i in [0, @c n), in
+/// parallel. Suits custom bit packing of host records into device words.
+///
+/// @param src  Input elements.
+/// @param n    Number of elements.
+/// @param dst  Output elements; must not overlap with @c src.
+/// @param func Function converting one element, called concurrently.
+template <typename T, typename U, typename Func>
+inline void parallel_transform(const T* src, uint64_t n, U* dst,
+                               const Func& func) {
+  internal::parallel_for(
+      n, [&](uint64_t i) { dst[i] = func(src[i]); }, internal::kPackGrain);
+}
+
+/// Packs @c n elements into <tt>ceil(n / N)</tt> vectors of @c N elements,
+/// padding the last vector with @c pad.
+///
+/// @param src Input elements.
+/// @param n   Number of elements.
+/// @param dst Output vectors.
+/// @param pad Value of the padding elements.
+template <int N, typename T>
+inline void pack(const T* src, uint64_t n, vec_t<T, N>* dst,
+                 const T& pad = T()) {
+  const uint64_t vec_count = (n + N - 1) / N;
+  internal::parallel_for(
+      vec_count,
+      [&](uint64_t i) {
+        const uint64_t begin = i * N;
+        const uint64_t count = std::min<uint64_t>(N, n - begin);
+        for (int j = 0; j < N; ++j) {
+          dst[i][j] = uint64_t(j) < count ? src[begin + j] : pad;
+        }
+      },
+      internal::kPackGrain / N);
+}
+
+/// Packs the elements of @c src into the vectors of @c dst, which must have
+/// at least <tt>ceil(src.size() / N)</tt> vectors.
+template <int N, typename T>
+inline void pack(mmap<const T> src, mmap<vec_t<T, N>> dst,
+                 const T& pad = T()) {
+  CHECK_GE(dst.size() * N, src.size());
+  pack<N>(src.get(), src.size(), dst.get(), pad);
+}
+
+/// Packs the elements of a non-const @c src as the overload above does.
+template <int N, typename T>
+inline void pack(mmap<T> src, mmap<vec_t<T, N>> dst, const T& pad = T()) {
+  pack<N>(mmap<const T>(src.get(), src.size()), dst, pad);
+}
+
+/// Unpacks the first @c n elements of vectors of @c N elements.
+///
+/// @param src Input vectors.
+/// @param n   Number of elements.
+/// @param dst Output elements.
+template <int N, typename T>
+inline void unpack(const vec_t<T, N>* src, uint64_t n, T* dst) {
+  internal::parallel_for(
+      (n + N - 1) / N,
+      [&](uint64_t i) {
+        const uint64_t begin = i * N;
+        const uint64_t count = std::min<uint64_t>(N, n - begin);
+        for (uint64_t j = 0; j < count; ++j) dst[begin + j] = src[i][j];
+      },
+      internal::kPackGrain / N);
+}
+
+/// Transposes a row-major matrix of @c rows x @c cols elements into a
+/// row-major matrix of @c cols x @c rows elements, i.e., converts between
+/// row-major and column-major layouts.
+///
+/// The matrix is processed in square tiles so that both the reads and the
+/// writes stay within a few cache lines.
+///
+/// @param src  Input matrix.
+/// @param rows Number of rows of @c src.
+/// @param cols Number of columns of @c src.
+/// @param dst  Output matrix; must not overlap with @c src.
+template <typename T>
+inline void transpose(const T* src, uint64_t rows, uint64_t cols, T* dst) {
+  constexpr uint64_t kTile = 64;
+  const uint64_t row_tiles = (rows + kTile - 1) / kTile;
+  internal::parallel_for(
+      row_tiles,
+      [&](uint64_t tile) {
+        const uint64_t row_end = std::min(rows, (tile + 1) * kTile);
+        for (uint64_t col = 0; col < cols; col += kTile) {
+          const uint64_t col_end = std::min(cols, col + kTile);
+          for (uint64_t r = tile * kTile; r < row_end; ++r) {
+            for (uint64_t c = col; c < col_end; ++c) {
+              dst[c * rows + r] = src[r * cols + c];
+            }
+          }
+        }
+      },
+      std::max<uint64_t>(internal::kPackGrain / kTile / (cols + 1), 1));
+}
+
+/// Interleaves @c n elements across the channels of @c dst in blocks of
+/// @c granularity elements, as laid out by @c tapa::striped_layout: block
+/// @c b is copied to block <tt>b / S</tt> of channel <tt>b % S</tt>. Elements
+/// of the channels past the data are left unchanged.
+///
+/// @param src         Input elements.
+/// @param n           Number of elements.
+/// @param dst         Output channels, each large enough for its blocks.
+/// @param granularity Number of consecutive elements stored in one channel.
+template <typename T, uint64_t S>
+inline void interleave(const T* src, uint64_t n, mmaps<T, S> dst,
+                       uint64_t granularity = 1) {
+  const auto channels = internal::get_striped_channels(dst, n, granularity);
+  internal::for_each_striped_block<S>(
+      n, granularity, [&](uint64_t begin, uint64_t count, uint64_t ch,
+                          uint64_t offset) {
+        std::copy_n(src + begin, count, channels[ch] + offset);
+      });
+}
+
+/// Interleaves @c n elements as @c tapa::interleave does, converting each
+/// element with @c func on the way, e.g., to encode host records as device
+/// words in a single pass.
+///
+/// @param func Function converting one element, called concurrently.
+template <typename T, typename U, uint64_t S, typename Func>
+inline void interleave(const U* src, uint64_t n, mmaps<T, S> dst,
+                       uint64_t granularity, const Func& func) {
+  const auto channels = internal::get_striped_channels(dst, n, granularity);
+  internal::for_each_striped_block<S>(
+      n, granularity, [&](uint64_t begin, uint64_t count, uint64_t ch,
+                          uint64_t offset) {
+        std::transform(src + begin, src + begin + count,
+                       channels[ch] + offset, func);
+      });
+}
+
+/// Reverses @c tapa::interleave, copying @c n elements from the channels of
+/// @c src to @c dst in array order.
+template <typename T, uint64_t S>
+inline void deinterleave(mmaps<T, S> src, uint64_t n, T* dst,
+                         uint64_t granularity = 1) {
+  const auto channels = internal::get_striped_channels(src, n, granularity);
+  internal::for_each_striped_block<S>(
+      n, granularity, [&](uint64_t begin, uint64_t count, uint64_t ch,
+                          uint64_t offset) {
+        std::copy_n(channels[ch] + offset, count, dst + begin);
+      });
+}
+
+}  // namespace tapa
+
+#endif  // TAPA_HOST_PACK_H_
@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <cstring>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <deque>
@@ -93,6 +94,26 @@ class lock_free_queue : public base_queue {
     ++this->head;
   }
 
+  // batched operations; return the number of elements actually moved
+  uint64_t pop_n(T* vals, uint64_t n) {
+    const uint64_t tail = this->tail;
+    n = std::min<uint64_t>(n, this->head - tail);
+    for (uint64_t i = 0; i < n; ++i) {
+      vals[i] = this->buffer[(tail + i) % buffer.size()];
+    }
+    this->tail = tail + n;
+    return n;
+  }
+  uint64_t push_n(const T* vals, uint64_t n) {
+    const uint64_t head = this->head;
+    n = std::min<uint64_t>(n, buffer.size() - (head - this->tail));
+    for (uint64_t i = 0; i < n; ++i) {
+      this->buffer[(head + i) % buffer.size()] = vals[i];
+    }
+    this->head = head + n;
+    return n;
+  }
+
   ~lock_free_queue() { this->check_leftover(); }
 };
 
@@ -134,6 +155,22 @@ class locked_queue : public base_queue {
     this->buffer.push_back(val);
   }
 
+  // batched operations; return the number of elements actually moved
+  uint64_t pop_n(T* vals, uint64_t n) {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    n = std::min<uint64_t>(n, this->buffer.size());
+    std::copy_n(this->buffer.begin(), n, vals);
+    this->buffer.erase(this->buffer.begin(), this->buffer.begin() + n);
+    return n;
+  }
+  uint64_t push_n(const T* vals, uint64_t n) {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    n = std::min<uint64_t>(n, this->depth - std::min(this->depth,
+                                                     this->buffer.size()));
+    this->buffer.insert(this->buffer.end(), vals, vals + n);
+    return n;
+  }
+
   ~locked_queue() { this->check_leftover(); }
 };
 
@@ -580,12 +617,12 @@ template <typename T, uint64_t N = kStreamDefaultDepth>
 class stream : public internal::unbound_stream<T> {
  public:
   /// Depth of the communication channel.
-  constexpr static int depth = N;
+  constexpr static int depth = internal::get_stream_depth(N);
 
   /// Constructs a @c tapa::stream.
   stream()
       : internal::basic_stream<T>(
-            std::make_shared<internal::queue<internal::elem_t<T>>>(N)) {}
+            std::make_shared<internal::queue<internal::elem_t<T>>>(depth)) {}
 
   /// Constructs a @c tapa::stream with the given name for debugging.
   ///
@@ -593,13 +630,25 @@ class stream : public internal::unbound_stream<T> {
   template <size_t S>
   stream(const char (&name)[S])
       : internal::basic_stream<T>(
-            std::make_shared<internal::queue<internal::elem_t<T>>>(N, name)) {}
+            std::make_shared<internal::queue<internal::elem_t<T>>>(depth,
+                                                                   name)) {}
 
  private:
   template <typename U, uint64_t friend_length, uint64_t friend_depth>
   friend class streams;
+  template <typename U, typename Pattern>
+  friend class async_mmap;
   stream(const internal::basic_stream<T>& base)
       : internal::basic_stream<T>(base) {}
+
+  // batched accesses for the emulation of async_mmap, which owns both ends of
+  // its streams; never yields and returns the number of tokens moved
+  uint64_t pop_n(internal::elem_t<T>* elems, uint64_t n) {
+    return this->ptr->pop_n(elems, n);
+  }
+  uint64_t push_n(const internal::elem_t<T>* elems, uint64_t n) {
+    return this->ptr->push_n(elems, n);
+  }
 };
 
 /// Provides consumer-side operations to an array of @c tapa::stream where they
@@ -730,7 +779,7 @@ class streams : public internal::unbound_streams<T, S> {
   constexpr static int length = S;
 
   /// Depth of each @c tapa::stream in the array.
-  constexpr static int depth = N;
+  constexpr static int depth = internal::get_stream_depth(N);
 
   /// Constructs a @c tapa::streams array.
   streams()
@@ -739,7 +788,7 @@ class streams : public internal::unbound_streams<T, S> {
                 "", 0)) {
     for (int i = 0; i < S; ++i) {
       this->ptr->refs.emplace_back(
-          std::make_shared<internal::queue<internal::elem_t<T>>>(N));
+          std::make_shared<internal::queue<internal::elem_t<T>>>(depth));
     }
   }
 
@@ -757,7 +806,7 @@ class streams : public internal::unbound_streams<T, S> {
     for (int i = 0; i < S; ++i) {
       this->ptr->refs.emplace_back(
           std::make_shared<internal::queue<internal::elem_t<T>>>(
-              N, this->ptr->name + "[" + std::to_string(i) + "]"));
+              depth, this->ptr->name + "[" + std::to_string(i) + "]"));
     }
   }
 
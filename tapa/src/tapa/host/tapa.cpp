@@ -1,14 +1,19 @@
 #include "tapa/host/tapa.h"
 
+#include <cerrno>
+#include <climits>
 #include <csignal>
+#include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <deque>
+#include <fstream>
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -16,8 +21,15 @@
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #if TAPA_ENABLE_COROUTINE
 
@@ -385,15 +397,486 @@ task::~task() {
 namespace tapa {
 namespace internal {
 
-void* allocate(size_t length) {
-  void* addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
-                      MAP_SHARED | MAP_ANONYMOUS, /*fd=*/-1, /*offset=*/0);
-  if (addr == MAP_FAILED) throw std::bad_alloc();
+namespace {
+
+// size of explicit and transparent huge pages on x86-64
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+// mempolicy modes from <numaif.h>, which is not always installed
+constexpr int kMpolBind = 2;
+constexpr int kMpolInterleave = 3;
+
+// Shared memory returned by `allocate`, as the end address and the sequence
+// number of each allocation, indexed by the start address.
+std::mutex allocation_mtx;
+std::map<uintptr_t, std::pair<uintptr_t, uint64_t>> allocations;
+uint64_t allocation_count = 0;
+
+page_size GetPageSize(page_size pages) {
+  if (pages != page_size::kDefault) return pages;
+  static const page_size env_pages = [] {
+    const char* env = getenv("TAPA_HUGE_PAGES");
+    if (env == nullptr || *env == '\0' || strcmp(env, "0") == 0) {
+      return page_size::kNormal;
+    }
+    if (strcmp(env, "thp") == 0) return page_size::kTransparentHuge;
+    if (strcmp(env, "1") != 0) {
+      LOG(WARNING) << "unrecognized TAPA_HUGE_PAGES=" << env
+                   << "; expecting 0, thp, or 1";
+    }
+    return page_size::kHuge;
+  }();
+  return env_pages;
+}
+
+int GetNumaNode(int numa_node) {
+  if (numa_node != kNumaDefault) return numa_node;
+  static const int env_node = [] {
+    const char* env = getenv("TAPA_NUMA_NODE");
+    if (env == nullptr || *env == '\0') return kNumaFirstTouch;
+    if (strcmp(env, "interleave") == 0) return kNumaInterleave;
+    char* end;
+    const long node = strtol(env, &end, 10);
+    if (*end != '\0' || node < 0) {
+      LOG(WARNING) << "unrecognized TAPA_NUMA_NODE=" << env
+                   << "; expecting a node id or interleave";
+      return kNumaFirstTouch;
+    }
+    return static_cast<int>(node);
+  }();
+  return env_node;
+}
+
+// huge pages are mapped and unmapped in whole huge pages
+size_t GetMappedLength(size_t length, page_size pages) {
+  if (pages == page_size::kNormal) return length;
+  return (length + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+// Returns whether transparent huge pages may back shared anonymous memory,
+// which the kernel governs separately from private memory.
+bool IsShmemThpEnabled() {
+  static const bool is_enabled = [] {
+    std::ifstream file("/sys/kernel/mm/transparent_hugepage/shmem_enabled");
+    std::string mode;
+    // the selected mode is bracketed, e.g., `always within_size [advise] never`
+    while (file >> mode) {
+      if (mode.front() == '[') return mode != "[never]" && mode != "[deny]";
+    }
+    return false;
+  }();
+  return is_enabled;
+}
+
+// binds the pages before they are touched; best-effort, as the placement does
+// not affect correctness
+void BindToNumaNode(void* addr, size_t length, int numa_node) {
+  if (numa_node == kNumaFirstTouch) return;
+  constexpr int kMaxNodes = sizeof(unsigned long) * CHAR_BIT;
+  unsigned long nodemask = 0;
+  int mode = kMpolBind;
+  if (numa_node == kNumaInterleave) {
+    mode = kMpolInterleave;
+    nodemask = ~0UL;
+  } else if (numa_node < kMaxNodes) {
+    nodemask = 1UL << numa_node;
+  }
+  if (nodemask == 0 ||
+      syscall(SYS_mbind, addr, length, mode, &nodemask, kMaxNodes, 0) != 0) {
+    static std::atomic<bool> warned{false};
+    if (!warned.exchange(true)) {
+      PLOG(WARNING) << "cannot bind host memory to NUMA node " << numa_node;
+    }
+  }
+}
+
+}  // namespace
+
+void* allocate(size_t length, page_size pages, int numa_node, bool is_shared) {
+  pages = GetPageSize(pages);
+  numa_node = GetNumaNode(numa_node);
+  length = GetMappedLength(length, pages);
+  const int flags = (is_shared ? MAP_SHARED : MAP_PRIVATE) | MAP_ANONYMOUS;
+  void* addr = MAP_FAILED;
+  if (pages == page_size::kHuge) {
+    addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB,
+                  /*fd=*/-1, /*offset=*/0);
+    if (addr == MAP_FAILED) {
+      static std::atomic<bool> warned{false};
+      if (!warned.exchange(true)) {
+        LOG(WARNING) << "no explicit huge pages available, falling back to "
+                        "transparent huge pages";
+      }
+    }
+  }
+  if (addr == MAP_FAILED) {
+    addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, /*fd=*/-1,
+                  /*offset=*/0);
+    if (addr == MAP_FAILED) throw std::bad_alloc();
+    if (pages != page_size::kNormal) {
+      ::madvise(addr, length, MADV_HUGEPAGE);
+      if (is_shared && !IsShmemThpEnabled()) {
+        static std::atomic<bool> warned{false};
+        if (!warned.exchange(true)) {
+          LOG(WARNING) << "transparent huge pages are disabled for shared "
+                          "memory by /sys/kernel/mm/transparent_hugepage/"
+                          "shmem_enabled; memory shared with the worker "
+                          "process will use regular pages";
+        }
+      }
+    }
+  }
+  BindToNumaNode(addr, length, numa_node);
+  if (is_shared) {
+    std::unique_lock<std::mutex> lock(allocation_mtx);
+    const auto begin = reinterpret_cast<uintptr_t>(addr);
+    allocations[begin] = {begin + length, ++allocation_count};
+  }
   return addr;
 }
-void deallocate(void* addr, size_t length) {
+void deallocate(void* addr, size_t length, page_size pages) {
+  length = GetMappedLength(length, GetPageSize(pages));
+  {
+    std::unique_lock<std::mutex> lock(allocation_mtx);
+    allocations.erase(reinterpret_cast<uintptr_t>(addr));
+  }
   if (::munmap(addr, length) != 0) throw std::bad_alloc();
 }
 
+void* map_file(const std::string& path, size_t* bytes) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  PCHECK(fd != -1) << "cannot open " << path;
+  struct stat st;
+  PCHECK(fstat(fd, &st) == 0) << "cannot stat " << path;
+  *bytes = st.st_size;
+  void* addr = nullptr;
+  if (*bytes > 0) {
+    // writable even for read-only data, because the runtime pins the pages of
+    // a transfer for writing whatever its direction
+    addr = ::mmap(nullptr, *bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                  /*offset=*/0);
+    PCHECK(addr != MAP_FAILED) << "cannot map " << path;
+  }
+  close(fd);
+  return addr;
+}
+
+void unmap_file(const void* addr, size_t bytes) {
+  if (addr != nullptr) {
+    PCHECK(::munmap(const_cast<void*>(addr), bytes) == 0);
+  }
+}
+
+namespace {
+
+// Maximum bytes of the bitstream path and the arguments of an invocation
+// passed to the worker.
+constexpr size_t kMaxWorkerBitstreamBytes = 4096;
+constexpr size_t kMaxWorkerArgsBytes = 64 * 1024;
+
+// Invocation passed to the worker, in memory shared with it.
+struct worker_request {
+  worker_function run;
+  int64_t kernel_time_ns;
+  char bitstream[kMaxWorkerBitstreamBytes];
+  alignas(kMaxWorkerArgsAlignment) unsigned char args[kMaxWorkerArgsBytes];
+};
+
+// Process running the invocations of `invoke_in_new_process`.
+struct worker_process {
+  pid_t pid = -1;
+  // socket connected to the worker
+  int fd = -1;
+  // allocations made up to its creation are shared with the worker
+  uint64_t allocation_count = 0;
+  worker_request* request = nullptr;
+};
+
+std::mutex worker_mtx;
+worker_process current_worker;
+
+// Returns the sequence number of the allocation holding all of `range`, or 0
+// if no allocation holds it.
+uint64_t GetAllocation(const std::pair<uintptr_t, uintptr_t>& range) {
+  auto it = allocations.upper_bound(range.first);
+  if (it == allocations.begin()) return 0;
+  --it;
+  return range.second <= it->second.first ? it->second.second : 0;
+}
+
+void StopWorker() {
+  if (current_worker.pid == -1) return;
+  // the worker exits once the socket is closed
+  close(current_worker.fd);
+  int status = 0;
+  waitpid(current_worker.pid, &status, 0);
+  current_worker.pid = -1;
+  current_worker.fd = -1;
+}
+
+[[noreturn]] void RunWorker(int fd, worker_request* request) {
+  // the worker programs its own device and has no marked memory
+  forget_device();
+  take_dirty_ranges();
+  char byte;
+  while (read(fd, &byte, 1) == 1) {
+    request->kernel_time_ns = request->run(request->bitstream, request->args);
+    if (write(fd, &byte, 1) != 1) break;
+  }
+  exit(EXIT_SUCCESS);
+}
+
+void StartWorker() {
+  if (current_worker.request == nullptr) {
+    current_worker.request = new (allocate(sizeof(worker_request)))
+        worker_request;
+  }
+  int fds[2];
+  PCHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+  {
+    std::unique_lock<std::mutex> lock(allocation_mtx);
+    current_worker.allocation_count = allocation_count;
+  }
+  const pid_t pid = fork();
+  PCHECK(pid != -1);
+  if (pid == 0) {
+    close(fds[0]);
+    RunWorker(fds[1], current_worker.request);
+  }
+  close(fds[1]);
+  current_worker.pid = pid;
+  current_worker.fd = fds[0];
+  VLOG(1) << "started worker process " << pid;
+}
+
+}  // namespace
+
+bool run_in_worker(worker_function run, const std::string& bitstream,
+                   const void* args, size_t args_bytes,
+                   const address_ranges& buffers, int64_t* kernel_time_ns) {
+  if (bitstream.size() >= kMaxWorkerBitstreamBytes ||
+      args_bytes > kMaxWorkerArgsBytes) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(worker_mtx);
+
+  // buffers must be shared with the worker, which sees only the allocations
+  // made before it is started
+  uint64_t last_allocation = 0;
+  {
+    std::unique_lock<std::mutex> lock(allocation_mtx);
+    for (const auto& range : buffers) {
+      const uint64_t allocation = GetAllocation(range);
+      if (allocation == 0) return false;
+      last_allocation = std::max(last_allocation, allocation);
+    }
+  }
+  if (current_worker.pid != -1 &&
+      (last_allocation > current_worker.allocation_count ||
+       waitpid(current_worker.pid, nullptr, WNOHANG) != 0)) {
+    VLOG(1) << "restarting worker process " << current_worker.pid;
+    StopWorker();
+  }
+  if (current_worker.pid == -1) StartWorker();
+
+  auto& request = *current_worker.request;
+  request.run = run;
+  strcpy(request.bitstream, bitstream.c_str());
+  memcpy(request.args, args, args_bytes);
+  char byte = 0;
+  PCHECK(send(current_worker.fd, &byte, 1, MSG_NOSIGNAL) == 1);
+  ssize_t result;
+  do {
+    result = read(current_worker.fd, &byte, 1);
+  } while (result == -1 && errno == EINTR);
+  if (result != 1) {
+    int status = 0;
+    CHECK_EQ(waitpid(current_worker.pid, &status, 0), current_worker.pid);
+    current_worker.pid = -1;
+    close(current_worker.fd);
+    LOG(FATAL) << "worker process crashed with status " << status;
+  }
+  *kernel_time_ns = request.kernel_time_ns;
+
+  // Xilinx emulation cannot run more than once in each process
+  if (getenv("XCL_EMULATION_MODE") != nullptr) StopWorker();
+  return true;
+}
+
+}  // namespace internal
+}  // namespace tapa
+
+namespace tapa {
+
+double memory_model::get_efficiency(uint64_t burst_bytes) const {
+  double efficiency = burst_efficiency.empty() ? 1. : 0.;
+  for (const auto& [bytes, value] : burst_efficiency) {
+    if (burst_bytes < bytes) break;
+    efficiency = value;
+  }
+  // bursts shorter than the first point still move data
+  if (efficiency == 0.) efficiency = burst_efficiency.front().second;
+  return efficiency;
+}
+
+memory_model memory_model::u280_hbm() {
+  // 256-bit AXI at 450 MHz, i.e., 14.4 GB/s per pseudo-channel
+  return {"U280 HBM pseudo-channel",
+          /*frequency_mhz=*/300,
+          /*latency=*/35,
+          /*bytes_per_cycle=*/48,
+          /*max_outstanding=*/64,
+          /*burst_efficiency=*/
+          {{32, .25}, {64, .5}, {128, .7}, {256, .85}, {512, .95}}};
+}
+
+memory_model memory_model::ddr4() {
+  // 64-bit DDR4-2400, i.e., 19.2 GB/s per channel
+  return {"DDR4-2400 channel",
+          /*frequency_mhz=*/300,
+          /*latency=*/30,
+          /*bytes_per_cycle=*/64,
+          /*max_outstanding=*/32,
+          /*burst_efficiency=*/
+          {{64, .35}, {128, .55}, {256, .75}, {512, .88}, {1024, .95}}};
+}
+
+namespace internal {
+namespace {
+
+std::mutex memory_model_mtx;
+std::unique_ptr<memory_model> current_memory_model;
+bool is_memory_model_initialized = false;
+std::vector<std::shared_ptr<memory_channel>> memory_channels;
+
+}  // namespace
+}  // namespace internal
+
+void set_memory_model(const memory_model& model) {
+  std::unique_lock<std::mutex> lock(internal::memory_model_mtx);
+  internal::current_memory_model = std::make_unique<memory_model>(model);
+  internal::is_memory_model_initialized = true;
+}
+
+void reset_memory_model() {
+  std::unique_lock<std::mutex> lock(internal::memory_model_mtx);
+  internal::current_memory_model.reset();
+  internal::is_memory_model_initialized = true;
+}
+
+namespace internal {
+
+void memory_channel::access(uint64_t addr, uint64_t bytes, bool is_write) {
+  (is_write ? write_bytes_ : read_bytes_) += bytes;
+  const uint64_t end = pending_addr_ + pending_bytes_;
+  if (!is_write && !pending_is_write_ && pending_bytes_ > 0) {
+    if (addr >= burst_addr_ && addr + bytes <= end &&
+        addr + read_cache_depth_ * elem_bytes_ >= end) {
+      // served by the most recent elements of the burst
+      cached_bytes_ += bytes;
+      return;
+    }
+    if (addr > end && addr - end <= max_read_gap_ * elem_bytes_) {
+      // the burst is extended over the gap
+      skipped_bytes_ += addr - end;
+      pending_bytes_ += addr - end;
+    }
+  }
+  if (pending_bytes_ == 0 || is_write != pending_is_write_ ||
+      addr != pending_addr_ + pending_bytes_) {
+    flush();
+    pending_addr_ = addr;
+    burst_addr_ = addr;
+    pending_is_write_ = is_write;
+  }
+  pending_bytes_ += bytes;
+  for (; pending_bytes_ > model_.max_burst_bytes;
+       pending_bytes_ -= model_.max_burst_bytes) {
+    access_burst(model_.max_burst_bytes);
+    pending_addr_ += model_.max_burst_bytes;
+    burst_addr_ = pending_addr_;
+  }
+}
+
+void memory_channel::flush() {
+  if (pending_bytes_ > 0) {
+    access_burst(pending_bytes_);
+    pending_addr_ += pending_bytes_;
+    pending_bytes_ = 0;
+  }
+}
+
+void memory_channel::access_burst(uint64_t bytes) {
+  ++bursts_;
+  if (completions_.empty()) {
+    completions_.resize(std::max(model_.max_outstanding, 1));
+  }
+  // a request is issued once the oldest request in flight has completed
+  const double issue = completions_[next_completion_];
+  const double start = std::max(issue + model_.latency, bus_free_);
+  bus_free_ =
+      start + bytes / (model_.bytes_per_cycle * model_.get_efficiency(bytes));
+  completions_[next_completion_] = bus_free_;
+  next_completion_ = (next_completion_ + 1) % completions_.size();
+}
+
+std::shared_ptr<memory_channel> create_memory_channel() {
+  std::unique_lock<std::mutex> lock(memory_model_mtx);
+  if (!is_memory_model_initialized) {
+    is_memory_model_initialized = true;
+    if (const char* env = getenv("TAPA_MEMORY_MODEL")) {
+      if (strcmp(env, "hbm") == 0) {
+        current_memory_model =
+            std::make_unique<memory_model>(memory_model::u280_hbm());
+      } else if (strcmp(env, "ddr4") == 0) {
+        current_memory_model =
+            std::make_unique<memory_model>(memory_model::ddr4());
+      } else if (*env != '\0') {
+        LOG(WARNING) << "unrecognized TAPA_MEMORY_MODEL=" << env
+                     << "; expecting hbm or ddr4";
+      }
+    }
+  }
+  if (current_memory_model == nullptr) return nullptr;
+  memory_channels.push_back(
+      std::make_shared<memory_channel>(*current_memory_model));
+  return memory_channels.back();
+}
+
+void report_memory_channels() {
+  std::unique_lock<std::mutex> lock(memory_model_mtx);
+  if (memory_channels.empty()) return;
+  double max_cycles = 0;
+  double frequency_mhz = 0;
+  for (size_t i = 0; i < memory_channels.size(); ++i) {
+    auto& channel = *memory_channels[i];
+    channel.flush();
+    const double cycles = channel.cycles();
+    const double seconds = cycles / (channel.model().frequency_mhz * 1e6);
+    const uint64_t bytes = channel.read_bytes() + channel.write_bytes();
+    LOG(INFO) << "async_mmap #" << i << " on " << channel.model().name << ": "
+              << channel.read_bytes() << " bytes read, "
+              << channel.write_bytes() << " bytes written in "
+              << channel.bursts() << " bursts, estimated " << uint64_t(cycles)
+              << " cycles ("
+              << (seconds > 0 ? bytes / seconds * 1e-9 : 0.) << " GB/s)";
+    if (channel.skipped_bytes() > 0 || channel.cached_bytes() > 0) {
+      LOG(INFO) << "async_mmap #" << i << " fetched "
+                << channel.skipped_bytes()
+                << " bytes over read gaps and served "
+                << channel.cached_bytes() << " bytes from recent reads";
+    }
+    if (cycles > max_cycles) {
+      max_cycles = cycles;
+      frequency_mhz = channel.model().frequency_mhz;
+    }
+  }
+  LOG(INFO) << "estimated memory-bound kernel time: " << uint64_t(max_cycles)
+            << " cycles ("
+            << (max_cycles > 0 ? max_cycles / frequency_mhz * 1e-3 : 0.)
+            << " ms)";
+  memory_channels.clear();
+}
+
 }  // namespace internal
 }  // namespace tapa
@@ -5,6 +5,7 @@
 
 #include "tapa/host/coroutine.h"
 #include "tapa/host/mmap.h"
+#include "tapa/host/pack.h"
 #include "tapa/host/stream.h"
 #include "tapa/host/task.h"
 #include "tapa/host/util.h"
@@ -15,8 +16,11 @@
 #include "tapa/host/buffer.h"
 #endif
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <list>
@@ -33,7 +37,8 @@
 namespace tapa {
 
 // Host-only invoke that takes path to a bistream file as an argument. Returns
-// the kernel time in nanoseconds.
+// the kernel time in nanoseconds. The device stays programmed for later
+// invocations of the same bitstream until `tapa::release_device()`.
 template <typename Func, typename... Args>
 inline int64_t invoke(Func&& f, const std::string& bitstream, Args&&... args) {
   static_assert(std::is_function_v<typename std::remove_reference_t<Func>>,
@@ -43,9 +48,41 @@ inline int64_t invoke(Func&& f, const std::string& bitstream, Args&&... args) {
       std::forward<Args>(args)...);
 }
 
+/// Host-only invoke that returns right away and runs the invocation in the
+/// background, so that host work overlaps with the transfers and the kernel.
+/// Like @c tapa::invoke, it runs on the device kept for @c bitstream, which is
+/// programmed once; the kernels of the invocations run one at a time in the
+/// order they are started. The host-to-device transfers of an invocation
+/// overlap the kernel of the previous one if the invocation is started before
+/// that kernel is executed, e.g., when batches are started ahead of time;
+/// otherwise, they wait for that kernel to finish. The host memory of the
+/// arguments must stay valid, and unmodified if the kernel reads it, until the
+/// returned future is ready.
+///
+/// Software simulation (empty @c bitstream) runs to completion before
+/// returning.
+///
+/// @return Future of the kernel time in nanoseconds; @c get() waits for the
+///         output transfers, and so does its destructor.
+template <typename Func, typename... Args>
+inline std::future<int64_t> invoke_async(Func&& f, const std::string& bitstream,
+                                         Args&&... args) {
+  static_assert(std::is_function_v<typename std::remove_reference_t<Func>>,
+                "the first argument for tapa::invoke_async() must be a "
+                "function");
+  return internal::invoker<Func>::template invoke_async<Args...>(
+      std::forward<Func>(f), bitstream, std::forward<Args>(args)...);
+}
+
 // Workaround for the fact that Xilinx's cosim cannot run for more than once in
 // each process. The mmap pointers MUST be allocated via mmap, or the updates
 // won't be seen by the caller process!
+//
+// Invocations run in a worker process that is kept across calls as long as
+// the mmap arguments are allocated via `aligned_allocator` before the worker
+// starts; the worker is restarted if it exits or if newer allocations are
+// passed, and after every call under Xilinx emulation. Other arguments make
+// the call fork a new process of its own.
 template <typename Func, typename... Args>
 inline int64_t invoke_in_new_process(Func&& f, const std::string& bitstream,
                                      Args&&... args) {
@@ -57,12 +94,27 @@ inline int64_t invoke_in_new_process(Func&& f, const std::string& bitstream,
       std::forward<Args>(args)...);
 }
 
-template <typename T>
+/// Allocator of page-aligned host memory that is shared with the process
+/// spawned by @c invoke_in_new_process.
+///
+/// @tparam T        Element type.
+/// @tparam pages    Page size of the backing memory; see @c page_size.
+/// @tparam numa_node NUMA node to bind the memory to, or one of
+///                  @c kNumaDefault, @c kNumaFirstTouch, @c kNumaInterleave.
+template <typename T, page_size pages = page_size::kDefault,
+          int numa_node = kNumaDefault>
 struct aligned_allocator {
   using value_type = T;
   using size_type = std::size_t;
   using difference_type = std::ptrdiff_t;
   template <typename U>
+  struct rebind {
+    using other = aligned_allocator<U, pages, numa_node>;
+  };
+  aligned_allocator() = default;
+  template <typename U>
+  aligned_allocator(const aligned_allocator<U, pages, numa_node>&) {}
+  template <typename U>
   void construct(U* ptr) {
     ::new (static_cast<void*>(ptr)) U;
   }
@@ -71,11 +123,114 @@ struct aligned_allocator {
     ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
   }
   T* allocate(size_t count) {
-    return reinterpret_cast<T*>(internal::allocate(count * sizeof(T)));
+    return reinterpret_cast<T*>(
+        internal::allocate(count * sizeof(T), pages, numa_node));
   }
   void deallocate(T* ptr, std::size_t count) {
-    internal::deallocate(ptr, count * sizeof(T));
+    internal::deallocate(ptr, count * sizeof(T), pages);
+  }
+};
+
+template <typename T, typename U, page_size pages, int numa_node>
+inline bool operator==(const aligned_allocator<T, pages, numa_node>&,
+                       const aligned_allocator<U, pages, numa_node>&) {
+  return true;
+}
+
+template <typename T, typename U, page_size pages, int numa_node>
+inline bool operator!=(const aligned_allocator<T, pages, numa_node>&,
+                       const aligned_allocator<U, pages, numa_node>&) {
+  return false;
+}
+
+/// Array of @c T interleaved across @c S memory channels, as laid out by
+/// @c tapa::striped_layout, so that a kernel reading it in order uses the
+/// bandwidth of all channels.
+///
+/// The channels are passed to the kernel as @c tapa::mmaps, e.g.,
+/// <tt>tapa::read_only_mmaps<T, S>(array.channels())</tt>, and typically read
+/// by one task per channel whose outputs are combined by
+/// @c tapa::merge_striped into one stream of the array. Scaling to more
+/// channels then only changes @c S.
+///
+/// The channels are allocated via @c aligned_allocator and padded to the same
+/// size. Copying between the array order and the channels is done in parallel.
+///
+/// This should be used on the host only.
+///
+/// @tparam T           Element type.
+/// @tparam S           Number of channels.
+/// @tparam granularity Number of consecutive elements stored in one channel.
+template <typename T, uint64_t S, uint64_t granularity = 1>
+class striped_mmap {
+ public:
+  using layout = striped_layout<S, granularity>;
+
+  /// Constructs a value-initialized array of @c size elements.
+  explicit striped_mmap(uint64_t size) : size_(size) {
+    const uint64_t channel_size = layout::channel_size(size, 0);
+    for (auto& channel : channels_) channel.resize(channel_size);
+  }
+
+  /// Constructs an array from @c size elements in array order at @c data.
+  striped_mmap(const T* data, uint64_t size) : striped_mmap(size) {
+    scatter(data);
+  }
+
+  /// Constructs an array from a container of elements in array order, which
+  /// must have @c data() and @c size().
+  template <typename Container,
+            typename = std::enable_if_t<std::is_convertible_v<
+                decltype(std::declval<const Container&>().data()), const T*>>>
+  explicit striped_mmap(const Container& container)
+      : striped_mmap(container.data(), container.size()) {}
+
+  /// Retrieves the number of elements of the array.
+  uint64_t size() const { return size_; }
+
+  /// Accesses element @c idx of the array.
+  T& operator[](uint64_t idx) {
+    return channels_[layout::channel(idx)][layout::offset(idx)];
+  }
+  const T& operator[](uint64_t idx) const {
+    return channels_[layout::channel(idx)][layout::offset(idx)];
+  }
+
+  /// Copies @c size() elements in array order from @c data to the channels.
+  void scatter(const T* data) {
+    interleave(data, size_, channels(), granularity);
   }
+
+  /// Copies @c size() elements in array order from the channels to @c data.
+  void gather(T* data) const {
+    deinterleave(const_cast<striped_mmap*>(this)->channels(), size_, data,
+                 granularity);
+  }
+
+  /// Copies the array in array order to a container of at least @c size()
+  /// elements.
+  template <typename Container,
+            typename = std::enable_if_t<std::is_convertible_v<
+                decltype(std::declval<Container&>().data()), T*>>>
+  void gather(Container& container) const {
+    CHECK_GE(container.size(), size_);
+    gather(container.data());
+  }
+
+  /// Returns the channels as a @c tapa::mmaps.
+  mmaps<T, S> channels() {
+    std::array<T*, S> ptrs;
+    std::array<uint64_t, S> sizes;
+    for (uint64_t ch = 0; ch < S; ++ch) {
+      ptrs[ch] = channels_[ch].data();
+      sizes[ch] = channels_[ch].size();
+    }
+    return mmaps<T, S>(ptrs, sizes);
+  }
+
+ private:
+  uint64_t size_;
+  std::array<std::vector<T, aligned_allocator<T>>, S> channels_;
 };
 
 }  // namespace tapa
@@ -4,41 +4,93 @@
 #include "tapa/base/task.h"
 
 #include "tapa/host/coroutine.h"
+#include "tapa/host/device.h"
 #include "tapa/host/logging.h"
+#include "tapa/host/memory_model.h"
+#include "tapa/host/stream.h"
 
 #include <sys/wait.h>
 #include <chrono>
+#include <future>
 #include <memory>
+#include <tuple>
 #include <type_traits>
 
 #include <frt.h>
 
 namespace tapa {
 
+/// Page size backing host memory allocated by @c aligned_allocator and
+/// buffers.
+enum class page_size {
+  /// Decided at run time by the @c TAPA_HUGE_PAGES environment variable
+  /// (`thp` for @c kTransparentHuge, `1` for @c kHuge), @c kNormal if unset.
+  kDefault,
+  /// Regular pages.
+  kNormal,
+  /// Regular mapping advised to be backed by transparent huge pages; for
+  /// memory shared with the worker process, only if
+  /// `/sys/kernel/mm/transparent_hugepage/shmem_enabled` allows it.
+  kTransparentHuge,
+  /// Explicit huge pages via @c MAP_HUGETLB; falls back to
+  /// @c kTransparentHuge if none are reserved.
+  kHuge,
+};
+
+/// NUMA placement decided at run time by the @c TAPA_NUMA_NODE environment
+/// variable (a node id or `interleave`), @c kNumaFirstTouch if unset.
+inline constexpr int kNumaDefault = -1;
+/// Pages are placed on the node of the thread that first writes them.
+inline constexpr int kNumaFirstTouch = -2;
+/// Pages are interleaved across all nodes.
+inline constexpr int kNumaInterleave = -3;
+
 namespace internal {
 
 template <typename Param, typename Arg>
 struct accessor {
   static Param access(Arg&& arg) { return arg; }
-  static void access(fpga::Instance& instance, int& idx, Arg&& arg) {
-    instance.SetArg(idx++, static_cast<Param>(arg));
+  static void access(device& dev, int& idx, Arg&& arg) {
+    dev.set_scalar(idx++, static_cast<Param>(arg));
   }
+  // Appends the host memory transferred for `arg` to `ranges`.
+  static void get_host_memory(const Arg& arg, address_ranges& ranges) {}
 };
 
 template <typename T>
 struct accessor<T, seq> {
   static T access(seq&& arg) { return arg.pos++; }
-  static void access(fpga::Instance& instance, int& idx, seq&& arg) {
-    instance.SetArg(idx++, static_cast<T>(arg.pos++));
+  static void access(device& dev, int& idx, seq&& arg) {
+    dev.set_scalar(idx++, static_cast<T>(arg.pos++));
   }
 };
 
-void* allocate(size_t length);
-void deallocate(void* addr, size_t length);
+// Maps anonymous memory, which is shared with the worker process of
+// `invoke_in_new_process` and its forks if `is_shared`.
+void* allocate(size_t length, page_size pages = page_size::kNormal,
+               int numa_node = kNumaFirstTouch, bool is_shared = true);
+void deallocate(void* addr, size_t length,
+                page_size pages = page_size::kNormal);
+
+// Runs an invocation of `bitstream` with the arguments at `args` in the worker
+// process.
+using worker_function = int64_t (*)(const std::string& bitstream, void* args);
+
+inline constexpr size_t kMaxWorkerArgsAlignment = 64;
+
+// Runs `run` in a worker process kept across calls, passing it a copy of the
+// `args_bytes` bytes at `args`. Returns false without running if `buffers`
+// are not all in memory from `allocate`, which the worker shares.
+bool run_in_worker(worker_function run, const std::string& bitstream,
+                   const void* args, size_t args_bytes,
+                   const address_ranges& buffers, int64_t* kernel_time_ns);
 
 template <typename T>
 struct invoker;
 
+template <typename Mode, typename Func>
+struct replicator;
+
 template <typename... Params>
 struct invoker<void (&)(Params...)> {
   template <typename... Args>
@@ -56,47 +108,172 @@ struct invoker<void (&)(Params...)> {
       const auto tic = std::chrono::steady_clock::now();
       f(std::forward<Args>(args)...);
       const auto toc = std::chrono::steady_clock::now();
+      report_memory_channels();
       return std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic)
           .count();
     } else {
       if (run_in_new_process) {
+        int64_t kernel_time_ns = 0;
+        if (invoke_in_worker(bitstream, &kernel_time_ns, args...)) {
+          return kernel_time_ns;
+        }
+
+        // Arguments not shared with the worker; fork for this call only.
         auto kernel_time_ns_raw = allocate(sizeof(int64_t));
         auto deleter = [](int64_t* p) { deallocate(p, sizeof(int64_t)); };
-        std::unique_ptr<int64_t, decltype(deleter)> kernel_time_ns(
+        std::unique_ptr<int64_t, decltype(deleter)> shared_kernel_time_ns(
             reinterpret_cast<int64_t*>(kernel_time_ns_raw), deleter);
         if (pid_t pid = fork()) {
           // Parent.
           PCHECK(pid != -1);
           int status = 0;
-          CHECK_EQ(wait(&status), pid);
+          CHECK_EQ(waitpid(pid, &status, 0), pid);
           CHECK(WIFEXITED(status));
           CHECK_EQ(WEXITSTATUS(status), EXIT_SUCCESS);
-          return *kernel_time_ns;
+          return *shared_kernel_time_ns;
         }
 
-        // Child.
-        *kernel_time_ns = invoke(f, bitstream, std::forward<Args>(args)...);
+        // Child; a device kept by the parent must not be shared.
+        *shared_kernel_time_ns =
+            invoke_on_device(/*use_cached_device=*/false, bitstream,
+                             /*enqueued=*/nullptr, std::forward<Args>(args)...);
         exit(EXIT_SUCCESS);
       } else {
-        return invoke(f, bitstream, std::forward<Args>(args)...);
+        return invoke_on_device(/*use_cached_device=*/true, bitstream,
+                                /*enqueued=*/nullptr,
+                                std::forward<Args>(args)...);
       }
     }
   }
 
+  template <typename... Args>
+  static std::future<int64_t> invoke_async(void (&f)(Params...),
+                                           const std::string& bitstream,
+                                           Args&&... args) {
+    if (bitstream.empty()) {
+      // the simulated tasks share one scheduler, so simulate in place
+      std::promise<int64_t> kernel_time_ns;
+      kernel_time_ns.set_value(invoke(/*run_in_new_process=*/false, f,
+                                      bitstream, std::forward<Args>(args)...));
+      return kernel_time_ns.get_future();
+    }
+    // programming another instance would reprogram the FPGA under a running
+    // kernel, so the invocations take turns on the kept device in order; each
+    // enqueues its work once the kernel of the previous one is executed
+    std::promise<void> enqueued;
+    std::shared_future<void> last;
+    {
+      std::unique_lock<std::mutex> lock(async_invocation_mutex());
+      last = std::exchange(last_async_invocation(),
+                           enqueued.get_future().share());
+      ++queued_async_invocations();
+    }
+    return std::async(
+        std::launch::async,
+        [bitstream, last, enqueued = std::move(enqueued)](
+            std::decay_t<Args>... args) mutable {
+          if (last.valid()) last.wait();
+          return invoke_on_device(/*use_cached_device=*/true, bitstream,
+                                  &enqueued, std::move(args)...);
+        },
+        std::forward<Args>(args)...);
+  }
+
  private:
+  // Runs the invocation in the worker process kept for
+  // `invoke_in_new_process`. Returns false if `args` cannot be passed to it.
   template <typename... Args>
-  static int64_t invoke(void (&f)(Params...), const std::string& bitstream,
-                        Args&&... args) {
-    auto instance = fpga::Instance(bitstream);
+  static bool invoke_in_worker(const std::string& bitstream,
+                               int64_t* kernel_time_ns, const Args&... args) {
+    if constexpr (((std::is_trivially_copyable_v<std::decay_t<Args>> &&
+                    std::is_copy_constructible_v<std::decay_t<Args>>)&&...)) {
+      using args_t = std::tuple<std::decay_t<Args>...>;
+      static_assert(alignof(args_t) <= kMaxWorkerArgsAlignment);
+      address_ranges buffers;
+      (..., accessor<Params, std::decay_t<Args>>::get_host_memory(args,
+                                                                   buffers));
+      const args_t args_copy(args...);
+      return run_in_worker(&invoke_in_worker_process<std::decay_t<Args>...>,
+                           bitstream, &args_copy, sizeof(args_copy), buffers,
+                           kernel_time_ns);
+    }
+    return false;
+  }
+
+  // Runs in the worker process.
+  template <typename... Args>
+  static int64_t invoke_in_worker_process(const std::string& bitstream,
+                                          void* args) {
+    return std::apply(
+        [&bitstream](Args&... args) {
+          return invoke_on_device(/*use_cached_device=*/true, bitstream,
+                                  /*enqueued=*/nullptr, std::move(args)...);
+        },
+        *static_cast<std::tuple<Args...>*>(args));
+  }
+
+  // Runs an invocation on a device. If `enqueued` is not null, the invocation
+  // is started by `invoke_async`; `enqueued` is set once its kernel is
+  // executed, and if more of those invocations are queued, waiting for the
+  // kernel is left to the next one so that its transfers overlap the kernel.
+  template <typename... Args>
+  static int64_t invoke_on_device(bool use_cached_device,
+                                  const std::string& bitstream,
+                                  std::promise<void>* enqueued,
+                                  Args&&... args) {
+    std::future<int64_t> kernel_time_ns;
+    {
+      bool is_reused = false;
+      auto dev = use_cached_device ? acquire_device(bitstream, &is_reused)
+                                   : std::make_shared<device>(bitstream);
+      std::unique_lock<std::mutex> lock(dev->mutex());
+      enqueue(*dev, /*use_dirty_ranges=*/use_cached_device,
+              std::forward<Args>(args)...);
+      const std::string programming =
+          is_reused ? "programming skipped"
+                    : std::to_string(dev->program_time_ns() * 1e-6) +
+                          " ms programming";
+      auto finish = [&instance = dev->instance(), programming,
+                     reused_buffer_count = dev->reused_buffer_count(),
+                     transfers = dev->get_transfer_report()] {
+        instance.Finish();
+        const int64_t compute_time_ns = instance.ComputeTimeNanoSeconds();
+        LOG(INFO) << "compute time: " << compute_time_ns * 1e-6 << " ms";
+        LOG(INFO) << "setup time: " << programming << ", "
+                  << instance.LoadTimeNanoSeconds() * 1e-6
+                  << " ms host-to-device, "
+                  << instance.StoreTimeNanoSeconds() * 1e-6
+                  << " ms device-to-host, " << reused_buffer_count
+                  << " device buffer(s) reused";
+        LOG(INFO) << "transfers: " << transfers;
+        return compute_time_ns;
+      };
+      if (enqueued == nullptr) return finish();
+      const bool is_deferred = --queued_async_invocations() > 0;
+      enqueued->set_value();
+      if (!is_deferred) return finish();
+      kernel_time_ns = dev->defer_finish(finish);
+    }
+    // run by the next invocation, or by the destructor of the device
+    return kernel_time_ns.get();
+  }
+
+  // Sets `args` on `dev`, skipping the transfers of clean inputs if
+  // `use_dirty_ranges`, and enqueues the host-to-device transfers, the
+  // kernel, and the device-to-host transfers, all of which run asynchronously
+  // until `Finish()`.
+  template <typename... Args>
+  static void enqueue(device& dev, bool use_dirty_ranges, Args&&... args) {
+    dev.begin_invocation(use_dirty_ranges);
     int idx = 0;
-    int _[] = {(
-        accessor<Params, Args>::access(instance, idx, std::forward<Args>(args)),
-        0)...};
+    (..., accessor<Params, Args>::access(dev, idx, std::forward<Args>(args)));
+    auto& instance = dev.instance();
     instance.WriteToDevice();
+    dev.resume_outputs();
+    // the kernel of the previous invocation, if deferred, runs until here
+    dev.finish_deferred();
     instance.Exec();
     instance.ReadFromDevice();
-    instance.Finish();
-    return instance.ComputeTimeNanoSeconds();
   }
 };
 
@@ -191,8 +368,114 @@ struct task {
     }
     return *this;
   }
+
+  /// Invokes a task as @c tapa::replicated instances.
+  ///
+  /// @tparam Mode @c tapa::replicated<n, mode>.
+  /// @param func  Task function definition of the replicated child.
+  /// @param args  Arguments passed to @c func.
+  /// @return      Reference to the caller @c tapa::task.
+  template <typename Mode, typename Func, typename... Args>
+  task& invoke(Func&& func, Args&&... args) {
+    static_assert(
+        std::is_function_v<typename std::remove_reference_t<Func>>,
+        "the first argument for tapa::task::invoke() must be a function");
+    internal::replicator<Mode, Func>::invoke(*this, std::forward<Func>(func),
+                                             std::forward<Args>(args)...);
+    return *this;
+  }
+};
+
+namespace internal {
+
+// Category of a task parameter in a replicated task.
+template <typename Param>
+struct replica_param {
+  static constexpr int kind = 0;
+};
+
+template <typename T>
+struct replica_param<istream<T>&> {
+  using elem_t = T;
+  static constexpr int kind = 1;
+};
+
+template <typename T>
+struct replica_param<ostream<T>&> {
+  using elem_t = T;
+  static constexpr int kind = 2;
+};
+
+// Returns the number of parameters of `kind`.
+template <int kind, typename... Params>
+constexpr int count_replica_params() {
+  return ((replica_param<Params>::kind == kind ? 1 : 0) + ... + 0);
+}
+
+// Returns the index of the first parameter of `kind`.
+template <int kind, typename... Params>
+constexpr size_t find_replica_param() {
+  constexpr bool is_kind[] = {false, replica_param<Params>::kind == kind...};
+  for (size_t i = 1; i < sizeof(is_kind) / sizeof(is_kind[0]); ++i) {
+    if (is_kind[i]) return i - 1;
+  }
+  return 0;
+}
+
+template <typename T, int n>
+void replica_distributor(istream<T>& in, ostreams<T, n>& out) {
+  distribute_round_robin<n>(in, out);
+}
+
+template <typename T, int n>
+void replica_collector(istreams<T, n>& in, ostream<T>& out) {
+  collect_round_robin<n>(in, out);
+}
+
+template <int n, int mode, typename... Params>
+struct replicator<replicated<n, mode>, void (&)(Params...)> {
+  static_assert(count_replica_params<1, Params...>() == 1 &&
+                    count_replica_params<2, Params...>() == 1,
+                "a replicated task must have exactly one istream and one "
+                "ostream parameter");
+
+  using params_t = std::tuple<Params...>;
+  static constexpr size_t kInput = find_replica_param<1, Params...>();
+  static constexpr size_t kOutput = find_replica_param<2, Params...>();
+  using input_t = typename replica_param<
+      std::tuple_element_t<kInput, params_t>>::elem_t;
+  using output_t = typename replica_param<
+      std::tuple_element_t<kOutput, params_t>>::elem_t;
+
+  template <typename... Args>
+  static void invoke(task& parent, void (&f)(Params...), Args&&... args) {
+    auto&& in = std::get<kInput>(std::forward_as_tuple(args...));
+    auto&& out = std::get<kOutput>(std::forward_as_tuple(args...));
+    streams<input_t, n> replica_in("replica_in");
+    streams<output_t, n> replica_out("replica_out");
+    parent.invoke<detach>(replica_distributor<input_t, n>, in, replica_in);
+    parent.invoke<mode, n>(f, select<Params>(replica_in, replica_out,
+                                             std::forward<Args>(args))...);
+    parent.invoke<detach>(replica_collector<output_t, n>, replica_out, out);
+  }
+
+ private:
+  // Passes the replicated streams in place of the stream arguments.
+  template <typename Param, typename Arg>
+  static decltype(auto) select(streams<input_t, n>& replica_in,
+                               streams<output_t, n>& replica_out, Arg&& arg) {
+    if constexpr (replica_param<Param>::kind == 1) {
+      return (replica_in);
+    } else if constexpr (replica_param<Param>::kind == 2) {
+      return (replica_out);
+    } else {
+      return std::forward<Arg>(arg);
+    }
+  }
 };
 
+}  // namespace internal
+
 }  // namespace tapa
 
 #endif  // TAPA_HOST_TASK_H_
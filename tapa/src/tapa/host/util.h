@@ -2,8 +2,12 @@
 #define TAPA_HOST_UTIL_H_
 
 #include <climits>
+#include <cstdint>
 
+#include <algorithm>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include "tapa/base/util.h"
 
@@ -37,6 +41,31 @@ inline T reg(T x) {
   return x;
 }
 
+namespace internal {
+
+// Calls `func(i)` for every i in [0, count), split into contiguous chunks of
+// at least `grain` indices over up to one thread per hardware thread.
+template <typename Func>
+inline void parallel_for(uint64_t count, const Func& func, uint64_t grain = 1) {
+  const uint64_t thread_count = std::min<uint64_t>(
+      (count + grain - 1) / grain,
+      std::max(std::thread::hardware_concurrency(), 1u));
+  if (thread_count <= 1) {
+    for (uint64_t i = 0; i < count; ++i) func(i);
+    return;
+  }
+  const auto run = [&](uint64_t t) {
+    const uint64_t end = count * (t + 1) / thread_count;
+    for (uint64_t i = count * t / thread_count; i < end; ++i) func(i);
+  };
+  std::vector<std::thread> threads;
+  for (uint64_t t = 1; t < thread_count; ++t) threads.emplace_back(run, t);
+  run(0);
+  for (auto& thread : threads) thread.join();
+}
+
+}  // namespace internal
+
 }  // namespace tapa
 
 #endif  // TAPA_HOST_UTIL_H_
\ No newline at end of file
@@ -10,11 +10,82 @@
 #include <array>
 #include <functional>
 #include <ostream>
+#include <type_traits>
+#include <utility>
 
 #include "tapa/host/util.h"
 
 namespace tapa {
 
+namespace internal {
+
+// Vector type holding N elements of T, for the pairs of T and N whose
+// element-wise operations are vectorized explicitly; `value` is false for
+// other pairs, which use the element-by-element loops. Define
+// TAPA_DISABLE_SIMD to use the loops everywhere.
+template <typename T, int N, typename = void>
+struct simd {
+  static constexpr bool value = false;
+};
+
+#if defined(__GNUC__) && !defined(TAPA_DISABLE_SIMD)
+#define TAPA_DEFINE_SIMD(type)                                               \
+  template <int N>                                                           \
+  struct simd<type, N,                                                       \
+              std::enable_if_t<N == 4 || N == 8 || N == 16 || N == 32>> {    \
+    static constexpr bool value = true;                                      \
+    typedef type vector_type __attribute__((vector_size(sizeof(type) * N))); \
+  }
+TAPA_DEFINE_SIMD(float);
+TAPA_DEFINE_SIMD(double);
+TAPA_DEFINE_SIMD(int32_t);
+TAPA_DEFINE_SIMD(int16_t);
+#undef TAPA_DEFINE_SIMD
+
+// Permutations of vector types with indices known at compile time.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_shufflevector)
+#define TAPA_HAS_SHUFFLEVECTOR 1
+#endif  // __has_builtin(__builtin_shufflevector)
+#endif  // __has_builtin
+#endif  // __GNUC__ && !TAPA_DISABLE_SIMD
+
+// Operators whose vectorized results are bit-identical to the loops.
+// Integer division and shifts are excluded: the loops promote int16_t
+// operands to int, which differs for some operands.
+enum class simd_op {
+  kNone,        // never vectorized
+  kArithmetic,  // +, -, *
+  kDivision,    // /, floating-point only
+  kBitwise,     // &, |, ^, integers only
+};
+
+template <typename T, typename T2, int N, simd_op op>
+constexpr bool can_simd() {
+  return std::is_same<T, T2>::value && simd<T, N>::value &&
+         (op == simd_op::kArithmetic ||
+          (op == simd_op::kDivision && std::is_floating_point<T>::value) ||
+          (op == simd_op::kBitwise && std::is_integral<T>::value));
+}
+
+// Vector types are only passed by reference, which keeps their ABI out of
+// function signatures.
+template <typename T, int N>
+using simd_vector = typename simd<T, N>::vector_type;
+
+// Loads `vec` from `ptr`, which needs no more than element alignment.
+template <typename T, typename V>
+inline void simd_load(V& vec, const T* ptr) {
+  std::memcpy(&vec, ptr, sizeof(vec));
+}
+
+template <typename T, typename V>
+inline void simd_store(T* ptr, const V& vec) {
+  std::memcpy(ptr, &vec, sizeof(vec));
+}
+
+}  // namespace internal
+
 template <typename T, int N>
 struct vec_t : protected std::array<T, N> {
  private:
@@ -76,31 +147,44 @@ struct vec_t : protected std::array<T, N> {
   }
 
 // assignment operators
-#define DEFINE_OP(op)                                    \
-  template <typename T2>                                 \
-  vec_t<T, N>& operator op##=(const vec_t<T2, N>& rhs) { \
-    for (size_type i = 0; i < N; ++i) {                  \
-      set(i, get(i) op rhs[i]);                          \
-    }                                                    \
-    return *this;                                        \
-  }                                                      \
-  template <typename T2>                                 \
-  vec_t<T, N>& operator op##=(const T2& rhs) {           \
-    for (size_type i = 0; i < N; ++i) {                  \
-      set(i, get(i) op rhs);                             \
-    }                                                    \
-    return *this;                                        \
+#define DEFINE_OP(op, kind)                                                  \
+  template <typename T2>                                                     \
+  vec_t<T, N>& operator op##=(const vec_t<T2, N>& rhs) {                     \
+    if constexpr (internal::can_simd<T, T2, N, internal::simd_op::kind>()) { \
+      internal::simd_vector<T, N> lhs, vec;                                  \
+      internal::simd_load(lhs, &(*this)[0]);                                 \
+      internal::simd_load(vec, &rhs[0]);                                     \
+      internal::simd_store(&(*this)[0], lhs op vec);                         \
+    } else {                                                                 \
+      for (size_type i = 0; i < N; ++i) {                                    \
+        set(i, get(i) op rhs[i]);                                            \
+      }                                                                      \
+    }                                                                        \
+    return *this;                                                            \
+  }                                                                          \
+  template <typename T2>                                                     \
+  vec_t<T, N>& operator op##=(const T2& rhs) {                               \
+    if constexpr (internal::can_simd<T, T2, N, internal::simd_op::kind>()) { \
+      internal::simd_vector<T, N> lhs;                                       \
+      internal::simd_load(lhs, &(*this)[0]);                                 \
+      internal::simd_store(&(*this)[0], lhs op rhs);                         \
+    } else {                                                                 \
+      for (size_type i = 0; i < N; ++i) {                                    \
+        set(i, get(i) op rhs);                                               \
+      }                                                                      \
+    }                                                                        \
+    return *this;                                                            \
   }
-  DEFINE_OP(+)
-  DEFINE_OP(-)
-  DEFINE_OP(*)
-  DEFINE_OP(/)
-  DEFINE_OP(%)
-  DEFINE_OP(&)
-  DEFINE_OP(|)
-  DEFINE_OP(^)
-  DEFINE_OP(<<)
-  DEFINE_OP(>>)
+  DEFINE_OP(+, kArithmetic)
+  DEFINE_OP(-, kArithmetic)
+  DEFINE_OP(*, kArithmetic)
+  DEFINE_OP(/, kDivision)
+  DEFINE_OP(%, kNone)
+  DEFINE_OP(&, kBitwise)
+  DEFINE_OP(|, kBitwise)
+  DEFINE_OP(^, kBitwise)
+  DEFINE_OP(<<, kNone)
+  DEFINE_OP(>>, kNone)
 #undef DEFINE_OP
 
 // unary arithemetic operators
@@ -117,33 +201,46 @@ struct vec_t : protected std::array<T, N> {
 #undef DEFINE_OP
 
 // binary arithemetic operators
-#define DEFINE_OP(op)                                \
-  template <typename T2>                             \
-  vec_t<T, N> operator op(const vec_t<T2, N>& rhs) { \
-    vec_t<T, N> result;                              \
-    for (size_type i = 0; i < N; ++i) {              \
-      result.set(i, get(i) op rhs[i]);               \
-    }                                                \
-    return result;                                   \
-  }                                                  \
-  template <typename T2>                             \
-  vec_t<T, N> operator op(const T2& rhs) {           \
-    vec_t<T, N> result;                              \
-    for (size_type i = 0; i < N; ++i) {              \
-      result.set(i, get(i) op rhs);                  \
-    }                                                \
-    return result;                                   \
+#define DEFINE_OP(op, kind)                                                  \
+  template <typename T2>                                                     \
+  vec_t<T, N> operator op(const vec_t<T2, N>& rhs) {                         \
+    vec_t<T, N> result;                                                      \
+    if constexpr (internal::can_simd<T, T2, N, internal::simd_op::kind>()) { \
+      internal::simd_vector<T, N> lhs, vec;                                  \
+      internal::simd_load(lhs, &(*this)[0]);                                 \
+      internal::simd_load(vec, &rhs[0]);                                     \
+      internal::simd_store(&result[0], lhs op vec);                          \
+    } else {                                                                 \
+      for (size_type i = 0; i < N; ++i) {                                    \
+        result.set(i, get(i) op rhs[i]);                                     \
+      }                                                                      \
+    }                                                                        \
+    return result;                                                           \
+  }                                                                          \
+  template <typename T2>                                                     \
+  vec_t<T, N> operator op(const T2& rhs) {                                   \
+    vec_t<T, N> result;                                                      \
+    if constexpr (internal::can_simd<T, T2, N, internal::simd_op::kind>()) { \
+      internal::simd_vector<T, N> lhs;                                       \
+      internal::simd_load(lhs, &(*this)[0]);                                 \
+      internal::simd_store(&result[0], lhs op rhs);                          \
+    } else {                                                                 \
+      for (size_type i = 0; i < N; ++i) {                                    \
+        result.set(i, get(i) op rhs);                                        \
+      }                                                                      \
+    }                                                                        \
+    return result;                                                           \
   }
-  DEFINE_OP(+)
-  DEFINE_OP(-)
-  DEFINE_OP(*)
-  DEFINE_OP(/)
-  DEFINE_OP(%)
-  DEFINE_OP(&)
-  DEFINE_OP(|)
-  DEFINE_OP(^)
-  DEFINE_OP(<<)
-  DEFINE_OP(>>)
+  DEFINE_OP(+, kArithmetic)
+  DEFINE_OP(-, kArithmetic)
+  DEFINE_OP(*, kArithmetic)
+  DEFINE_OP(/, kDivision)
+  DEFINE_OP(%, kNone)
+  DEFINE_OP(&, kBitwise)
+  DEFINE_OP(|, kBitwise)
+  DEFINE_OP(^, kBitwise)
+  DEFINE_OP(<<, kNone)
+  DEFINE_OP(>>, kNone)
 #undef DEFINE_OP
 
   // shift all elements by 1, put val at [N-1], and through away [0]
@@ -239,25 +336,31 @@ inline auto cat(T arg, Args... args) {
 #endif  // __cplusplus >= 201402L
 
 // binary arithemetic operators, vector on the right-hand side
-#define DEFINE_OP(op)                                              \
-  template <typename T, int N, typename T2>                        \
-  vec_t<T, N> operator op(const T2& lhs, const vec_t<T, N>& rhs) { \
-    vec_t<T, N> result;                                            \
-    for (int i = 0; i < N; ++i) {                                  \
-      result.set(i, lhs op rhs[i]);                                \
-    }                                                              \
-    return result;                                                 \
-  }
-DEFINE_OP(+)
-DEFINE_OP(-)
-DEFINE_OP(*)
-DEFINE_OP(/)
-DEFINE_OP(%)
-DEFINE_OP(&)
-DEFINE_OP(|)
-DEFINE_OP(^)
-DEFINE_OP(<<)
-DEFINE_OP(>>)
+#define DEFINE_OP(op, kind)                                                  \
+  template <typename T, int N, typename T2>                                  \
+  vec_t<T, N> operator op(const T2& lhs, const vec_t<T, N>& rhs) {           \
+    vec_t<T, N> result;                                                      \
+    if constexpr (internal::can_simd<T, T2, N, internal::simd_op::kind>()) { \
+      internal::simd_vector<T, N> vec;                                       \
+      internal::simd_load(vec, &rhs[0]);                                     \
+      internal::simd_store(&result[0], lhs op vec);                          \
+    } else {                                                                 \
+      for (int i = 0; i < N; ++i) {                                          \
+        result.set(i, lhs op rhs[i]);                                        \
+      }                                                                      \
+    }                                                                        \
+    return result;                                                           \
+  }
+DEFINE_OP(+, kArithmetic)
+DEFINE_OP(-, kArithmetic)
+DEFINE_OP(*, kArithmetic)
+DEFINE_OP(/, kDivision)
+DEFINE_OP(%, kNone)
+DEFINE_OP(&, kBitwise)
+DEFINE_OP(|, kBitwise)
+DEFINE_OP(^, kBitwise)
+DEFINE_OP(<<, kNone)
+DEFINE_OP(>>, kNone)
 #undef DEFINE_OP
 
 template <int N, typename T>
@@ -286,12 +389,20 @@ DEFINE_FUNC(log2)
 #undef DEFINE_FUNC
 
 // binary operation functions
-#define DEFINE_FUNC(func)                                            \
+#define DEFINE_FUNC(func, cmp)                                       \
   template <typename T, int N>                                       \
   vec_t<T, N> func(const vec_t<T, N>& lhs, const vec_t<T, N>& rhs) { \
     vec_t<T, N> result;                                              \
-    for (int i = 0; i < N; ++i) {                                    \
-      result.set(i, std::func(lhs[i], rhs[i]));                      \
+    if constexpr (internal::simd<T, N>::value) {                     \
+      /* same selection as std::func, lane by lane */                \
+      internal::simd_vector<T, N> a, b;                              \
+      internal::simd_load(a, &lhs[0]);                               \
+      internal::simd_load(b, &rhs[0]);                               \
+      internal::simd_store(&result[0], cmp ? b : a);                 \
+    } else {                                                         \
+      for (int i = 0; i < N; ++i) {                                  \
+        result.set(i, std::func(lhs[i], rhs[i]));                    \
+      }                                                              \
     }                                                                \
     return result;                                                   \
   }                                                                  \
@@ -303,8 +414,8 @@ DEFINE_FUNC(log2)
   vec_t<T, N> func(const vec_t<T, N>& lhs, const T& rhs) {           \
     return func(lhs, make_vec<N>(rhs));                              \
   }
-DEFINE_FUNC(max)
-DEFINE_FUNC(min)
+DEFINE_FUNC(max, a < b)
+DEFINE_FUNC(min, b < a)
 #undef DEFINE_FUNC
 
 // reduction operation functions
@@ -321,6 +432,273 @@ DEFINE_FUNC(sum, +)
 DEFINE_FUNC(product, *)
 #undef DEFINE_FUNC
 
+namespace internal {
+
+struct add_op {
+  template <typename V>
+  V operator()(V lhs, V rhs) const {
+    return lhs + rhs;
+  }
+};
+
+struct max_op {
+  template <typename V>
+  V operator()(const V& lhs, const V& rhs) const {
+    return max(lhs, rhs);
+  }
+};
+
+struct min_op {
+  template <typename V>
+  V operator()(const V& lhs, const V& rhs) const {
+    return min(lhs, rhs);
+  }
+};
+
+// Reduces a vector of L elements with `op` as a balanced tree that folds the
+// upper half onto the lower half until one element is left: element i is
+// combined with element i + (L + 1) / 2, and the middle element of an odd
+// length is kept. Each level is one vector operation. The HLS version uses
+// the same tree, so floating-point results agree.
+template <int L>
+struct tree_reduce {
+  template <typename T, typename Op>
+  static T apply(const vec_t<T, L>& vec, const Op& op) {
+    constexpr int half = L / 2;
+    constexpr int upper = (L + 1) / 2;
+    const auto folded =
+        op(truncated<0, half>(vec), truncated<upper, L>(vec));
+    if constexpr (half == upper) {
+      return tree_reduce<half>::apply(folded, op);
+    } else {
+      return tree_reduce<upper>::apply(cat(folded, vec[half]), op);
+    }
+  }
+};
+
+template <>
+struct tree_reduce<1> {
+  template <typename T, typename Op>
+  static T apply(const vec_t<T, 1>& vec, const Op&) {
+    return vec[0];
+  }
+};
+
+// Same tree as `tree_reduce`, for the index of the maximum; of equal
+// elements, the one with the lowest index wins.
+template <int L>
+struct tree_argmax {
+  template <typename T>
+  static int apply(const vec_t<T, L>& vec, const vec_t<int, L>& idx) {
+    constexpr int half = L / 2;
+    constexpr int upper = (L + 1) / 2;
+    vec_t<T, upper> folded_vec;
+    vec_t<int, upper> folded_idx;
+    for (int i = 0; i < half; ++i) {
+      const T& lhs = vec[i];
+      const T& rhs = vec[i + upper];
+      const bool is_rhs =
+          lhs < rhs || (!(rhs < lhs) && idx[i + upper] < idx[i]);
+      folded_vec.set(i, is_rhs ? rhs : lhs);
+      folded_idx.set(i, is_rhs ? idx[i + upper] : idx[i]);
+    }
+    if (half != upper) {
+      folded_vec.set(half, vec[half]);
+      folded_idx.set(half, idx[half]);
+    }
+    return tree_argmax<upper>::apply(folded_vec, folded_idx);
+  }
+};
+
+template <>
+struct tree_argmax<1> {
+  template <typename T>
+  static int apply(const vec_t<T, 1>&, const vec_t<int, 1>& idx) {
+    return idx[0];
+  }
+};
+
+// Inclusive prefix sums by log2(N) levels of the Kogge-Stone network: level d
+// adds element i - d to element i for every i >= d.
+template <int N, int d, bool = (d < N)>
+struct tree_scan {
+  template <typename T>
+  static vec_t<T, N> apply(const vec_t<T, N>& vec) {
+    return tree_scan<N, d * 2>::apply(
+        cat(truncated<0, d>(vec),
+            truncated<0, N - d>(vec) + truncated<d, N>(vec)));
+  }
+};
+
+template <int N, int d>
+struct tree_scan<N, d, false> {
+  template <typename T>
+  static vec_t<T, N> apply(const vec_t<T, N>& vec) {
+    return vec;
+  }
+};
+
+}  // namespace internal
+
+/// Sums the elements of @c vec with a balanced tree of additions.
+///
+/// Unlike @c sum, the order of the additions is the same on the host and in
+/// hardware; see @c reduce_max for the tree.
+template <typename T, int N>
+inline T reduce_add(const vec_t<T, N>& vec) {
+  return internal::tree_reduce<N>::apply(vec, internal::add_op());
+}
+
+/// Returns the maximum element of @c vec.
+///
+/// Computed with a balanced tree of depth <tt>ceil(log2(N))</tt> that folds the
+/// upper half of the elements onto the lower half at each level.
+template <typename T, int N>
+inline T reduce_max(const vec_t<T, N>& vec) {
+  return internal::tree_reduce<N>::apply(vec, internal::max_op());
+}
+
+/// Returns the minimum element of @c vec with a balanced tree.
+template <typename T, int N>
+inline T reduce_min(const vec_t<T, N>& vec) {
+  return internal::tree_reduce<N>::apply(vec, internal::min_op());
+}
+
+/// Returns the index of the maximum element of @c vec with a balanced tree;
+/// of equal elements, the lowest index is returned.
+template <typename T, int N>
+inline int argmax(const vec_t<T, N>& vec) {
+  vec_t<int, N> idx;
+  for (int i = 0; i < N; ++i) {
+    idx.set(i, i);
+  }
+  return internal::tree_argmax<N>::apply(vec, idx);
+}
+
+/// Returns the inclusive prefix sums of @c vec, i.e., element @c i of the
+/// result is the sum of elements 0 to @c i, with <tt>ceil(log2(N))</tt> levels
+/// of additions.
+template <typename T, int N>
+inline vec_t<T, N> prefix_sum(const vec_t<T, N>& vec) {
+  return internal::tree_scan<N, 1>::apply(vec);
+}
+
+/// Returns the lanes of @c v1 and @c v2 selected by @c indices, where the
+/// lanes of @c v2 are numbered from @c N, i.e., lane @c i of the result is lane
+/// <tt>indices[i]</tt> of <tt>cat(v1, v2)</tt>. Lanes may be selected more
+/// than once or not at all.
+///
+/// The permutation is fixed at compile time, so it is pure wiring in hardware;
+/// on the host it is a single vector shuffle where the lane type allows it.
+///
+/// @tparam indices Lanes of @c v1 and @c v2, each in [0, <tt>2 * N</tt>).
+template <int... indices, typename T, int N>
+inline vec_t<T, sizeof...(indices)> shuffle(const vec_t<T, N>& v1,
+                                            const vec_t<T, N>& v2) {
+  static_assert(((indices >= 0 && indices < N * 2) && ...),
+                "shuffle index out of range");
+  constexpr int M = sizeof...(indices);
+  vec_t<T, M> result;
+#if TAPA_HAS_SHUFFLEVECTOR
+  if constexpr (internal::simd<T, N>::value && internal::simd<T, M>::value) {
+    internal::simd_vector<T, N> src1, src2;
+    internal::simd_load(src1, &v1[0]);
+    internal::simd_load(src2, &v2[0]);
+    const internal::simd_vector<T, M> dst =
+        __builtin_shufflevector(src1, src2, indices...);
+    internal::simd_store(&result[0], dst);
+    return result;
+  }
+#endif  // TAPA_HAS_SHUFFLEVECTOR
+  constexpr int lanes[] = {indices...};
+  for (int i = 0; i < M; ++i) {
+    result.set(i, lanes[i] < N ? v1[lanes[i]] : v2[lanes[i] - N]);
+  }
+  return result;
+}
+
+/// Returns the lanes of @c vec selected by @c indices, i.e., lane @c i of the
+/// result is lane <tt>indices[i]</tt> of @c vec.
+///
+/// @tparam indices Lanes of @c vec, each in [0, @c N).
+template <int... indices, typename T, int N>
+inline vec_t<T, sizeof...(indices)> shuffle(const vec_t<T, N>& vec) {
+  static_assert(((indices >= 0 && indices < N) && ...),
+                "shuffle index out of range");
+  return shuffle<indices...>(vec, vec);
+}
+
+namespace internal {
+
+// Lane maps of the permutations below: lane i of the result is lane
+// `index(i)` of the source.
+template <int N>
+struct interleave_map {
+  static constexpr int index(int i) { return i % 2 * N + i / 2; }
+};
+
+template <int begin, int stride>
+struct strided_map {
+  static constexpr int index(int i) { return begin + i * stride; }
+};
+
+template <int N, int shift>
+struct rotate_map {
+  static constexpr int index(int i) { return ((i + shift) % N + N) % N; }
+};
+
+template <typename Map, typename T, int N, int... i>
+inline vec_t<T, sizeof...(i)> permute(const vec_t<T, N>& v1,
+                                      const vec_t<T, N>& v2,
+                                      std::integer_sequence<int, i...>) {
+  return shuffle<Map::index(i)...>(v1, v2);
+}
+
+}  // namespace internal
+
+/// Interleaves the lanes of @c v1 and @c v2, i.e., returns
+/// <tt>{v1[0], v2[0], v1[1], v2[1], ...}</tt>.
+template <typename T, int N>
+inline vec_t<T, N * 2> interleave(const vec_t<T, N>& v1,
+                                  const vec_t<T, N>& v2) {
+  return internal::permute<internal::interleave_map<N>>(
+      v1, v2, std::make_integer_sequence<int, N * 2>());
+}
+
+/// Reverses @c tapa::interleave, writing the even lanes of @c vec to @c v1 and
+/// the odd lanes to @c v2.
+template <typename T, int N>
+inline void deinterleave(const vec_t<T, N * 2>& vec, vec_t<T, N>& v1,
+                         vec_t<T, N>& v2) {
+  v1 = internal::permute<internal::strided_map<0, 2>>(
+      vec, vec, std::make_integer_sequence<int, N>());
+  v2 = internal::permute<internal::strided_map<1, 2>>(
+      vec, vec, std::make_integer_sequence<int, N>());
+}
+
+/// Returns @c vec rotated by @c shift lanes towards lane 0, i.e., lane @c i of
+/// the result is lane <tt>(i + shift) % N</tt> of @c vec. A negative @c shift
+/// rotates towards lane <tt>N - 1</tt>.
+template <int shift, typename T, int N>
+inline vec_t<T, N> rotated(const vec_t<T, N>& vec) {
+  return internal::permute<internal::rotate_map<N, shift>>(
+      vec, vec, std::make_integer_sequence<int, N>());
+}
+
+/// Transposes @c M vectors of @c N lanes into @c N vectors of @c M lanes,
+/// i.e., lane @c i of <tt>dst[j]</tt> is lane @c j of <tt>src[i]</tt>.
+///
+/// @param src Input vectors, e.g., one per processing element.
+/// @param dst Output vectors; must not overlap with @c src.
+template <typename T, int N, int M>
+inline void transpose(const vec_t<T, N> (&src)[M], vec_t<T, M> (&dst)[N]) {
+  for (int j = 0; j < N; ++j) {
+    for (int i = 0; i < M; ++i) {
+      dst[j].set(i, src[i][j]);
+    }
+  }
+}
+
 template <typename T, int N>
 inline std::ostream& operator<<(std::ostream& os, const vec_t<T, N>& obj) {
   os << "{";
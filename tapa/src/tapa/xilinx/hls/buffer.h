@@ -1,14 +1,38 @@
 #ifndef TAPA_XILINX_HLS_BUFFER_H_
 #define TAPA_XILINX_HLS_BUFFER_H_
 
+#include <type_traits>
+
 #include <hls_stream.h>
 #include "tapa/base/buffer.h"
 
 namespace tapa {
 
+namespace internal {
+
+template <typename... dims>
+struct has_watermark : std::disjunction<std::is_same<dims, watermark>...> {};
+
+// the watermark FIFO only exists in buffers with `watermark`
+template <bool enabled>
+struct buffer_watermark {};
+
+template <>
+struct buffer_watermark<true> {
+  hls::stream<int> watermark;
+};
+
+}  // namespace internal
+
 template <typename T, int n_sections, typename... dims>
 class _buffer;
 
+template <typename T, int n_sections, typename... dims>
+class ibuffer;
+
+template <typename T, int n_sections, typename... dims>
+class obuffer;
+
 template <typename T, int n_sections, typename... dims>
 class section {
  public:
@@ -24,28 +48,52 @@ class section {
     return buf_ref.data[section_id];
   }
 
-#ifdef TAPA_BUFFER_EXPLICIT_RELEASE
-  void release_section() {
+  // bank port conflicts are only checked in software simulation
+  void next_iteration() const {
+    #pragma HLS inline
+  }
+
+  // publish that elements before `index` were written; the first call hands
+  // the section over to the consumer; the mark is dropped if the watermark
+  // FIFO is full, so the consumer waits for a later one or for the release
+  void publish(int index) {
     #pragma HLS inline
-    if (last) {
+    if (!published) {
       buf_ref.sink.write(section_id);
+      published = true;
+    }
+    buf_ref.watermark.write_nb(index);
+  }
+
+  // block until element `index` was published or the section was released
+  void wait_until(int index) {
+    #pragma HLS inline
+    while (watermark <= index) {
+      watermark = buf_ref.watermark.read();
     }
   }
+
+#ifdef TAPA_BUFFER_EXPLICIT_RELEASE
+  void release_section() {
+    #pragma HLS inline
+    finish();
+  }
 #else
 // write the section_id to the buffer's sink on destruction
   ~section() {
     #pragma HLS inline
-    if (last) {
-      buf_ref.sink.write(section_id);
-    }
+    finish();
   }
 #endif
 
  private:
   using buffer_t = _buffer<T, n_sections, dims...>;
   friend buffer_t;
+  friend class ibuffer<T, n_sections, dims...>;
+  friend class obuffer<T, n_sections, dims...>;
 
-  section(buffer_t& buf_ref) : buf_ref(buf_ref) {
+  section(buffer_t& buf_ref, bool for_producer)
+      : buf_ref(buf_ref), for_producer(for_producer) {
   }
 
   void init() {
@@ -53,19 +101,38 @@ class section {
     section_id = buf_ref.src.read();
   }
 
+  // with watermarks, the producer already handed the section over on its
+  // first `publish`
+  void finish() {
+    #pragma HLS inline
+    if constexpr (internal::has_watermark<dims...>::value) {
+      if (for_producer) {
+        buf_ref.watermark.write(internal::kWatermarkDone);
+      } else {
+        while (watermark != internal::kWatermarkDone) {
+          watermark = buf_ref.watermark.read();
+        }
+        buf_ref.sink.write(section_id);
+      }
+    } else if (last) {
+      buf_ref.sink.write(section_id);
+    }
+  }
+
   buffer_t& buf_ref;
   int section_id;
+  // whether the section is created by an `obuffer`
+  const bool for_producer;
   mutable volatile bool last = true;
+  bool published = false;
+  int watermark = 0;
 };
 
 template <typename T, int n_sections, typename... dims>
-class _buffer {
+class _buffer : public internal::buffer_watermark<
+                    internal::has_watermark<dims...>::value> {
  public:
   using section_t = section<T, n_sections, dims...>;
-  section_t create_section() {
-    #pragma HLS inline
-    return *this;
-  }
   void acquire(section_t& section) {
     #pragma HLS inline
     section.init();
@@ -84,14 +151,28 @@ class _buffer {
   T data[n_sections == 1 ? 2 : n_sections];
 };
 
-// for HLS interface, ibuffer and obuffer can be totally
-// same as we take care of src and sink FIFOs in the
-// stitching process
+// for HLS interface, ibuffer and obuffer share their layout as we take
+// care of src and sink FIFOs in the stitching process; they only differ in
+// the role of the sections they create
 template <typename T, int n_sections, typename... dims>
-using ibuffer = _buffer<T, n_sections, dims...>;
+class ibuffer : public _buffer<T, n_sections, dims...> {
+ public:
+  using section_t = section<T, n_sections, dims...>;
+  section_t create_section() {
+    #pragma HLS inline
+    return section_t(*this, /*for_producer=*/false);
+  }
+};
 
 template <typename T, int n_sections, typename... dims>
-using obuffer = _buffer<T, n_sections, dims...>;
+class obuffer : public _buffer<T, n_sections, dims...> {
+ public:
+  using section_t = section<T, n_sections, dims...>;
+  section_t create_section() {
+    #pragma HLS inline
+    return section_t(*this, /*for_producer=*/true);
+  }
+};
 
 template <typename T, int n_sections, typename... dims>
 using buffer = _buffer<T, n_sections, dims...>;
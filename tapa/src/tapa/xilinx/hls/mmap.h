@@ -14,7 +14,7 @@ namespace tapa {
 template <typename T>
 using mmap = T*;
 
-template <typename T>
+template <typename T, typename Pattern = access_pattern<>>
 struct async_mmap {
   using addr_t = int64_t;
   using resp_t = uint8_t;
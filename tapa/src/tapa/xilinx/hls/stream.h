@@ -188,6 +188,361 @@ using ostreams = ostream<T>[S];
 template <typename T, uint64_t S, uint64_t N = kStreamDefaultDepth>
 class streams;
 
+namespace internal {
+
+// Stream between two tasks that tapac fuses into one dataflow region. The
+// producer writes it in place of its `ostream` and the consumer reads it via a
+// `fused_istream` in place of its `istream`.
+template <typename T, uint64_t N>
+class fused_stream {
+ public:
+  bool empty() const {
+#pragma HLS inline
+    return _.empty();
+  }
+
+  bool try_read(T& value) {
+#pragma HLS inline
+    elem_t<T> elem;
+    const bool is_success = _.read_nb(elem);
+    value = elem.val;
+    return is_success;
+  }
+
+  T read() {
+#pragma HLS inline
+    return _.read().val;
+  }
+
+  fused_stream& operator>>(T& value) {
+#pragma HLS inline
+    value = read();
+    return *this;
+  }
+
+  T read(bool& is_success) {
+#pragma HLS inline
+    elem_t<T> elem;
+    is_success = _.read_nb(elem);
+    return elem.val;
+  }
+
+  T read(std::nullptr_t) {
+#pragma HLS inline
+    elem_t<T> elem;
+    _.read_nb(elem);
+    return elem.val;
+  }
+
+  T read(const T& default_value, bool* is_success = nullptr) {
+#pragma HLS inline
+    elem_t<T> elem;
+    bool is_success_val = _.read_nb(elem);
+    if (is_success != nullptr) {
+      *is_success = is_success_val;
+    }
+    return is_success_val ? elem.val : default_value;
+  }
+
+  bool try_open() {
+#pragma HLS inline
+    elem_t<T> elem;
+    const bool succeeded = _.read_nb(elem);
+    assert(!succeeded || elem.eot);
+    return succeeded;
+  }
+
+  void open() {
+#pragma HLS inline
+    const auto elem = _.read();
+    assert(elem.eot);
+  }
+
+  bool full() const {
+#pragma HLS inline
+    return _.full();
+  }
+
+  bool try_write(const T& value) {
+#pragma HLS inline
+    return _.write_nb({value, false});
+  }
+
+  void write(const T& value) {
+#pragma HLS inline
+    _.write({value, false});
+  }
+
+  fused_stream& operator<<(const T& value) {
+#pragma HLS inline
+    write(value);
+    return *this;
+  }
+
+  bool try_close() {
+#pragma HLS inline
+    elem_t<T> elem;
+    memset(&elem.val, 0, sizeof(elem.val));
+    elem.eot = true;
+    return _.write_nb(elem);
+  }
+
+  void close() {
+#pragma HLS inline
+    elem_t<T> elem;
+    elem.eot = true;
+    _.write(elem);
+  }
+
+  hls::stream<elem_t<T>, N> _;
+};
+
+// Reader of a `fused_stream` in place of the `istream` of the consumer. HLS
+// channels cannot be peeked, so the reader keeps the token that `eot` or
+// `peek` reads in a one-token lookahead register until it is read.
+template <typename T, uint64_t N>
+class fused_istream {
+ public:
+  explicit fused_istream(fused_stream<T, N>& channel)
+      : channel_(channel), has_head_(false) {
+#pragma HLS inline
+  }
+
+  bool empty() const {
+#pragma HLS inline
+    return !has_head_ && channel_._.empty();
+  }
+
+  bool try_eot(bool& is_eot) const {
+#pragma HLS inline
+    const bool is_success = fetch();
+    is_eot = head_.eot;
+    return is_success;
+  }
+
+  bool eot(bool& is_success) const {
+#pragma HLS inline
+    bool eot = false;
+    is_success = try_eot(eot);
+    return eot;
+  }
+
+  bool eot(std::nullptr_t) const {
+#pragma HLS inline
+    bool is_success;
+    return eot(is_success) && is_success;
+  }
+
+  bool try_peek(T& value) const {
+#pragma HLS inline
+    const bool is_success = fetch();
+    value = head_.val;
+    return is_success;
+  }
+
+  T peek(bool& is_success) const {
+#pragma HLS inline
+    T val;
+    is_success = try_peek(val);
+    return val;
+  }
+
+  T peek(std::nullptr_t) const {
+#pragma HLS inline
+    T val;
+    try_peek(val);
+    return val;
+  }
+
+  T peek(bool& is_success, bool& is_eot) const {
+#pragma HLS inline
+    is_success = fetch();
+    is_eot = head_.eot && is_success;
+    return head_.val;
+  }
+
+  bool try_read(T& value) {
+#pragma HLS inline
+    const bool is_success = fetch();
+    value = head_.val;
+    has_head_ = false;
+    return is_success;
+  }
+
+  T read() {
+#pragma HLS inline
+    if (!has_head_) head_ = channel_._.read();
+    has_head_ = false;
+    return head_.val;
+  }
+
+  fused_istream& operator>>(T& value) {
+#pragma HLS inline
+    value = read();
+    return *this;
+  }
+
+  T read(bool& is_success) {
+#pragma HLS inline
+    T val;
+    is_success = try_read(val);
+    return val;
+  }
+
+  T read(std::nullptr_t) {
+#pragma HLS inline
+    T val;
+    try_read(val);
+    return val;
+  }
+
+  T read(const T& default_value, bool* is_success = nullptr) {
+#pragma HLS inline
+    T val;
+    bool is_success_val = try_read(val);
+    if (is_success != nullptr) {
+      *is_success = is_success_val;
+    }
+    return is_success_val ? val : default_value;
+  }
+
+  bool try_open() {
+#pragma HLS inline
+    const bool succeeded = fetch();
+    assert(!succeeded || head_.eot);
+    has_head_ = false;
+    return succeeded;
+  }
+
+  void open() {
+#pragma HLS inline
+    if (!has_head_) head_ = channel_._.read();
+    has_head_ = false;
+    assert(head_.eot);
+  }
+
+ private:
+  // Reads the next token into the lookahead register unless it holds one, and
+  // returns whether it holds one.
+  bool fetch() const {
+#pragma HLS inline
+    if (!has_head_) has_head_ = channel_._.read_nb(head_);
+    return has_head_;
+  }
+
+  fused_stream<T, N>& channel_;
+  mutable bool has_head_;
+  mutable elem_t<T> head_;
+};
+
+// Token of `N` streams that tapac packs into one.
+template <typename T, uint64_t N>
+struct packed_t {
+  T lanes[N];
+};
+
+// Lane `I` of a stream of `packed_t<T, N>`, in place of one of the `N`
+// `ostream`s that tapac packs because the task writes them in lockstep, i.e.,
+// once each in every iteration of the same loops. The lanes keep their
+// tokens in `buffer` until the lane written last, `IsLast`, writes them all.
+template <typename T, uint64_t N, uint64_t I, bool IsLast>
+class ostream_lane {
+ public:
+  ostream_lane(ostream<packed_t<T, N>>& packed, packed_t<T, N>& buffer)
+      : packed_(packed), buffer_(buffer) {
+#pragma HLS inline
+  }
+
+  bool full() const {
+#pragma HLS inline
+    return IsLast && packed_.full();
+  }
+
+  void write(const T& value) {
+#pragma HLS inline
+    buffer_.lanes[I] = value;
+    if (IsLast) packed_.write(buffer_);
+  }
+
+  ostream_lane& operator<<(const T& value) {
+#pragma HLS inline
+    write(value);
+    return *this;
+  }
+
+  void close() {
+#pragma HLS inline
+    if (IsLast) packed_.close();
+  }
+
+ private:
+  ostream<packed_t<T, N>>& packed_;
+  packed_t<T, N>& buffer_;
+};
+
+// Lane `I` of a stream of `packed_t<T, N>`, in place of one of the `N`
+// `istream`s that tapac packs because the task reads them in lockstep. The
+// lane read first, `IsFirst`, reads the tokens of all lanes into `buffer`.
+// Every lane answers `eot` from the packed stream, which tapac only packs if
+// `eot` is called before any lane is read in an iteration, and `read` with
+// arguments only if it cannot fail.
+template <typename T, uint64_t N, uint64_t I, bool IsFirst>
+class istream_lane {
+ public:
+  istream_lane(istream<packed_t<T, N>>& packed, packed_t<T, N>& buffer)
+      : packed_(packed), buffer_(buffer) {
+#pragma HLS inline
+  }
+
+  bool empty() const {
+#pragma HLS inline
+    return IsFirst && packed_.empty();
+  }
+
+  bool try_eot(bool& is_eot) const {
+#pragma HLS inline
+    return packed_.try_eot(is_eot);
+  }
+
+  bool eot(bool& is_success) const {
+#pragma HLS inline
+    return packed_.eot(is_success);
+  }
+
+  bool eot(std::nullptr_t) const {
+#pragma HLS inline
+    return packed_.eot(nullptr);
+  }
+
+  T read() {
+#pragma HLS inline
+    if (IsFirst) buffer_ = packed_.read();
+    return buffer_.lanes[I];
+  }
+
+  T read(std::nullptr_t) {
+#pragma HLS inline
+    return read();
+  }
+
+  istream_lane& operator>>(T& value) {
+#pragma HLS inline
+    value = read();
+    return *this;
+  }
+
+  void open() {
+#pragma HLS inline
+    if (IsFirst) packed_.open();
+  }
+
+ private:
+  istream<packed_t<T, N>>& packed_;
+  packed_t<T, N>& buffer_;
+};
+
+}  // namespace internal
+
 }  // namespace tapa
 
 #else  // __SYNTHESIS__
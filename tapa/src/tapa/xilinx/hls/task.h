@@ -45,6 +45,13 @@ struct task {
     }
     return *this;
   }
+
+  // replicas, distributor, and collector are instantiated by tapac
+  template <typename Mode, typename Func, typename... Args>
+  task& invoke(Func&& func, Args&&... args) {
+    return invoke<Mode::mode>(std::forward<Func>(func),
+                              std::forward<Args>(args)...);
+  }
 };
 
 }  // namespace tapa
@@ -376,6 +376,254 @@ DEFINE_FUNC(sum, +)
 DEFINE_FUNC(product, *)
 #undef DEFINE_FUNC
 
+namespace internal {
+
+struct add_op {
+  template <typename T>
+  T operator()(const T& lhs, const T& rhs) const {
+#pragma HLS inline
+    return lhs + rhs;
+  }
+};
+
+struct max_op {
+  template <typename T>
+  T operator()(const T& lhs, const T& rhs) const {
+#pragma HLS inline
+    return std::max(lhs, rhs);
+  }
+};
+
+struct min_op {
+  template <typename T>
+  T operator()(const T& lhs, const T& rhs) const {
+#pragma HLS inline
+    return std::min(lhs, rhs);
+  }
+};
+
+// Reduces a vector of L elements with `op` as a balanced tree that folds the
+// upper half onto the lower half until one element is left: element i is
+// combined with element i + (L + 1) / 2, and the middle element of an odd
+// length is kept. The host version uses the same tree, so floating-point
+// results agree.
+template <int L>
+struct tree_reduce {
+  template <typename T, typename Op>
+  static T apply(const vec_t<T, L>& vec, const Op& op) {
+#pragma HLS inline
+    const int half = L / 2;
+    const int upper = (L + 1) / 2;
+    vec_t<T, upper> folded;
+    for (int i = 0; i < half; ++i) {
+#pragma HLS unroll
+      folded.set(i, op(vec[i], vec[i + upper]));
+    }
+    if (half != upper) folded.set(half, vec[half]);
+    return tree_reduce<upper>::apply(folded, op);
+  }
+};
+
+template <>
+struct tree_reduce<1> {
+  template <typename T, typename Op>
+  static T apply(const vec_t<T, 1>& vec, const Op&) {
+#pragma HLS inline
+    return vec[0];
+  }
+};
+
+// Same tree as `tree_reduce`, for the index of the maximum; of equal
+// elements, the one with the lowest index wins.
+template <int L>
+struct tree_argmax {
+  template <typename T>
+  static int apply(const vec_t<T, L>& vec, const vec_t<int, L>& idx) {
+#pragma HLS inline
+    const int half = L / 2;
+    const int upper = (L + 1) / 2;
+    vec_t<T, upper> folded_vec;
+    vec_t<int, upper> folded_idx;
+    for (int i = 0; i < half; ++i) {
+#pragma HLS unroll
+      const T& lhs = vec[i];
+      const T& rhs = vec[i + upper];
+      const bool is_rhs =
+          lhs < rhs || (!(rhs < lhs) && idx[i + upper] < idx[i]);
+      folded_vec.set(i, is_rhs ? rhs : lhs);
+      folded_idx.set(i, is_rhs ? idx[i + upper] : idx[i]);
+    }
+    if (half != upper) {
+      folded_vec.set(half, vec[half]);
+      folded_idx.set(half, idx[half]);
+    }
+    return tree_argmax<upper>::apply(folded_vec, folded_idx);
+  }
+};
+
+template <>
+struct tree_argmax<1> {
+  template <typename T>
+  static int apply(const vec_t<T, 1>&, const vec_t<int, 1>& idx) {
+#pragma HLS inline
+    return idx[0];
+  }
+};
+
+// Inclusive prefix sums by log2(N) levels of the Kogge-Stone network: level d
+// adds element i - d to element i for every i >= d.
+template <int N, int d, bool = (d < N)>
+struct tree_scan {
+  template <typename T>
+  static vec_t<T, N> apply(const vec_t<T, N>& vec) {
+#pragma HLS inline
+    vec_t<T, N> result;
+    for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+      result.set(i, i < d ? vec[i] : vec[i - d] + vec[i]);
+    }
+    return tree_scan<N, d * 2>::apply(result);
+  }
+};
+
+template <int N, int d>
+struct tree_scan<N, d, false> {
+  template <typename T>
+  static vec_t<T, N> apply(const vec_t<T, N>& vec) {
+#pragma HLS inline
+    return vec;
+  }
+};
+
+}  // namespace internal
+
+// sum of elements with a balanced tree, in the same order as on the host
+template <typename T, int N>
+inline T reduce_add(const vec_t<T, N>& vec) {
+#pragma HLS inline
+  return internal::tree_reduce<N>::apply(vec, internal::add_op());
+}
+
+// maximum element with a balanced tree of depth ceil(log2(N))
+template <typename T, int N>
+inline T reduce_max(const vec_t<T, N>& vec) {
+#pragma HLS inline
+  return internal::tree_reduce<N>::apply(vec, internal::max_op());
+}
+
+// minimum element with a balanced tree of depth ceil(log2(N))
+template <typename T, int N>
+inline T reduce_min(const vec_t<T, N>& vec) {
+#pragma HLS inline
+  return internal::tree_reduce<N>::apply(vec, internal::min_op());
+}
+
+// index of the maximum element; of equal elements, the lowest index
+template <typename T, int N>
+inline int argmax(const vec_t<T, N>& vec) {
+#pragma HLS inline
+  vec_t<int, N> idx;
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    idx.set(i, i);
+  }
+  return internal::tree_argmax<N>::apply(vec, idx);
+}
+
+// inclusive prefix sums with ceil(log2(N)) levels of additions
+template <typename T, int N>
+inline vec_t<T, N> prefix_sum(const vec_t<T, N>& vec) {
+#pragma HLS inline
+  return internal::tree_scan<N, 1>::apply(vec);
+}
+
+namespace internal {
+
+// Returns true if and only if all `indices` are in [0, n).
+constexpr bool all_in_range(int) { return true; }
+template <typename... Ints>
+constexpr bool all_in_range(int n, int index, Ints... indices) {
+  return index >= 0 && index < n && all_in_range(n, indices...);
+}
+
+}  // namespace internal
+
+// return cat(v1, v2)[indices...], a compile-time permutation that is wiring
+template <int... indices, typename T, int N>
+inline vec_t<T, sizeof...(indices)> shuffle(const vec_t<T, N>& v1,
+                                            const vec_t<T, N>& v2) {
+  static_assert(internal::all_in_range(N * 2, indices...),
+                "shuffle index out of range");
+#pragma HLS inline
+  const int lanes[] = {indices...};
+  vec_t<T, sizeof...(indices)> result;
+  for (int i = 0; i < int(sizeof...(indices)); ++i) {
+#pragma HLS unroll
+    result.set(i, lanes[i] < N ? v1[lanes[i]] : v2[lanes[i] - N]);
+  }
+  return result;
+}
+
+// return vec[indices...]
+template <int... indices, typename T, int N>
+inline vec_t<T, sizeof...(indices)> shuffle(const vec_t<T, N>& vec) {
+  static_assert(internal::all_in_range(N, indices...),
+                "shuffle index out of range");
+#pragma HLS inline
+  return shuffle<indices...>(vec, vec);
+}
+
+// return {v1[0], v2[0], v1[1], v2[1], ...}
+template <typename T, int N>
+inline vec_t<T, N * 2> interleave(const vec_t<T, N>& v1,
+                                  const vec_t<T, N>& v2) {
+#pragma HLS inline
+  vec_t<T, N * 2> result;
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i * 2, v1[i]);
+    result.set(i * 2 + 1, v2[i]);
+  }
+  return result;
+}
+
+// v1 = vec[0::2], v2 = vec[1::2]
+template <typename T, int N>
+inline void deinterleave(const vec_t<T, N * 2>& vec, vec_t<T, N>& v1,
+                         vec_t<T, N>& v2) {
+#pragma HLS inline
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    v1.set(i, vec[i * 2]);
+    v2.set(i, vec[i * 2 + 1]);
+  }
+}
+
+// return vec[shift:] + vec[:shift]; negative shifts rotate the other way
+template <int shift, typename T, int N>
+inline vec_t<T, N> rotated(const vec_t<T, N>& vec) {
+#pragma HLS inline
+  vec_t<T, N> result;
+  for (int i = 0; i < N; ++i) {
+#pragma HLS unroll
+    result.set(i, vec[((i + shift) % N + N) % N]);
+  }
+  return result;
+}
+
+// dst[j][i] = src[i][j]
+template <typename T, int N, int M>
+inline void transpose(const vec_t<T, N> (&src)[M], vec_t<T, M> (&dst)[N]) {
+#pragma HLS inline
+  for (int j = 0; j < N; ++j) {
+#pragma HLS unroll
+    for (int i = 0; i < M; ++i) {
+#pragma HLS unroll
+      dst[j].set(i, src[i][j]);
+    }
+  }
+}
+
 template <typename T, int N>
 inline std::ostream& operator<<(std::ostream& os, const vec_t<T, N>& obj) {
   os << "{";